@@ -44,7 +44,11 @@ public class Caustic : ModuleRules
 				"Slate",
 				"SlateCore",
                 "UnrealEd",
+                "AssetRegistry",
                 "Projects",
+                "ImageWrapper",
+                "Json",
+                "JsonUtilities",
 				// ... add private dependencies that you statically link with here ...	
 			}
 			);
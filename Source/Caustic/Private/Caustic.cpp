@@ -2,19 +2,30 @@
 
 #include "Caustic.h"
 #include "Interfaces/IPluginManager.h"
+#include "Pass/CausticResourcePool.h"
+#include "Pass/CausticMemory.h"
+#include "CausticViewExtension.h"
 
 #define LOCTEXT_NAMESPACE "FCausticModule"
 
+DEFINE_LOG_CATEGORY(LogCaustic);
+
 void FCausticModule::StartupModule()
 {
 	FString PluginShaderDir = FPaths::Combine(IPluginManager::Get().FindPlugin(TEXT("Caustic"))->GetBaseDir(), TEXT("Shaders"));
 	AddShaderSourceDirectoryMapping(TEXT("/Plugin/Caustic"), PluginShaderDir);
+
+#if ENABLE_LOW_LEVEL_MEM_TRACKER
+	Caustic::RegisterLLMTag();
+#endif
 }
 
 void FCausticModule::ShutdownModule()
 {
 	// This function may be called during shutdown to clean up your module.  For modules that support dynamic reloading,
 	// we call this function before unloading the module.
+	FCausticViewExtension::Shutdown();
+	FCausticResourcePool::Get().Empty();
 }
 
 #undef LOCTEXT_NAMESPACE
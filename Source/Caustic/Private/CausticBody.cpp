@@ -2,17 +2,200 @@
 
 
 #include "CausticBody.h"
+#include "Caustic.h"
 #include "Components/BoxComponent.h"
 #include "Components/SceneCaptureComponent2D.h"
 #include "Engine/TextureRenderTarget2D.h"
+#include "Engine/Texture2D.h"
+#include "RenderingThread.h"
+#include "Engine/DirectionalLight.h"
+#include "Components/DecalComponent.h"
+#include "Materials/MaterialInstanceDynamic.h"
 #include "ProceduralMeshComponent.h"
-#include "Kismet/KismetRenderingLibrary.h"
+#include "Async/Async.h"
+#include "Containers/Ticker.h"
+#include "EngineUtils.h"
+#include "Engine/Engine.h"
+#include "HAL/IConsoleManager.h"
+#include "Pass/CausticMemory.h"
+#include "CausticViewExtension.h"
+#include "CausticDepthProxies.h"
+#include "CausticDecalMaterial.h"
+
+namespace
+{
+	void ListCausticMemory(UWorld* World)
+	{
+		if (!World)
+		{
+			return;
+		}
+
+		uint64 TotalBytes = 0;
+		for (TActorIterator<ACausticBody> It(World); It; ++It)
+		{
+			const uint64 Bytes = It->GetReservedGpuMemory();
+			TotalBytes += Bytes;
+			UE_LOG(LogCaustic, Display, TEXT("%s: %.2f MB%s"), *It->GetName(), Bytes / (1024.0 * 1024.0), Bytes ? TEXT("") : TEXT(" (not simulated)"));
+		}
+
+		const uint64 BudgetBytes = FCausticMemoryBudget::GetBudgetBytes();
+		UE_LOG(LogCaustic, Display, TEXT("Caustic bodies: %.2f MB reserved, budget %s"), TotalBytes / (1024.0 * 1024.0),
+			BudgetBytes ? *FString::Printf(TEXT("%.2f MB"), BudgetBytes / (1024.0 * 1024.0)) : TEXT("unlimited"));
+	}
+}
+
+static TAutoConsoleVariable<int32> CVarCausticMaxImpulsesPerStep(
+	TEXT("r.Caustic.MaxImpulsesPerStep"),
+	4096,
+	TEXT("Impulses a body splats in one simulation step, further impulses that step are dropped.\n")
+	TEXT("Each impulse runs one thread group over the texels it covers, so the splat scales with the area the impulses cover."),
+	ECVF_Default
+);
+
+static TAutoConsoleVariable<int32> CVarCausticMaxDepthProxies(
+	TEXT("r.Caustic.MaxDepthProxies"),
+	256,
+	TEXT("Proxy slots a body traces in one step under the Collision Proxies and Static Meshes sources.\n")
+	TEXT("Spheres, capsules and boxes take one slot, a convex hull one plus one per four planes.\n")
+	TEXT("Components past the cap are left out of the step, the proxy buffer is budgeted at this size."),
+	ECVF_Default
+);
+
+static TAutoConsoleVariable<float> CVarCausticSleepThreshold(
+	TEXT("r.Caustic.SleepThreshold"),
+	0.001f,
+	TEXT("Fraction of its height the last disturbance decays to before a calm body stops simulating.\n")
+	TEXT("Bodies with ambient waves, a deterministic simulation or interactors under the penetration force never sleep.\n")
+	TEXT("0 disables sleeping."),
+	ECVF_Default
+);
+
+static FAutoConsoleCommandWithWorld CausticListMemoryCommand(
+	TEXT("Caustic.ListMemory"),
+	TEXT("Logs the GPU memory every caustic body in the world reserved against r.Caustic.MemoryBudgetMB."),
+	FConsoleCommandWithWorldDelegate::CreateStatic(&ListCausticMemory)
+);
+
+#if WITH_EDITOR
+namespace
+{
+	typedef TArray<FFloat16Color> FCausticBakedFrame;
+
+	FLinearColor ToLinearColor(const FFloat16Color& Color)
+	{
+		return FLinearColor(Color.R, Color.G, Color.B, Color.A);
+	}
+
+	/** Crossfades the frames baked past the end into the first ones, so the last frame runs into the first without a seam */
+	void BlendFlipbookLoop(TArray<FCausticBakedFrame>& Frames, int32 FrameCount, int32 LoopFrames)
+	{
+		for (int32 Index = 0; Index < LoopFrames; ++Index)
+		{
+			// Frame 0 is the pure continuation of the last frame and the blend reaches the simulated head at LoopFrames
+			const float Alpha = (float)Index / LoopFrames;
+
+			FCausticBakedFrame& Head = Frames[Index];
+			const FCausticBakedFrame& Tail = Frames[FrameCount + Index];
+
+			for (int32 Texel = 0; Texel < Head.Num(); ++Texel)
+			{
+				Head[Texel] = FFloat16Color(FMath::Lerp(ToLinearColor(Tail[Texel]), ToLinearColor(Head[Texel]), Alpha));
+			}
+		}
+
+		Frames.SetNum(FrameCount);
+	}
+
+	/** Tiles the frames row major into a BC6H texture source */
+	UTexture2D* CreateFlipbookTexture(UObject* Outer, const TCHAR* BaseName, const TArray<FCausticBakedFrame>& Frames, const FIntPoint& FrameSize, int32 Columns)
+	{
+		const int32 Rows = FMath::DivideAndRoundUp(Frames.Num(), Columns);
+		const FIntPoint AtlasSize(Columns * FrameSize.X, Rows * FrameSize.Y);
+
+		TArray<FFloat16Color> AtlasData;
+		AtlasData.SetNumZeroed(AtlasSize.X * AtlasSize.Y);
+
+		for (int32 FrameIndex = 0; FrameIndex < Frames.Num(); ++FrameIndex)
+		{
+			const FCausticBakedFrame& Frame = Frames[FrameIndex];
+			const FIntPoint Origin((FrameIndex % Columns) * FrameSize.X, (FrameIndex / Columns) * FrameSize.Y);
+
+			for (int32 Y = 0; Y < FrameSize.Y; ++Y)
+			{
+				FMemory::Memcpy(&AtlasData[(Origin.Y + Y) * AtlasSize.X + Origin.X], &Frame[Y * FrameSize.X], FrameSize.X * sizeof(FFloat16Color));
+			}
+		}
+
+		UTexture2D* Texture = NewObject<UTexture2D>(Outer, MakeUniqueObjectName(Outer, UTexture2D::StaticClass(), BaseName), RF_Transactional);
+		Texture->Source.Init(AtlasSize.X, AtlasSize.Y, 1, 1, TSF_RGBA16F, reinterpret_cast<const uint8*>(AtlasData.GetData()));
+		Texture->CompressionSettings = TC_HDR_Compressed;
+		Texture->SRGB = false;
+
+		// Playback loads mip 0 texel for texel, so the atlas has no mips and stays resident
+		Texture->MipGenSettings = TMGS_NoMipmaps;
+		Texture->NeverStream = true;
+		Texture->AddressX = TA_Clamp;
+		Texture->AddressY = TA_Clamp;
+		Texture->PostEditChange();
+
+		return Texture;
+	}
+}
+#endif
 
 // Sets default values
 ACausticBody::ACausticBody() :
-	SurfaceDepthPassRenderer(new FSurfaceDepthPassRenderer()),
-	SurfaceNormalPassRenderer(new FSurfaceNormalPassRenderer()),
-	SurfaceCausticPassRenderer(new FSurfaceCausticPassRenderer())
+	bDeterministicSimulation(false),
+	InteractionSource(ECausticInteractionSource::SceneCapture),
+	InteractionForce(ECausticInteractionForce::DisplacedVolume),
+	WakeStrength(0.0f),
+	bSimulateWhenHidden(false),
+	CausticRenderTarget(nullptr),
+	CausticDecalMaterial(nullptr),
+	CausticDecalIntensity(1.0f),
+	CausticDepthFalloff(256.0f),
+	bTemporalFilter(true),
+	TemporalBlendWeight(0.1f),
+	CausticResolutionScale(4.0f),
+	CausticBlurRadius(0),
+	bGenerateCausticMips(true),
+	bUseCausticFlipbook(true),
+	FlipbookFrameCount(32),
+	FlipbookFrameStep(4),
+	FlipbookLoopFrames(8),
+	FlipbookWarmupSteps(240),
+	CausticFlipbook(nullptr),
+	FlipbookColumns(0),
+	BakedFlipbookFrameCount(0),
+	BakedFlipbookFrameStep(1),
+	FlipbookFrameSize(0, 0),
+	SurfaceDepthPassDebugTexture(nullptr),
+	SurfaceHeightPassDebugTexture(nullptr),
+	SurfaceNormalPassDebugTexture(nullptr),
+	SurfaceCausticPassDebugTexture(nullptr),
+	DepthRenderTarget(nullptr),
+	CausticDecalMID(nullptr),
+	ObstacleMaskRenderTarget(nullptr),
+	SurfaceDepthPassRenderer(MakeShared<FSurfaceDepthPassRenderer, ESPMode::ThreadSafe>()),
+	SurfaceNormalPassRenderer(MakeShared<FSurfaceNormalPassRenderer, ESPMode::ThreadSafe>()),
+	SurfaceCausticPassRenderer(MakeShared<FSurfaceCausticPassRenderer, ESPMode::ThreadSafe>()),
+	CausticTemporalPassRenderer(MakeShared<FCausticTemporalPassRenderer, ESPMode::ThreadSafe>()),
+	CausticBlurPassRenderer(MakeShared<FCausticBlurPassRenderer, ESPMode::ThreadSafe>()),
+	CausticFlipbookPassRenderer(MakeShared<FCausticFlipbookPassRenderer, ESPMode::ThreadSafe>()),
+	FrameGraph(MakeShared<FCausticFrameGraph, ESPMode::ThreadSafe>(SurfaceDepthPassRenderer.ToSharedRef(), SurfaceNormalPassRenderer.ToSharedRef(), SurfaceCausticPassRenderer.ToSharedRef(), CausticTemporalPassRenderer.ToSharedRef(), CausticBlurPassRenderer.ToSharedRef(), CausticFlipbookPassRenderer.ToSharedRef())),
+	QuietSteps(0),
+	bSleeping(false),
+	bDepthCapturedLastFrame(false),
+	bWarnedImpulseCap(false),
+	bWarnedDepthProxyCap(false),
+	bSimulationReady(false),
+	LastDebugCaptureSerial(0),
+	bObstacleMaskPending(false),
+	SimulationStep(0),
+	ReservedGpuMemory(0),
+	LastVisibleFrame(0),
+	LastSimulatedFrame(0)
 {
  	// Set this actor to call Tick() every frame.  You can turn this off to improve performance if you don't need it.
 	PrimaryActorTick.bCanEverTick = true;
@@ -21,11 +204,13 @@ ACausticBody::ACausticBody() :
 	SurfaceMeshComp = CreateDefaultSubobject<UProceduralMeshComponent>(TEXT("SurfaceMeshComponent"));
 	BodyMeshComp = CreateDefaultSubobject<UProceduralMeshComponent>(TEXT("BodyMeshComponent"));
 	DepthCaptureComp = CreateDefaultSubobject<USceneCaptureComponent2D>(TEXT("DepthCaptureComponent"));
+	CausticDecalComp = CreateDefaultSubobject<UDecalComponent>(TEXT("CausticDecalComponent"));
 
 	RootComponent = BoxCollisionComp;
 	SurfaceMeshComp->SetupAttachment(RootComponent);
 	BodyMeshComp->SetupAttachment(RootComponent);
 	DepthCaptureComp->SetupAttachment(RootComponent);
+	CausticDecalComp->SetupAttachment(RootComponent);
 
 	FVector Offset(0.0f, 0.0f, BodyDepth / 2);
 	SurfaceMeshComp->SetRelativeLocation(Offset);
@@ -36,6 +221,8 @@ ACausticBody::ACausticBody() :
 	BodyWidth = 512.0f;
 	BodyHeight = 512.0f;
 	BodyDepth = 512.0f;
+	bBakeObstacleMask = false;
+	CausticLight = nullptr;
 
 	BoxCollisionComp->SetBoxExtent(FVector(BodyWidth / 2, BodyHeight / 2, BodyDepth / 2));
 	BoxCollisionComp->SetCollisionResponseToAllChannels(ECR_Ignore);
@@ -50,6 +237,23 @@ ACausticBody::ACausticBody() :
 	DepthCaptureComp->PrimitiveRenderMode = ESceneCapturePrimitiveRenderMode::PRM_RenderScenePrimitives;
 	DepthCaptureComp->CaptureSource = ESceneCaptureSource::SCS_SceneDepth;
 	DepthCaptureComp->PrimitiveRenderMode = ESceneCapturePrimitiveRenderMode::PRM_UseShowOnlyList;
+	DepthCaptureComp->bCaptureOnMovement = false;
+
+	// Only depth is read back, everything that shades or post processes the capture is wasted work
+	FEngineShowFlags& CaptureShowFlags = DepthCaptureComp->ShowFlags;
+	CaptureShowFlags.SetPostProcessing(false);
+	CaptureShowFlags.SetLighting(false);
+	CaptureShowFlags.SetDynamicShadows(false);
+	CaptureShowFlags.SetAmbientOcclusion(false);
+	CaptureShowFlags.SetGlobalIllumination(false);
+	CaptureShowFlags.SetReflectionEnvironment(false);
+	CaptureShowFlags.SetScreenSpaceReflections(false);
+	CaptureShowFlags.SetSkyLighting(false);
+	CaptureShowFlags.SetFog(false);
+	CaptureShowFlags.SetAtmosphericFog(false);
+	CaptureShowFlags.SetVolumetricFog(false);
+	CaptureShowFlags.SetTranslucency(false);
+	CaptureShowFlags.SetDecals(false);
 
 	LiquidParam.DepthTextureWidth = 128;
 	LiquidParam.DepthTextureHeight = 128;
@@ -57,7 +261,17 @@ ACausticBody::ACausticBody() :
 	LiquidParam.Velocity = 0.5426512f;
 	LiquidParam.ForceFactor = 1.49f;
 	LiquidParam.Refraction = 0.1f;
+	LiquidParam.Dispersion = 0.0f;
+	// Vertical keeps the look of bodies placed before the refracted projection existed, which is opt in
+	LiquidParam.Projection = ECausticProjection::Vertical;
+	LiquidParam.IndexOfRefraction = 1.33f;
 	LiquidParam.AttenuationCoefficient = 0.97f;
+	LiquidParam.Solver = ECausticSolver::FivePoint;
+	LiquidParam.JacobiIterations = 4;
+	LiquidParam.BoundaryMode = ECausticBoundaryMode::Reflective;
+	LiquidParam.SpongeWidth = 8;
+	LiquidParam.SpongeStrength = 0.2f;
+	SolverCoefficients = Caustic::ComputeSolverCoefficients(LiquidParam);
 
 	GenerateSurfaceMesh();
 	GenerateBodyMesh();
@@ -68,10 +282,54 @@ void ACausticBody::BeginPlay()
 {
 	Super::BeginPlay();
 
+	UpdateSolverCoefficients();
+
+	if (!ReserveGpuMemory())
+	{
+		CausticDecalComp->SetVisibility(false);
+		return;
+	}
+
+	FCausticViewExtension::RegisterBody(this);
+
+	if (!CausticRenderTarget)
+	{
+		const FIntPoint CausticSize = GetCausticTextureSize();
+
+		CausticRenderTarget = NewObject<UTextureRenderTarget2D>(this);
+		CausticRenderTarget->RenderTargetFormat = RTF_RGBA16f;
+		CausticRenderTarget->ClearColor = FLinearColor::Black;
+		CausticRenderTarget->SizeX = CausticSize.X;
+		CausticRenderTarget->SizeY = CausticSize.Y;
+		CausticRenderTarget->bAutoGenerateMips = bGenerateCausticMips;
+		CausticRenderTarget->UpdateResource();
+	}
+
+	InitSimulation(FIntPoint(CausticRenderTarget->SizeX, CausticRenderTarget->SizeY));
+
+	SetupCausticDecal();
+
+	if (bBakeObstacleMask)
+	{
+		BakeObstacleMask();
+	}
+}
+
+void ACausticBody::InitSimulation(const FIntPoint& OutputSize)
+{
+	// Pass resources are created asynchronously, the body starts simulating once they are all ready
+	bSimulationReady = false;
+
 	uint32 TextureWidth = LiquidParam.DepthTextureWidth;
 	uint32 TextureHeight = LiquidParam.DepthTextureHeight;
 
-	DepthRenderTarget = UKismetRenderingLibrary::CreateRenderTarget2D(GetWorld(), TextureWidth, TextureHeight, RTF_R16f);
+	// Only create the UObject here, its RHI texture is created by the render thread on UpdateResource
+	DepthRenderTarget = NewObject<UTextureRenderTarget2D>(this);
+	DepthRenderTarget->RenderTargetFormat = RTF_R16f;
+	DepthRenderTarget->ClearColor = FLinearColor::Black;
+	DepthRenderTarget->SizeX = TextureWidth;
+	DepthRenderTarget->SizeY = TextureHeight;
+	DepthRenderTarget->UpdateResource();
 	DepthCaptureComp->TextureTarget = DepthRenderTarget;
 
 	{
@@ -80,8 +338,9 @@ void ACausticBody::BeginPlay()
 		Config.MaxDepth = BodyDepth;
 		Config.TextureWidth = TextureWidth;
 		Config.TextureHeight = TextureHeight;
-		Config.DepthDebugTextureRef = SurfaceDepthPassDebugTexture;
-		Config.HeightDebugTextureRef = SurfaceHeightPassDebugTexture;
+		Config.MaxImpulses = CVarCausticMaxImpulsesPerStep.GetValueOnGameThread();
+		Config.MaxDepthProxies = (InteractionSource != ECausticInteractionSource::SceneCapture) ? CVarCausticMaxDepthProxies.GetValueOnGameThread() : 0;
+		Config.bMeshDepth = InteractionSource == ECausticInteractionSource::StaticMeshes;
 		SurfaceDepthPassRenderer->InitPass(Config);
 	}
 
@@ -89,19 +348,381 @@ void ACausticBody::BeginPlay()
 		FSurfaceNormalPassConfig Config;
 		Config.TextureWidth = TextureWidth;
 		Config.TextureHeight = TextureHeight;
-		Config.NormalDebugTextureRef = SurfaceNormalPassDebugTexture;
 		SurfaceNormalPassRenderer->InitPass(Config);
 	}
 
+	SurfaceCausticPassRenderer->InitPass(GetCausticPassConfig());
+
+	{
+		// The history is resolved into the output target, so it follows the target size rather than the pass config
+		FCausticTemporalPassConfig Config;
+		Config.TextureWidth = OutputSize.X;
+		Config.TextureHeight = OutputSize.Y;
+		CausticTemporalPassRenderer->InitPass(Config);
+	}
+
+	{
+		FCausticBlurPassConfig Config;
+		Config.TextureWidth = OutputSize.X;
+		Config.TextureHeight = OutputSize.Y;
+		CausticBlurPassRenderer->InitPass(Config);
+	}
+
+	// Frames map texel for texel onto the output, a flipbook of another size is ignored rather than resampled
+	if (CausticFlipbook && FlipbookFrameSize != OutputSize)
+	{
+		UE_LOG(LogCaustic, Warning, TEXT("%s: flipbook frames are %dx%d but the caustic target is %dx%d, rebake the flipbook"), *GetName(), FlipbookFrameSize.X, FlipbookFrameSize.Y, OutputSize.X, OutputSize.Y);
+	}
+	else if (CausticFlipbook && bUseCausticFlipbook)
+	{
+		FCausticFlipbookPassConfig Config;
+		Config.TextureWidth = OutputSize.X;
+		Config.TextureHeight = OutputSize.Y;
+		CausticFlipbookPassRenderer->InitPass(Config);
+	}
+
+	if (AmbientWave.bEnabled)
+	{
+		AmbientWaveSpectrum = FAmbientWaveSpectrumCache::Get().FindOrCreate(AmbientWave);
+	}
+}
+
+FIntPoint ACausticBody::GetCausticTextureSize() const
+{
+	const float ResolutionScale = FMath::Clamp(CausticResolutionScale, 0.25f, 8.0f);
+
+	return FIntPoint(
+		FMath::Max(FMath::RoundToInt(LiquidParam.DepthTextureWidth * ResolutionScale), 1),
+		FMath::Max(FMath::RoundToInt(LiquidParam.DepthTextureHeight * ResolutionScale), 1)
+	);
+}
+
+FSurfaceCausticPassConfig ACausticBody::GetCausticPassConfig() const
+{
+	// The grid cell is scaled with the resolution in floating point so the refraction grid keeps its vertex count,
+	// up to the 16-bit index limit FSurfaceCausticPassRenderer::GetGridSize clamps it to
+	const float ResolutionScale = FMath::Clamp(CausticResolutionScale, 0.25f, 8.0f);
+	const FIntPoint CausticSize = GetCausticTextureSize();
+
+	FSurfaceCausticPassConfig Config;
+	Config.TextureWidth = CausticSize.X;
+	Config.TextureHeight = CausticSize.Y;
+	Config.CellSize = CellSize * ResolutionScale / 32.0f;
+	Config.FarClipZ = BodyDepth;
+	Config.NearClipZ = -BodyDepth;
+	Config.BodyWidth = BodyWidth;
+	Config.BodyHeight = BodyHeight;
+	return Config;
+}
+
+uint64 ACausticBody::GetGpuMemorySize(const FIntPoint& OutputSize) const
+{
+	const uint32 TextureWidth = LiquidParam.DepthTextureWidth;
+	const uint32 TextureHeight = LiquidParam.DepthTextureHeight;
+
+	FSurfaceDepthPassConfig DepthConfig;
+	DepthConfig.TextureWidth = TextureWidth;
+	DepthConfig.TextureHeight = TextureHeight;
+	DepthConfig.MaxImpulses = CVarCausticMaxImpulsesPerStep.GetValueOnGameThread();
+	DepthConfig.MaxDepthProxies = (InteractionSource != ECausticInteractionSource::SceneCapture) ? CVarCausticMaxDepthProxies.GetValueOnGameThread() : 0;
+	DepthConfig.bMeshDepth = InteractionSource == ECausticInteractionSource::StaticMeshes;
+
+	FSurfaceNormalPassConfig NormalConfig;
+	NormalConfig.TextureWidth = TextureWidth;
+	NormalConfig.TextureHeight = TextureHeight;
+
+	FCausticTemporalPassConfig TemporalConfig;
+	TemporalConfig.TextureWidth = OutputSize.X;
+	TemporalConfig.TextureHeight = OutputSize.Y;
+
+	FCausticBlurPassConfig BlurConfig;
+	BlurConfig.TextureWidth = OutputSize.X;
+	BlurConfig.TextureHeight = OutputSize.Y;
+
+	uint64 Bytes =
+		FSurfaceDepthPassRenderer::GetMemorySize(DepthConfig) +
+		FSurfaceNormalPassRenderer::GetMemorySize(NormalConfig) +
+		FSurfaceCausticPassRenderer::GetMemorySize(GetCausticPassConfig()) +
+		FCausticTemporalPassRenderer::GetMemorySize(TemporalConfig) +
+		FCausticBlurPassRenderer::GetMemorySize(BlurConfig);
+
+	if (CausticFlipbook && bUseCausticFlipbook && FlipbookFrameSize == OutputSize)
+	{
+		FCausticFlipbookPassConfig FlipbookConfig;
+		FlipbookConfig.TextureWidth = OutputSize.X;
+		FlipbookConfig.TextureHeight = OutputSize.Y;
+		Bytes += FCausticFlipbookPassRenderer::GetMemorySize(FlipbookConfig);
+
+		// The atlas stays resident while the body can play it
+		Bytes += CausticFlipbook->CalcTextureMemorySizeEnum(TMC_ResidentMips);
+	}
+
+	// Bodies with the same settings share one field, each of them is charged for it so the budget stays an upper bound
+	if (AmbientWave.bEnabled)
+	{
+		Bytes += FAmbientWaveSpectrum::GetMemorySize(AmbientWave);
+	}
+
+	// Render targets, the caustic target carries a full mip chain when mips are generated
+	const int32 CausticMips = bGenerateCausticMips ? FMath::FloorLog2(FMath::Max(OutputSize.X, OutputSize.Y)) + 1 : 1;
+	Bytes += Caustic::GetTextureMemorySize(TextureWidth, TextureHeight, PF_R16F);
+	Bytes += Caustic::GetTextureMemorySize(OutputSize.X, OutputSize.Y, PF_FloatRGBA, CausticMips);
+
+	if (bBakeObstacleMask)
+	{
+		Bytes += Caustic::GetTextureMemorySize(TextureWidth, TextureHeight, PF_R16F);
+	}
+
+	return Bytes;
+}
+
+bool ACausticBody::ReserveGpuMemory()
+{
+	FCausticMemoryBudget& Budget = FCausticMemoryBudget::Get();
+	const float RequestedScale = CausticResolutionScale;
+
+	auto GetOutputSize = [this]()
+	{
+		return CausticRenderTarget ? FIntPoint(CausticRenderTarget->SizeX, CausticRenderTarget->SizeY) : GetCausticTextureSize();
+	};
+
+	// The caustic stage dominates the footprint, so its resolution goes down first. An assigned target keeps its size
+	while (!CausticRenderTarget && CausticResolutionScale > 1.0f && !Budget.CanReserve(GetGpuMemorySize(GetOutputSize())))
+	{
+		CausticResolutionScale = FMath::Max(CausticResolutionScale * 0.5f, 1.0f);
+	}
+
+	const uint64 Bytes = GetGpuMemorySize(GetOutputSize());
+	if (!Budget.TryReserve(Bytes))
+	{
+		CausticResolutionScale = RequestedScale;
+		INC_DWORD_STAT(STAT_CausticRefusedBodies);
+
+		UE_LOG(LogCaustic, Warning, TEXT("%s: needs %.2f MB of GPU memory but %.2f of the %.2f MB caustic budget are in use, the body is not simulated"),
+			*GetName(), Bytes / (1024.0 * 1024.0), Budget.GetReservedBytes() / (1024.0 * 1024.0), FCausticMemoryBudget::GetBudgetBytes() / (1024.0 * 1024.0));
+		return false;
+	}
+
+	if (CausticResolutionScale != RequestedScale)
 	{
-		FSurfaceCausticPassConfig Config;
-		Config.TextureWidth = TextureWidth * 4;
-		Config.TextureHeight = TextureHeight * 4;
-		Config.CellSize = CellSize / 8;
-		Config.FarClipZ = BodyDepth;
-		Config.NearClipZ = -BodyDepth;
-		SurfaceCausticPassRenderer->InitPass(Config);
+		UE_LOG(LogCaustic, Warning, TEXT("%s: caustic resolution scale lowered from %.2f to %.2f to fit the caustic memory budget"), *GetName(), RequestedScale, CausticResolutionScale);
 	}
+
+	ReservedGpuMemory = Bytes;
+	INC_DWORD_STAT(STAT_CausticBodies);
+
+	return true;
+}
+
+#if WITH_EDITOR
+void ACausticBody::BakeCausticFlipbook()
+{
+	UWorld* World = GetWorld();
+	if (!World || World->IsGameWorld())
+	{
+		UE_LOG(LogCaustic, Warning, TEXT("%s: bake the flipbook in the editor, not during play"), *GetName());
+		return;
+	}
+
+	// Without interactors only the ambient swell moves the surface
+	if (!AmbientWave.bEnabled)
+	{
+		UE_LOG(LogCaustic, Warning, TEXT("%s: enable AmbientWave before baking a flipbook, a calm body bakes a still frame"), *GetName());
+		return;
+	}
+
+	// Editor actors never begin play, the coefficients may predate the last load
+	UpdateSolverCoefficients();
+
+	const FIntPoint FrameSize = GetCausticTextureSize();
+
+	// The atlas has to fit one texture, drop frames rather than bake a texture the RHI can't create
+	const int32 MaxDimension = (int32)GetMax2DTextureDimension();
+	const int32 MaxColumns = MaxDimension / FrameSize.X;
+	const int32 MaxRows = MaxDimension / FrameSize.Y;
+	if (MaxColumns * MaxRows < 2)
+	{
+		UE_LOG(LogCaustic, Warning, TEXT("%s: %dx%d frames don't fit twice in a %d texel atlas, lower the caustic resolution scale"), *GetName(), FrameSize.X, FrameSize.Y, MaxDimension);
+		return;
+	}
+
+	const int32 FrameCount = FMath::Clamp(FlipbookFrameCount, 2, FMath::Min(256, MaxColumns * MaxRows));
+	if (FrameCount < FlipbookFrameCount)
+	{
+		UE_LOG(LogCaustic, Warning, TEXT("%s: only %d frames of %dx%d fit a %d texel atlas, baking %d instead of %d"), *GetName(), FrameCount, FrameSize.X, FrameSize.Y, MaxDimension, FrameCount, FlipbookFrameCount);
+	}
+
+	// As square as the limit allows, with enough columns that the rows fit too
+	const int32 Columns = FMath::Clamp(FMath::CeilToInt(FMath::Sqrt((float)FrameCount)), FMath::DivideAndRoundUp(FrameCount, MaxRows), MaxColumns);
+
+	const int32 FrameStep = FMath::Clamp(FlipbookFrameStep, 1, 16);
+	const int32 LoopFrames = FMath::Clamp(FlipbookLoopFrames, 0, FrameCount - 1);
+	const int32 CapturedFrames = FrameCount + LoopFrames;
+	const int32 WarmupSteps = FMath::Max(FlipbookWarmupSteps, 0);
+
+	// The bake renders into its own target, a target assigned to the body keeps its contents
+	UTextureRenderTarget2D* BakeTarget = NewObject<UTextureRenderTarget2D>(GetTransientPackage());
+	BakeTarget->RenderTargetFormat = RTF_RGBA16f;
+	BakeTarget->ClearColor = FLinearColor::Black;
+	BakeTarget->SizeX = FrameSize.X;
+	BakeTarget->SizeY = FrameSize.Y;
+	BakeTarget->UpdateResource();
+
+	InitSimulation(FrameSize);
+
+	// The grid is built on the thread pool and only queues its upload when done, so the flush has to wait for it first
+	SurfaceCausticPassRenderer->WaitForPendingInit();
+	FlushRenderingCommands();
+
+	if (IsSimulationReady())
+	{
+		TSharedRef<TArray<FCausticBakedFrame>, ESPMode::ThreadSafe> CausticFrames = MakeShared<TArray<FCausticBakedFrame>, ESPMode::ThreadSafe>();
+		CausticFrames->SetNum(CapturedFrames);
+
+		FTextureRenderTargetResource* BakeTargetResource = BakeTarget->GameThread_GetRenderTargetResource();
+		const int32 TotalSteps = WarmupSteps + CapturedFrames * FrameStep;
+
+		for (int32 Step = 0; Step < TotalSteps; ++Step)
+		{
+			FCausticFrameInputs FrameInputs;
+			SetupFrameParams(FrameInputs, Step * Caustic::SimulationStepTime);
+			FrameInputs.DepthTargetResource = DepthRenderTarget->GameThread_GetRenderTargetResource();
+			FrameInputs.CausticTargetResource = BakeTargetResource;
+			FrameGraph->Render(MoveTemp(FrameInputs));
+
+			// The last step of every interval is stored
+			const int32 BakedStep = Step - WarmupSteps + 1;
+			if (BakedStep > 0 && BakedStep % FrameStep == 0)
+			{
+				const int32 FrameIndex = BakedStep / FrameStep - 1;
+
+				ENQUEUE_RENDER_COMMAND(CausticFlipbookReadbackCommand)
+				(
+					[BakeTargetResource, CausticFrames, FrameIndex, FrameSize](FRHICommandListImmediate& RHICmdList)
+					{
+						RHICmdList.ReadSurfaceFloatData(BakeTargetResource->GetRenderTargetTexture(), FIntRect(FIntPoint::ZeroValue, FrameSize), (*CausticFrames)[FrameIndex], CubeFace_PosX, 0, 0);
+					}
+				);
+			}
+		}
+
+		FlushRenderingCommands();
+
+		BlendFlipbookLoop(*CausticFrames, FrameCount, LoopFrames);
+
+		Modify();
+		CausticFlipbook = CreateFlipbookTexture(this, TEXT("CausticFlipbook"), *CausticFrames, FrameSize, Columns);
+		FlipbookColumns = Columns;
+		FlipbookFrameSize = FrameSize;
+		BakedFlipbookFrameCount = FrameCount;
+		BakedFlipbookFrameStep = FrameStep;
+	}
+	else
+	{
+		UE_LOG(LogCaustic, Warning, TEXT("%s: the passes failed to initialize, the flipbook was not baked"), *GetName());
+	}
+
+	// The editor body goes back to doing nothing
+	FrameGraph->ReleasePasses();
+	AmbientWaveSpectrum.Reset();
+	DepthCaptureComp->TextureTarget = nullptr;
+	DepthRenderTarget = nullptr;
+	bSimulationReady = false;
+
+	BakeTarget->ReleaseResource();
+	FlushRenderingCommands();
+}
+#endif
+
+void ACausticBody::SetupCausticDecal()
+{
+	if (!CausticDecalMaterial || !CausticRenderTarget)
+	{
+		CausticDecalComp->SetVisibility(false);
+		return;
+	}
+
+	// Decals project along their X axis, point it down and span the body volume below the surface
+	CausticDecalComp->SetRelativeLocation(FVector(0.0f, 0.0f, GetSurfaceZ() - BodyDepth / 2));
+	CausticDecalComp->SetRelativeRotation(FRotator(-90.0f, 0.0f, 0.0f));
+	CausticDecalComp->DecalSize = FVector(BodyDepth / 2, BodyHeight / 2, BodyWidth / 2);
+
+	CausticDecalMID = UMaterialInstanceDynamic::Create(CausticDecalMaterial, this);
+	CausticDecalMID->SetTextureParameterValue(TEXT("CausticTexture"), CausticRenderTarget);
+	CausticDecalMID->SetScalarParameterValue(TEXT("BodyDepth"), BodyDepth);
+	CausticDecalMID->SetScalarParameterValue(TEXT("CausticIntensity"), CausticDecalIntensity);
+	CausticDecalMID->SetScalarParameterValue(TEXT("CausticDepthFalloff"), CausticDepthFalloff);
+	UpdateCausticDecalSurface();
+
+	RootComponent->TransformUpdated.AddUObject(this, &ACausticBody::OnBodyTransformUpdated);
+
+	CausticDecalComp->SetDecalMaterial(CausticDecalMID);
+	CausticDecalComp->MarkRenderStateDirty();
+	CausticDecalComp->SetVisibility(true);
+}
+
+void ACausticBody::UpdateCausticDecalSurface()
+{
+	if (!CausticDecalMID)
+	{
+		return;
+	}
+
+	const FTransform& BodyTransform = GetActorTransform();
+	const FMatrix WorldToBody = BodyTransform.ToInverseMatrixWithScale();
+
+	// FMatrix transforms row vectors, so its columns are the rows the shader dots world offsets with
+	CausticDecalMID->SetVectorParameterValue(TEXT("CausticBodyOrigin"), FLinearColor(BodyTransform.GetLocation()));
+	CausticDecalMID->SetVectorParameterValue(TEXT("CausticBodyAxisX"), FLinearColor(WorldToBody.GetColumn(0)));
+	CausticDecalMID->SetVectorParameterValue(TEXT("CausticBodyAxisY"), FLinearColor(WorldToBody.GetColumn(1)));
+	CausticDecalMID->SetVectorParameterValue(TEXT("CausticBodyAxisZ"), FLinearColor(WorldToBody.GetColumn(2)));
+	CausticDecalMID->SetVectorParameterValue(TEXT("CausticBodyExtent"), FLinearColor(BodyWidth, BodyHeight, GetSurfaceZ()));
+	CausticDecalMID->SetScalarParameterValue(TEXT("CausticBodyScaleZ"), BodyTransform.GetScale3D().Z);
+
+	// World height of the surface centre, for materials that only handle bodies without rotation
+	CausticDecalMID->SetScalarParameterValue(TEXT("SurfaceHeight"), BodyTransform.TransformPosition(FVector(0.0f, 0.0f, GetSurfaceZ())).Z);
+}
+
+void ACausticBody::OnBodyTransformUpdated(USceneComponent* UpdatedComponent, EUpdateTransformFlags UpdateTransformFlags, ETeleportType Teleport)
+{
+	UpdateCausticDecalSurface();
+}
+
+#if WITH_EDITOR
+void ACausticBody::AssignDefaultDecalMaterial()
+{
+	if (UMaterialInterface* DecalMaterial = Caustic::FindOrCreateDecalMaterial())
+	{
+		Modify();
+		CausticDecalMaterial = DecalMaterial;
+	}
+}
+#endif
+
+void ACausticBody::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	bSimulationReady = false;
+
+	FrameGraph->ReleasePasses();
+	AmbientWaveSpectrum.Reset();
+
+	FCausticViewExtension::UnregisterBody(this);
+	RootComponent->TransformUpdated.RemoveAll(this);
+
+	if (ReservedGpuMemory > 0)
+	{
+		FCausticMemoryBudget::Get().Release(ReservedGpuMemory);
+		DEC_DWORD_STAT(STAT_CausticBodies);
+		ReservedGpuMemory = 0;
+	}
+
+	if (bSleeping)
+	{
+		bSleeping = false;
+		DEC_DWORD_STAT(STAT_CausticSleepingBodies);
+	}
+
+	Super::EndPlay(EndPlayReason);
 }
 
 void ACausticBody::PostInitializeComponents()
@@ -111,6 +732,202 @@ void ACausticBody::PostInitializeComponents()
 	BoxCollisionComp->OnComponentEndOverlap.AddDynamic(this, &ACausticBody::OnBoxEndOverlap);
 }
 
+#if WITH_EDITOR
+void ACausticBody::PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent)
+{
+	Super::PostEditChangeProperty(PropertyChangedEvent);
+
+	const FName MemberName = PropertyChangedEvent.MemberProperty ? PropertyChangedEvent.MemberProperty->GetFName() : NAME_None;
+	if (MemberName == NAME_None || MemberName == GET_MEMBER_NAME_CHECKED(ACausticBody, LiquidParam))
+	{
+		UpdateSolverCoefficients();
+	}
+}
+#endif
+
+void ACausticBody::SetLiquidParam(const FLiquidParam& InLiquidParam)
+{
+	const int32 TextureWidth = LiquidParam.DepthTextureWidth;
+	const int32 TextureHeight = LiquidParam.DepthTextureHeight;
+
+	LiquidParam = InLiquidParam;
+
+	// The passes were created at the old size, the new one would only take effect at the next BeginPlay
+	if (HasActorBegunPlay())
+	{
+		LiquidParam.DepthTextureWidth = TextureWidth;
+		LiquidParam.DepthTextureHeight = TextureHeight;
+	}
+
+	UpdateSolverCoefficients();
+}
+
+void ACausticBody::UpdateSolverCoefficients()
+{
+	SolverCoefficients = Caustic::ComputeSolverCoefficients(LiquidParam);
+	Caustic::WarnSolverClamp(LiquidParam, SolverCoefficients, GetName());
+}
+
+bool ACausticBody::IsSimulationReady()
+{
+	if (!bSimulationReady)
+	{
+		bSimulationReady = DepthRenderTarget && DepthRenderTarget->Resource && FrameGraph->IsReady();
+	}
+
+	return bSimulationReady;
+}
+
+bool ACausticBody::UpdateInteractors()
+{
+	bool bMoved = false;
+
+	const FTransform& BodyTransform = GetActorTransform();
+	const FVector SurfaceUp = BodyTransform.GetUnitAxis(EAxis::Z);
+	const FVector SurfaceOrigin = BodyTransform.TransformPosition(FVector(0.0f, 0.0f, GetSurfaceZ()));
+
+	for (TWeakObjectPtr<UPrimitiveComponent> Comp : ComponentsToDrawDepth)
+	{
+		UPrimitiveComponent* Component = Comp.Get();
+		if (!Component)
+		{
+			continue;
+		}
+
+		const FTransform& Current = Component->GetComponentTransform();
+		const FBoxSphereBounds& CurrentBounds = Component->Bounds;
+		FCausticInteractorState* Previous = InteractorStates.Find(Comp);
+		if (!Previous)
+		{
+			InteractorStates.Add(Comp, { Current, CurrentBounds });
+			bMoved = true;
+			continue;
+		}
+
+		// Resting rigid bodies still jitter a little, that must not keep the body awake. Skinned and
+		// animated components change shape in place, their bounds move while the transform does not
+		const bool bBoundsChanged =
+			!Previous->Bounds.Origin.Equals(CurrentBounds.Origin, 0.01f) ||
+			!Previous->Bounds.BoxExtent.Equals(CurrentBounds.BoxExtent, 0.01f);
+
+		if (Previous->Transform.Equals(Current, 0.01f) && !bBoundsChanged)
+		{
+			continue;
+		}
+
+		bMoved = true;
+
+		// Only motion along the surface of an interactor that crosses it drags a wake
+		const FVector Step = FVector::VectorPlaneProject(Current.GetLocation() - Previous->Transform.GetLocation(), SurfaceUp);
+		const FVector Center = Component->Bounds.Origin;
+		const float Radius = Component->Bounds.SphereRadius;
+		const float SurfaceDistance = FVector::DotProduct(Center - SurfaceOrigin, SurfaceUp);
+
+		if (WakeStrength > 0.0f && Radius > KINDA_SMALL_NUMBER && FMath::Abs(SurfaceDistance) <= Radius && !Step.IsNearlyZero())
+		{
+			// The trough opens at the stern, where the displaced volume is leaving
+			const FVector Stern = Center - SurfaceUp * SurfaceDistance - Step.GetSafeNormal() * Radius;
+			AddImpulse(Stern, Radius, -FMath::Min(WakeStrength * Step.Size() / Radius, 1.0f));
+		}
+
+		Previous->Transform = Current;
+		Previous->Bounds = CurrentBounds;
+	}
+
+	// An interactor that left gives its displaced volume back, which disturbs the surface like an entry
+	for (auto It = InteractorStates.CreateIterator(); It; ++It)
+	{
+		if (!It.Key().IsValid() || !ComponentsToDrawDepth.Contains(It.Key()))
+		{
+			It.RemoveCurrent();
+			bMoved = true;
+		}
+	}
+
+	return bMoved;
+}
+
+bool ACausticBody::IsSettled() const
+{
+	// Sources that never stop, or a step count that replays rely on
+	if (AmbientWaveSpectrum.IsValid() || bDeterministicSimulation || bObstacleMaskPending)
+	{
+		return false;
+	}
+
+	if (InteractionForce == ECausticInteractionForce::Penetration && ComponentsToDrawDepth.Num() > 0)
+	{
+		return false;
+	}
+
+	const float Threshold = CVarCausticSleepThreshold.GetValueOnGameThread();
+	const float Attenuation = LiquidParam.AttenuationCoefficient;
+	if (Threshold <= 0.0f || Attenuation >= 1.0f)
+	{
+		return false;
+	}
+
+	// Heights shrink by the attenuation every step, so the decay time is known without reading the field back
+	const float StepsToSettle = (Attenuation > 0.0f && Threshold < 1.0f) ? FMath::Loge(Threshold) / FMath::Loge(Attenuation) : 1.0f;
+
+	return QuietSteps >= (uint32)FMath::CeilToInt(StepsToSettle);
+}
+
+float ACausticBody::GetSurfaceZ() const
+{
+	return DepthCaptureComp->GetRelativeTransform().GetLocation().Z;
+}
+
+bool ACausticBody::IsVisibleInAnyView() const
+{
+	// Views render after the tick, so last frame's views are the newest; one more frame covers views rendered every other frame
+	return GFrameCounter - LastVisibleFrame <= 2;
+}
+
+FBoxSphereBounds ACausticBody::GetVisibilityBounds() const
+{
+	return BoxCollisionComp->Bounds;
+}
+
+bool ACausticBody::IsOwnCaptureTarget(const FRenderTarget* RenderTarget) const
+{
+	auto IsTarget = [RenderTarget](UTextureRenderTarget2D* Target)
+	{
+		return Target && Target->GameThread_GetRenderTargetResource() == RenderTarget;
+	};
+
+	return RenderTarget && (IsTarget(DepthRenderTarget) || IsTarget(ObstacleMaskRenderTarget));
+}
+
+void ACausticBody::BakeObstacleMask()
+{
+	if (!ObstacleMaskRenderTarget)
+	{
+		ObstacleMaskRenderTarget = NewObject<UTextureRenderTarget2D>(this);
+		ObstacleMaskRenderTarget->RenderTargetFormat = RTF_R16f;
+		ObstacleMaskRenderTarget->ClearColor = FLinearColor::Black;
+		ObstacleMaskRenderTarget->SizeX = LiquidParam.DepthTextureWidth;
+		ObstacleMaskRenderTarget->SizeY = LiquidParam.DepthTextureHeight;
+		ObstacleMaskRenderTarget->UpdateResource();
+	}
+
+	// Lift the capture a body depth above the surface, so geometry crossing the surface is not near clipped
+	const FTransform SurfaceTransform = DepthCaptureComp->GetRelativeTransform();
+	DepthCaptureComp->AddRelativeLocation(FVector(0.0f, 0.0f, BodyDepth));
+	DepthCaptureComp->TextureTarget = ObstacleMaskRenderTarget;
+	DepthCaptureComp->PrimitiveRenderMode = ESceneCapturePrimitiveRenderMode::PRM_RenderScenePrimitives;
+	DepthCaptureComp->HiddenActors.Add(this);
+
+	DepthCaptureComp->CaptureScene();
+
+	DepthCaptureComp->HiddenActors.Remove(this);
+	DepthCaptureComp->PrimitiveRenderMode = ESceneCapturePrimitiveRenderMode::PRM_UseShowOnlyList;
+	DepthCaptureComp->TextureTarget = DepthRenderTarget;
+	DepthCaptureComp->SetRelativeTransform(SurfaceTransform);
+
+	bObstacleMaskPending = true;
+}
+
 void ACausticBody::GenerateSurfaceMesh()
 {
 	const int32 SizeX = FMath::RoundToInt(BodyWidth / CellSize);
@@ -328,6 +1145,7 @@ void ACausticBody::OnBoxBeginOverlap(
 	const FHitResult&    SweepResult)
 {
 	ComponentsToDrawDepth.AddUnique(OtherComp);
+	QuietSteps = 0;
 }
 
 void ACausticBody::OnBoxEndOverlap(
@@ -337,6 +1155,7 @@ void ACausticBody::OnBoxEndOverlap(
 	int32                OtherBodyIndex)
 {
 	ComponentsToDrawDepth.RemoveSwap(OtherComp);
+	QuietSteps = 0;
 }
 
 // Called every frame
@@ -344,24 +1163,384 @@ void ACausticBody::Tick(float DeltaTime)
 {
 	Super::Tick(DeltaTime);
 
+	if (!IsSimulationReady())
+	{
+		return;
+	}
+
+	// However many views or ticks a frame has, the simulation advances once
+	if (LastSimulatedFrame == GFrameCounter)
+	{
+		return;
+	}
+
+	// A hidden body keeps its state and stops capturing until some view sees it again. Queued impulses wait for
+	// that step, AddImpulse caps them at r.Caustic.MaxImpulsesPerStep however long the body stays hidden
+	if (!bSimulateWhenHidden && !IsVisibleInAnyView())
+	{
+		DepthCaptureComp->bCaptureEveryFrame = false;
+		bDepthCapturedLastFrame = false;
+		return;
+	}
+
+	LastSimulatedFrame = GFrameCounter;
+
+	const bool bPlayFlipbook = ShouldPlayFlipbook();
+
+	// Anything that moved, entered or was pushed wakes the body, otherwise it counts towards settling
+	const bool bDisturbed = UpdateInteractors() || PendingImpulses.Num() > 0;
+	QuietSteps = bDisturbed ? 0 : QuietSteps + 1;
+
+	// A settled body keeps its last output and skips the capture and every pass until something moves
+	const bool bSleep = !bPlayFlipbook && IsSettled();
+	if (bSleep != bSleeping)
+	{
+		bSleeping = bSleep;
+		if (bSleeping)
+		{
+			INC_DWORD_STAT(STAT_CausticSleepingBodies);
+		}
+		else
+		{
+			DEC_DWORD_STAT(STAT_CausticSleepingBodies);
+		}
+	}
+
+	if (bSleeping)
+	{
+		DepthCaptureComp->bCaptureEveryFrame = false;
+		bDepthCapturedLastFrame = false;
+		return;
+	}
+
+	// Snapshot the parameters for this frame, the render thread never reads LiquidParam directly
+	FCausticFrameInputs FrameInputs;
+	SetupFrameParams(FrameInputs, bDeterministicSimulation ? SimulationStep * Caustic::SimulationStepTime : GetWorld()->GetTimeSeconds());
+	FrameInputs.DepthTargetResource = DepthRenderTarget->GameThread_GetRenderTargetResource();
+
+	// Nothing can disturb a body that plays its flipbook, and an empty body has nothing to capture
+	const bool bHasInteractors = !bPlayFlipbook && ComponentsToDrawDepth.Num() > 0;
+	const bool bCaptureDepth = bHasInteractors && InteractionSource == ECausticInteractionSource::SceneCapture;
+
+	// Captures render after the tick, so this frame reads last frame's capture and only if there was one
+	FrameInputs.bDepthCaptured = bCaptureDepth && bDepthCapturedLastFrame;
+	FrameInputs.bHasInteractors = bHasInteractors;
+	DepthCaptureComp->bCaptureEveryFrame = bCaptureDepth;
+	bDepthCapturedLastFrame = bCaptureDepth;
+
 	// Set up components that need to be drawn
 	DepthCaptureComp->ClearShowOnlyComponents();
+	DepthMeshReferences.Reset();
 
-	for (TWeakObjectPtr<UPrimitiveComponent> Comp : ComponentsToDrawDepth)
+	if (bCaptureDepth)
 	{
-		DepthCaptureComp->ShowOnlyComponent(Comp.Get());
+		for (TWeakObjectPtr<UPrimitiveComponent> Comp : ComponentsToDrawDepth)
+		{
+			DepthCaptureComp->ShowOnlyComponent(Comp.Get());
+		}
+	}
+	else if (bHasInteractors)
+	{
+		const FTransform SurfaceTransform = FTransform(FVector(0.0f, 0.0f, GetSurfaceZ())) * GetActorTransform();
+
+		const bool bDrawMeshes = InteractionSource == ECausticInteractionSource::StaticMeshes;
+		const int32 MaxDepthProxies = CVarCausticMaxDepthProxies.GetValueOnGameThread();
+
+		for (TWeakObjectPtr<UPrimitiveComponent> Comp : ComponentsToDrawDepth)
+		{
+			if (UPrimitiveComponent* Component = Comp.Get())
+			{
+				// Meshes are not capped, each one is a draw call rather than a slot every texel traces
+				if (bDrawMeshes && Caustic::GatherDepthMesh(*Component, SurfaceTransform, FrameInputs.DepthMeshes, DepthMeshReferences))
+				{
+					continue;
+				}
+
+				const int32 FirstProxy = FrameInputs.DepthProxies.Num();
+				Caustic::GatherDepthProxies(*Component, SurfaceTransform, FrameInputs.DepthProxies);
+
+				// Whole components are dropped, so no shape is traced without the rest of its component
+				if (FrameInputs.DepthProxies.Num() > MaxDepthProxies)
+				{
+					FrameInputs.DepthProxies.SetNum(FirstProxy);
+
+					if (!bWarnedDepthProxyCap)
+					{
+						bWarnedDepthProxyCap = true;
+						UE_LOG(LogCaustic, Warning, TEXT("%s: more than %d proxy slots in one step, the rest are dropped. See r.Caustic.MaxDepthProxies"), *GetName(), MaxDepthProxies);
+					}
+					break;
+				}
+			}
+		}
+
+		FrameInputs.BodySize = FVector2D(BodyWidth, BodyHeight);
+	}
+	FrameInputs.CausticTargetResource = CausticRenderTarget ? CausticRenderTarget->GameThread_GetRenderTargetResource() : nullptr;
+
+	// The bake capture was enqueued before this frame, so the mask pass reads a finished capture
+	if (bObstacleMaskPending && ObstacleMaskRenderTarget)
+	{
+		bObstacleMaskPending = false;
+		FrameInputs.ObstacleMaskResource = ObstacleMaskRenderTarget->GameThread_GetRenderTargetResource();
+		FrameInputs.ObstacleDepth = BodyDepth;
+	}
+
+	FrameInputs.Impulses = MoveTemp(PendingImpulses);
+	PendingImpulses.Reset();
+
+	if (bPlayFlipbook)
+	{
+		const float FrameTime = BakedFlipbookFrameStep * Caustic::SimulationStepTime;
+
+		FCausticFlipbookFrame& Flipbook = FrameInputs.Flipbook;
+		Flipbook.Resource = CausticFlipbook->Resource;
+		Flipbook.Columns = FlipbookColumns;
+		Flipbook.FrameCount = BakedFlipbookFrameCount;
+		Flipbook.Position = FMath::Fmod(GetWorld()->GetTimeSeconds() / FrameTime, (float)BakedFlipbookFrameCount);
+	}
+
+#if !UE_BUILD_SHIPPING
+	// Debug targets are only written on the frame a capture is requested
+	if (LastDebugCaptureSerial != Caustic::GetDebugCaptureSerial())
+	{
+		LastDebugCaptureSerial = Caustic::GetDebugCaptureSerial();
+
+		auto GetTargetResource = [](UTextureRenderTarget2D* RenderTarget)
+		{
+			return RenderTarget ? RenderTarget->GameThread_GetRenderTargetResource() : nullptr;
+		};
+
+		FCausticDebugCapture& DebugCapture = FrameInputs.DebugCapture;
+		DebugCapture.Stages = Caustic::GetDebugCaptureStages();
+		DebugCapture.DepthTarget = GetTargetResource(SurfaceDepthPassDebugTexture);
+		DebugCapture.HeightTarget = GetTargetResource(SurfaceHeightPassDebugTexture);
+		DebugCapture.NormalTarget = GetTargetResource(SurfaceNormalPassDebugTexture);
+		DebugCapture.CausticTarget = GetTargetResource(SurfaceCausticPassDebugTexture);
+	}
+#endif
+
+	// Render depth, height, normal and caustic passes in a single render command
+	FrameGraph->Render(MoveTemp(FrameInputs));
+
+	if (!bPlayFlipbook)
+	{
+		++SimulationStep;
+	}
+}
+
+void ACausticBody::AddImpulse(FVector Location, float Radius, float Strength)
+{
+	// A body refused by the memory budget never steps, so nothing would ever consume the queue
+	if (ReservedGpuMemory == 0 || Radius <= 0.0f || Strength == 0.0f || BodyWidth <= 0.0f || BodyHeight <= 0.0f)
+	{
+		return;
+	}
+
+	// The capture maps body X and Y straight onto U and V and sees down to BodyDepth below the surface
+	const FTransform& BodyTransform = GetActorTransform();
+	const FVector Local = BodyTransform.InverseTransformPosition(Location);
+	const FVector Scale = BodyTransform.GetScale3D().GetAbs();
+	const FVector LocalRadius = Radius / Scale.ComponentMax(FVector(SMALL_NUMBER));
+
+	// Drops are usually reported on the surface or slightly above it, anything past the falloff misses the body
+	if (FMath::Abs(Local.X) > BodyWidth / 2 + LocalRadius.X ||
+		FMath::Abs(Local.Y) > BodyHeight / 2 + LocalRadius.Y ||
+		Local.Z > GetSurfaceZ() + LocalRadius.Z ||
+		Local.Z < GetSurfaceZ() - BodyDepth)
+	{
+		return;
+	}
+
+	const int32 MaxImpulses = CVarCausticMaxImpulsesPerStep.GetValueOnGameThread();
+	if (PendingImpulses.Num() >= MaxImpulses)
+	{
+		if (!bWarnedImpulseCap)
+		{
+			bWarnedImpulseCap = true;
+			UE_LOG(LogCaustic, Warning, TEXT("%s: more than %d impulses in one step, the rest are dropped. See r.Caustic.MaxImpulsesPerStep"), *GetName(), MaxImpulses);
+		}
+		return;
+	}
+
+	FSurfaceImpulse& Impulse = PendingImpulses.AddDefaulted_GetRef();
+	Impulse.Center = FVector2D(Local.X / BodyWidth + 0.5f, Local.Y / BodyHeight + 0.5f);
+	Impulse.InvRadius = FVector2D(BodyWidth / LocalRadius.X, BodyHeight / LocalRadius.Y);
+	Impulse.Strength = Strength;
+}
+
+void ACausticBody::AddImpulses(const TArray<FCausticImpulse>& Impulses)
+{
+	for (const FCausticImpulse& Impulse : Impulses)
+	{
+		AddImpulse(Impulse.Location, Impulse.Radius, Impulse.Strength);
+	}
+}
+
+void ACausticBody::AddWorldImpulses(const UObject* WorldContextObject, const TArray<FCausticImpulse>& Impulses)
+{
+	UWorld* World = GEngine ? GEngine->GetWorldFromContextObject(WorldContextObject, EGetWorldErrorMode::LogAndReturnNull) : nullptr;
+	if (!World)
+	{
+		return;
+	}
+
+	// Bodies are few and impulses many, so each body takes the whole batch and drops what misses it
+	for (TActorIterator<ACausticBody> It(World); It; ++It)
+	{
+		It->AddImpulses(Impulses);
+	}
+}
+
+void ACausticBody::SetupFrameParams(FCausticFrameInputs& FrameInputs, float AmbientTime) const
+{
+	FrameInputs.Params = FCausticFrameParams::Create(LiquidParam, SolverCoefficients);
+	FrameInputs.Params.TemporalBlendWeight = bTemporalFilter ? TemporalBlendWeight : 1.0f;
+	FrameInputs.Params.CausticBlurRadius = CausticBlurRadius;
+	FrameInputs.Params.InteractionForce = InteractionForce;
+
+	// The light follows the sun every frame, in body space so a rotated body still lands its caustics right
+	if (CausticLight)
+	{
+		FrameInputs.Params.LightDirection = GetActorTransform().InverseTransformVectorNoScale(CausticLight->GetActorForwardVector());
+	}
+
+	if (AmbientWaveSpectrum.IsValid())
+	{
+		const float PatchSize = FMath::Max(AmbientWave.PatchSize, 1.0f);
+		FrameInputs.Params.AmbientTiling = FVector2D(BodyWidth / PatchSize, BodyHeight / PatchSize);
+		FrameInputs.Params.AmbientAmplitude = AmbientWave.Amplitude;
+		FrameInputs.AmbientWaves = AmbientWaveSpectrum;
+		FrameInputs.AmbientTime = AmbientTime;
+	}
+}
+
+bool ACausticBody::ShouldPlayFlipbook() const
+{
+	// The flipbook knows nothing of interactors, anything inside the body hands it back to the live simulation
+	return bUseCausticFlipbook && CausticFlipbook && CausticFlipbook->Resource && ComponentsToDrawDepth.Num() == 0 && PendingImpulses.Num() == 0 && CausticFlipbookPassRenderer->IsReady();
+}
+
+TFuture<TSharedPtr<FCausticSnapshot, ESPMode::ThreadSafe>> ACausticBody::CaptureSnapshot()
+{
+	using FSnapshotPtr = TSharedPtr<FCausticSnapshot, ESPMode::ThreadSafe>;
+
+	/** Owned by the render commands and the ticker that polls it, so it resolves even if the body goes away first */
+	struct FSnapshotCapture
+	{
+		FSnapshotPtr                           Snapshot;
+		TPromise<FSnapshotPtr>                 Promise;
+		TUniquePtr<FSurfaceStateReadback>      Readback;
+		FThreadSafeBool                        bResolved;
+	};
+
+	TSharedRef<FSnapshotCapture, ESPMode::ThreadSafe> Capture = MakeShared<FSnapshotCapture, ESPMode::ThreadSafe>();
+	TFuture<FSnapshotPtr> Future = Capture->Promise.GetFuture();
+
+	if (!IsSimulationReady())
+	{
+		Capture->Promise.SetValue(nullptr);
+		return Future;
 	}
 
-	// Render surface depth pass
-	FRHITexture* DepthTextureRef = DepthRenderTarget->TextureReference.TextureReferenceRHI->GetTextureReference()->GetReferencedTexture();
-	SurfaceDepthPassRenderer->Render(LiquidParam, DepthTextureRef);
+	// Everything but the height frames is known on the game thread at the step the readback will see
+	Capture->Snapshot = MakeShared<FCausticSnapshot, ESPMode::ThreadSafe>();
+	Capture->Snapshot->Width = LiquidParam.DepthTextureWidth;
+	Capture->Snapshot->Height = LiquidParam.DepthTextureHeight;
+	Capture->Snapshot->SimulationStep = SimulationStep;
+	Capture->Snapshot->LiquidParam = LiquidParam;
+
+	ENQUEUE_RENDER_COMMAND(CausticSnapshotCaptureCommand)
+	(
+		[Renderer = SurfaceDepthPassRenderer, Capture](FRHICommandListImmediate& RHICmdList)
+		{
+			Capture->Readback = MakeUnique<FSurfaceStateReadback>();
+			Renderer->ReadbackState_RenderThread(RHICmdList, *Capture->Readback);
+		}
+	);
 
-	// Render surface normal pass
-	FShaderResourceViewRHIRef HeightTextureSRV = SurfaceDepthPassRenderer->GetHeightTextureSRV();
-	SurfaceNormalPassRenderer->Render(HeightTextureSRV);
+	// Polled once a frame until the GPU has written the copy, nothing waits on it
+	FTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateLambda([Capture](float DeltaTime)
+	{
+		if (Capture->bResolved)
+		{
+			return false;
+		}
 
-	// Render surface caustic pass
-	FShaderResourceViewRHIRef NormalTextureSRV = SurfaceNormalPassRenderer->GetNormalTextureSRV();
-	SurfaceCausticPassRenderer->Render(LiquidParam, NormalTextureSRV, SurfaceCausticPassDebugTexture);
+		ENQUEUE_RENDER_COMMAND(CausticSnapshotPollCommand)
+		(
+			[Capture](FRHICommandListImmediate& RHICmdList)
+			{
+				if (Capture->bResolved || !Capture->Readback.IsValid() || !Capture->Readback->IsReady())
+				{
+					return;
+				}
+
+				TSharedRef<TArray<FFloat16Color>, ESPMode::ThreadSafe> Current = MakeShared<TArray<FFloat16Color>, ESPMode::ThreadSafe>();
+				TSharedRef<TArray<FFloat16Color>, ESPMode::ThreadSafe> Previous = MakeShared<TArray<FFloat16Color>, ESPMode::ThreadSafe>();
+				TSharedRef<TArray<FFloat16>, ESPMode::ThreadSafe> Displacement = MakeShared<TArray<FFloat16>, ESPMode::ThreadSafe>();
+				const bool bRead = Capture->Readback->Resolve_RenderThread(RHICmdList, *Current, *Previous, *Displacement);
+
+				Capture->Readback.Reset();
+				Capture->bResolved = true;
+
+				// Compression would stall the render thread, hand it to the pool
+				Async(EAsyncExecution::ThreadPool, [Capture, Current, Previous, Displacement, bRead]()
+				{
+					const bool bCompressed = bRead && Capture->Snapshot->CompressHeight(*Current, *Previous) && Capture->Snapshot->CompressDisplacement(*Displacement);
+					Capture->Promise.SetValue(bCompressed ? Capture->Snapshot : nullptr);
+				});
+			}
+		);
+
+		return true;
+	}));
+
+	return Future;
 }
 
+bool ACausticBody::RestoreSnapshot(const FCausticSnapshot& Snapshot)
+{
+	if (!IsSimulationReady())
+	{
+		return false;
+	}
+
+	// The texture size is fixed at BeginPlay, a snapshot of another resolution can't be resampled into it
+	if (Snapshot.Width != (uint32)LiquidParam.DepthTextureWidth || Snapshot.Height != (uint32)LiquidParam.DepthTextureHeight)
+	{
+		UE_LOG(LogCaustic, Warning, TEXT("%s: snapshot is %ux%u, the body simulates at %dx%d"), *GetName(), Snapshot.Width, Snapshot.Height, LiquidParam.DepthTextureWidth, LiquidParam.DepthTextureHeight);
+		return false;
+	}
+
+	TArray<FFloat16Color> Current;
+	TArray<FFloat16Color> Previous;
+	TArray<FFloat16> Displacement;
+	if (!Snapshot.DecompressHeight(Current, Previous) || !Snapshot.DecompressDisplacement(Displacement))
+	{
+		UE_LOG(LogCaustic, Warning, TEXT("%s: snapshot height data is corrupt"), *GetName());
+		return false;
+	}
+
+	LiquidParam = Snapshot.LiquidParam;
+	UpdateSolverCoefficients();
+	SimulationStep = Snapshot.SimulationStep;
+	QuietSteps = 0;
+
+	// Interactors are compared against where they were at the restored step, not the step before the restore
+	InteractorStates.Reset();
+
+	// Enqueued after this frame's render command, so the next step starts from the restored frames
+	ENQUEUE_RENDER_COMMAND(CausticSnapshotRestoreCommand)
+	(
+		[Renderer = SurfaceDepthPassRenderer, TemporalRenderer = CausticTemporalPassRenderer, Current = MoveTemp(Current), Previous = MoveTemp(Previous), Displacement = MoveTemp(Displacement)](FRHICommandListImmediate& RHICmdList)
+		{
+			Renderer->RestoreState_RenderThread(RHICmdList, Current, Previous, Displacement);
+
+			// Filtered history belongs to the old state
+			TemporalRenderer->ResetHistory();
+		}
+	);
+
+	return true;
+}
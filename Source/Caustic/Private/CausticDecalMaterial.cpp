@@ -0,0 +1,102 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#include "CausticDecalMaterial.h"
+
+#if WITH_EDITOR
+
+#include "Materials/Material.h"
+#include "Materials/MaterialExpressionCustom.h"
+#include "Materials/MaterialExpressionScalarParameter.h"
+#include "Materials/MaterialExpressionTextureObjectParameter.h"
+#include "Materials/MaterialExpressionVectorParameter.h"
+#include "Materials/MaterialExpressionWorldPosition.h"
+#include "AssetRegistryModule.h"
+#include "UObject/Package.h"
+
+const TCHAR* Caustic::DecalMaterialPackageName = TEXT("/Caustic/Materials/M_CausticDecal");
+
+namespace
+{
+	template<typename ExpressionType>
+	ExpressionType* AddExpression(UMaterial* Material, UMaterialExpressionCustom* Custom, const TCHAR* InputName)
+	{
+		ExpressionType* Expression = NewObject<ExpressionType>(Material, NAME_None, RF_Transactional);
+		Expression->MaterialExpressionEditorX = -500;
+		Expression->MaterialExpressionEditorY = Custom->Inputs.Num() * 100;
+		Material->Expressions.Add(Expression);
+
+		FCustomInput& Input = Custom->Inputs.AddDefaulted_GetRef();
+		Input.InputName = InputName;
+		Input.Input.Expression = Expression;
+
+		return Expression;
+	}
+
+	void AddVectorParameter(UMaterial* Material, UMaterialExpressionCustom* Custom, const TCHAR* InputName, FName ParameterName, const FLinearColor& DefaultValue)
+	{
+		UMaterialExpressionVectorParameter* Parameter = AddExpression<UMaterialExpressionVectorParameter>(Material, Custom, InputName);
+		Parameter->ParameterName = ParameterName;
+		Parameter->DefaultValue = DefaultValue;
+	}
+
+	void AddScalarParameter(UMaterial* Material, UMaterialExpressionCustom* Custom, const TCHAR* InputName, FName ParameterName, float DefaultValue)
+	{
+		UMaterialExpressionScalarParameter* Parameter = AddExpression<UMaterialExpressionScalarParameter>(Material, Custom, InputName);
+		Parameter->ParameterName = ParameterName;
+		Parameter->DefaultValue = DefaultValue;
+	}
+}
+
+UMaterialInterface* Caustic::FindOrCreateDecalMaterial()
+{
+	const FString PackageName = DecalMaterialPackageName;
+	const FString AssetName = FPackageName::GetLongPackageAssetName(PackageName);
+
+	if (UMaterialInterface* ExistingMaterial = LoadObject<UMaterialInterface>(nullptr, *(PackageName + TEXT(".") + AssetName), nullptr, LOAD_NoWarn | LOAD_Quiet))
+	{
+		return ExistingMaterial;
+	}
+
+	UPackage* Package = CreatePackage(nullptr, *PackageName);
+	UMaterial* Material = NewObject<UMaterial>(Package, *AssetName, RF_Public | RF_Standalone | RF_Transactional);
+
+	// Emissive decals add their light on top of the lit receivers
+	Material->MaterialDomain = MD_DeferredDecal;
+	Material->BlendMode = BLEND_Translucent;
+	Material->DecalBlendMode = DBM_Emissive;
+
+	UMaterialExpressionCustom* Custom = NewObject<UMaterialExpressionCustom>(Material, NAME_None, RF_Transactional);
+	Custom->Description = TEXT("CausticDecalShade");
+	Custom->OutputType = CMOT_Float3;
+	Custom->IncludeFilePaths.Add(TEXT("/Plugin/Caustic/CausticDecal.ush"));
+	Custom->Code = TEXT("return CausticDecalShade(CausticTexture, CausticTextureSampler, WorldPosition, BodyOrigin, BodyAxisX, BodyAxisY, BodyAxisZ, BodyExtent, BodyScaleZ, Intensity, DepthFalloff);");
+	Custom->Inputs.Reset();
+	Material->Expressions.Add(Custom);
+
+	// Input names match the Code above, parameter names match the ones ACausticBody sets on its decal instance
+	UMaterialExpressionTextureObjectParameter* CausticTexture = AddExpression<UMaterialExpressionTextureObjectParameter>(Material, Custom, TEXT("CausticTexture"));
+	CausticTexture->ParameterName = TEXT("CausticTexture");
+
+	// The decal reconstructs the receiver position from scene depth
+	AddExpression<UMaterialExpressionWorldPosition>(Material, Custom, TEXT("WorldPosition"));
+
+	AddVectorParameter(Material, Custom, TEXT("BodyOrigin"), TEXT("CausticBodyOrigin"), FLinearColor::Black);
+	AddVectorParameter(Material, Custom, TEXT("BodyAxisX"), TEXT("CausticBodyAxisX"), FLinearColor(1.0f, 0.0f, 0.0f));
+	AddVectorParameter(Material, Custom, TEXT("BodyAxisY"), TEXT("CausticBodyAxisY"), FLinearColor(0.0f, 1.0f, 0.0f));
+	AddVectorParameter(Material, Custom, TEXT("BodyAxisZ"), TEXT("CausticBodyAxisZ"), FLinearColor(0.0f, 0.0f, 1.0f));
+	AddVectorParameter(Material, Custom, TEXT("BodyExtent"), TEXT("CausticBodyExtent"), FLinearColor(512.0f, 512.0f, 0.0f));
+	AddScalarParameter(Material, Custom, TEXT("BodyScaleZ"), TEXT("CausticBodyScaleZ"), 1.0f);
+	AddScalarParameter(Material, Custom, TEXT("Intensity"), TEXT("CausticIntensity"), 1.0f);
+	AddScalarParameter(Material, Custom, TEXT("DepthFalloff"), TEXT("CausticDepthFalloff"), 256.0f);
+
+	Material->EmissiveColor.Expression = Custom;
+
+	// Compiles the shaders, the package still has to be saved with the level that references it
+	Material->PostEditChange();
+	FAssetRegistryModule::AssetCreated(Material);
+	Package->MarkPackageDirty();
+
+	return Material;
+}
+
+#endif
@@ -0,0 +1,24 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+#if WITH_EDITOR
+
+class UMaterialInterface;
+
+namespace Caustic
+{
+	/** Long package name of the receiver decal material inside the plugin content */
+	extern const TCHAR* DecalMaterialPackageName;
+
+	/**
+	 * Loads the plugin's caustic receiver decal material, building it the first time. Its Custom node calls CausticDecalShade
+	 * from /Plugin/Caustic/CausticDecal.ush, which does the body space projection and the depth attenuation. A newly built
+	 * material is left dirty for the editor to save.
+	 */
+	UMaterialInterface* FindOrCreateDecalMaterial();
+}
+
+#endif
@@ -0,0 +1,120 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#include "CausticDepthProxies.h"
+#include "Components/PrimitiveComponent.h"
+#include "Components/StaticMeshComponent.h"
+#include "Components/InstancedStaticMeshComponent.h"
+#include "Engine/StaticMesh.h"
+#include "StaticMeshResources.h"
+#include "PhysicsEngine/BodySetup.h"
+#include "PhysicsEngine/AggregateGeom.h"
+
+namespace
+{
+	void AddBox(const FTransform& ElemToSurface, const FVector& Center, const FVector& Extent, TArray<FSurfaceDepthProxy>& OutProxies)
+	{
+		// Non uniform scale is applied along the element axes, a sheared box is traced as the box around it
+		OutProxies.Add(FSurfaceDepthProxy::MakeBox(
+			ElemToSurface.TransformPosition(Center),
+			Extent * ElemToSurface.GetScale3D().GetAbs(),
+			ElemToSurface.TransformVectorNoScale(FVector::ForwardVector),
+			ElemToSurface.TransformVectorNoScale(FVector::RightVector)));
+	}
+
+	void AddConvex(const FTransform& ElemToSurface, const FKConvexElem& Convex, TArray<FSurfaceDepthProxy>& OutProxies)
+	{
+		TArray<FPlane> Planes;
+		Convex.GetPlanes(Planes);
+
+		// Hulls without cooked planes are traced as their bounding box
+		if (Planes.Num() == 0)
+		{
+			AddBox(ElemToSurface, Convex.ElemBox.GetCenter(), Convex.ElemBox.GetExtent(), OutProxies);
+			return;
+		}
+
+		const FMatrix ElemToSurfaceMatrix = ElemToSurface.ToMatrixWithScale();
+		OutProxies.Add(FSurfaceDepthProxy::MakeConvex(Convex.ElemBox.TransformBy(ElemToSurfaceMatrix), Planes.Num()));
+
+		const int32 FirstSlot = OutProxies.AddZeroed(FSurfaceDepthProxy::GetConvexPlaneSlots(Planes.Num()));
+		for (int32 PlaneIndex = 0; PlaneIndex < Planes.Num(); ++PlaneIndex)
+		{
+			const FPlane Plane = Planes[PlaneIndex].TransformBy(ElemToSurfaceMatrix);
+
+			FSurfaceDepthProxy& Slot = OutProxies[FirstSlot + PlaneIndex / 4];
+			FVector4* SlotPlanes[] = { &Slot.P0, &Slot.P1, &Slot.P2, &Slot.P3 };
+			*SlotPlanes[PlaneIndex % 4] = FVector4(Plane.X, Plane.Y, Plane.Z, Plane.W);
+		}
+	}
+}
+
+void Caustic::GatherDepthProxies(UPrimitiveComponent& Component, const FTransform& SurfaceTransform, TArray<FSurfaceDepthProxy>& OutProxies)
+{
+	const FTransform ComponentToSurface = Component.GetComponentTransform().GetRelativeTransform(SurfaceTransform);
+	const int32 FirstProxy = OutProxies.Num();
+
+	if (const UBodySetup* BodySetup = Component.GetBodySetup())
+	{
+		const FKAggregateGeom& AggGeom = BodySetup->AggGeom;
+
+		for (const FKSphereElem& Sphere : AggGeom.SphereElems)
+		{
+			const FVector Center = ComponentToSurface.TransformPosition(Sphere.Center);
+			OutProxies.Add(FSurfaceDepthProxy::MakeCapsule(Center, Center, Sphere.Radius * ComponentToSurface.GetMaximumAxisScale()));
+		}
+
+		for (const FKSphylElem& Sphyl : AggGeom.SphylElems)
+		{
+			// Sphyls run along their local Z, Length is the distance between the cap centres
+			const FTransform ElemToSurface = Sphyl.GetTransform() * ComponentToSurface;
+			const FVector HalfSegment(0.0f, 0.0f, Sphyl.Length / 2);
+			OutProxies.Add(FSurfaceDepthProxy::MakeCapsule(
+				ElemToSurface.TransformPosition(-HalfSegment),
+				ElemToSurface.TransformPosition(HalfSegment),
+				Sphyl.Radius * ComponentToSurface.GetMaximumAxisScale()));
+		}
+
+		for (const FKBoxElem& Box : AggGeom.BoxElems)
+		{
+			AddBox(Box.GetTransform() * ComponentToSurface, FVector::ZeroVector, FVector(Box.X, Box.Y, Box.Z) / 2, OutProxies);
+		}
+
+		for (const FKConvexElem& Convex : AggGeom.ConvexElems)
+		{
+			AddConvex(Convex.GetTransform() * ComponentToSurface, Convex, OutProxies);
+		}
+	}
+
+	if (OutProxies.Num() == FirstProxy)
+	{
+		const FBoxSphereBounds LocalBounds = Component.CalcLocalBounds();
+		AddBox(ComponentToSurface, LocalBounds.Origin, LocalBounds.BoxExtent, OutProxies);
+	}
+}
+
+bool Caustic::GatherDepthMesh(UPrimitiveComponent& Component, const FTransform& SurfaceTransform, TArray<FSurfaceDepthMesh>& OutMeshes, TArray<UStaticMesh*>& OutReferencedMeshes)
+{
+	// Instances would need their own transforms, they are left to their collision
+	UStaticMeshComponent* StaticMeshComponent = Cast<UStaticMeshComponent>(&Component);
+	if (!StaticMeshComponent || Component.IsA<UInstancedStaticMeshComponent>())
+	{
+		return false;
+	}
+
+	UStaticMesh* StaticMesh = StaticMeshComponent->GetStaticMesh();
+	const FStaticMeshRenderData* RenderData = StaticMesh ? StaticMesh->RenderData.Get() : nullptr;
+	if (!RenderData || RenderData->LODResources.Num() == 0)
+	{
+		return false;
+	}
+
+	// The most detailed LOD that is streamed in, the depth texture is coarse enough that lower LODs would do but their screen sizes are not known here
+	const int32 LODIndex = FMath::Clamp<int32>(RenderData->CurrentFirstLODIdx, 0, RenderData->LODResources.Num() - 1);
+
+	FSurfaceDepthMesh& Mesh = OutMeshes.AddDefaulted_GetRef();
+	Mesh.LocalToSurface = Component.GetComponentTransform().GetRelativeTransform(SurfaceTransform).ToMatrixWithScale();
+	Mesh.RenderData = RenderData;
+	Mesh.LODIndex = LODIndex;
+	OutReferencedMeshes.AddUnique(StaticMesh);
+	return true;
+}
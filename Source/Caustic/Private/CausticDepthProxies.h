@@ -0,0 +1,26 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Pass/SurfaceDepthPass.h"
+
+class UPrimitiveComponent;
+class UStaticMesh;
+
+namespace Caustic
+{
+	/**
+	 * Appends the spheres, capsules, boxes and convex hulls of a component's simple collision as depth proxies.
+	 * Components without simple collision fall back to their local bounds. SurfaceTransform places the surface
+	 * plane at Z 0 looking down its X and Y axes.
+	 */
+	void GatherDepthProxies(UPrimitiveComponent& Component, const FTransform& SurfaceTransform, TArray<FSurfaceDepthProxy>& OutProxies);
+
+	/**
+	 * Appends the streamed in LOD of a static mesh component for the mesh depth pass, false for any other component.
+	 * The render data is read on the render thread, so the caller keeps the meshes in OutReferencedMeshes referenced
+	 * until the frame that draws them has been enqueued.
+	 */
+	bool GatherDepthMesh(UPrimitiveComponent& Component, const FTransform& SurfaceTransform, TArray<FSurfaceDepthMesh>& OutMeshes, TArray<UStaticMesh*>& OutReferencedMeshes);
+}
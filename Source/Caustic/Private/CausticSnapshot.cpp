@@ -0,0 +1,191 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#include "CausticSnapshot.h"
+#include "Misc/Compression.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+
+namespace
+{
+	/** Leading bytes of a serialized snapshot, rejects unrelated data before anything else is read */
+	const uint32 CausticSnapshotMagic = 0x43535350;
+
+	template<typename EnumType>
+	void SerializeEnum(FArchive& Ar, EnumType& Value)
+	{
+		uint8 Byte = (uint8)Value;
+		Ar << Byte;
+		Value = (EnumType)Byte;
+	}
+
+	/**
+	 * Writes the parameters one field at a time, so adding a field to FLiquidParam does not shift the others.
+	 * A field added later is appended here behind a version check and keeps a default when reading older snapshots.
+	 */
+	void SerializeLiquidParam(FArchive& Ar, FLiquidParam& Param, uint32 Version)
+	{
+		Ar << Param.Velocity << Param.Viscosity << Param.ForceFactor << Param.Refraction;
+		SerializeEnum(Ar, Param.Projection);
+		Ar << Param.IndexOfRefraction << Param.Dispersion << Param.AttenuationCoefficient;
+		SerializeEnum(Ar, Param.Solver);
+		Ar << Param.JacobiIterations;
+		SerializeEnum(Ar, Param.BoundaryMode);
+		Ar << Param.SpongeWidth << Param.SpongeStrength;
+		Ar << Param.DepthTextureWidth << Param.DepthTextureHeight;
+	}
+
+	bool CompressBytes(const void* Data, int32 Size, TArray<uint8>& OutCompressed)
+	{
+		int32 CompressedSize = FCompression::CompressMemoryBound(NAME_Zlib, Size);
+		OutCompressed.SetNumUninitialized(CompressedSize);
+
+		if (!FCompression::CompressMemory(NAME_Zlib, OutCompressed.GetData(), CompressedSize, Data, Size))
+		{
+			OutCompressed.Reset();
+			return false;
+		}
+
+		OutCompressed.SetNum(CompressedSize);
+		return true;
+	}
+}
+
+bool FCausticSnapshot::CompressHeight(const TArray<FFloat16Color>& Current, const TArray<FFloat16Color>& Previous)
+{
+	const int32 TexelCount = Width * Height;
+	if (Current.Num() != TexelCount || Previous.Num() != TexelCount)
+	{
+		return false;
+	}
+
+	const int32 FrameSize = TexelCount * sizeof(FFloat16Color);
+
+	TArray<uint8> Uncompressed;
+	Uncompressed.SetNumUninitialized(FrameSize * 2);
+	FMemory::Memcpy(Uncompressed.GetData(), Current.GetData(), FrameSize);
+	FMemory::Memcpy(Uncompressed.GetData() + FrameSize, Previous.GetData(), FrameSize);
+
+	if (!CompressBytes(Uncompressed.GetData(), Uncompressed.Num(), CompressedHeight))
+	{
+		return false;
+	}
+
+	UncompressedSize = Uncompressed.Num();
+
+	return true;
+}
+
+bool FCausticSnapshot::DecompressHeight(TArray<FFloat16Color>& OutCurrent, TArray<FFloat16Color>& OutPrevious) const
+{
+	const int32 TexelCount = Width * Height;
+	const int32 FrameSize = TexelCount * sizeof(FFloat16Color);
+
+	if (Version < MinVersion || Version > CurrentVersion || UncompressedSize != FrameSize * 2 || CompressedHeight.Num() == 0)
+	{
+		return false;
+	}
+
+	TArray<uint8> Uncompressed;
+	Uncompressed.SetNumUninitialized(UncompressedSize);
+
+	if (!FCompression::UncompressMemory(NAME_Zlib, Uncompressed.GetData(), UncompressedSize, CompressedHeight.GetData(), CompressedHeight.Num()))
+	{
+		return false;
+	}
+
+	OutCurrent.SetNumUninitialized(TexelCount);
+	OutPrevious.SetNumUninitialized(TexelCount);
+	FMemory::Memcpy(OutCurrent.GetData(), Uncompressed.GetData(), FrameSize);
+	FMemory::Memcpy(OutPrevious.GetData(), Uncompressed.GetData() + FrameSize, FrameSize);
+
+	return true;
+}
+
+bool FCausticSnapshot::CompressDisplacement(const TArray<FFloat16>& Displacement)
+{
+	const int32 TexelCount = Width * Height;
+	if (Displacement.Num() != TexelCount)
+	{
+		return false;
+	}
+
+	const int32 FrameSize = TexelCount * sizeof(FFloat16);
+	if (!CompressBytes(Displacement.GetData(), FrameSize, CompressedDisplacement))
+	{
+		return false;
+	}
+
+	UncompressedDisplacementSize = FrameSize;
+
+	return true;
+}
+
+bool FCausticSnapshot::DecompressDisplacement(TArray<FFloat16>& OutDisplacement) const
+{
+	const int32 TexelCount = Width * Height;
+
+	// Older snapshots did not record it, interactors that were in the water then push again as if they had just entered
+	if (Version < 3)
+	{
+		OutDisplacement.Init(FFloat16(0.0f), TexelCount);
+		return true;
+	}
+
+	if (Version > CurrentVersion || UncompressedDisplacementSize != TexelCount * (int32)sizeof(FFloat16) || CompressedDisplacement.Num() == 0)
+	{
+		return false;
+	}
+
+	OutDisplacement.SetNumUninitialized(TexelCount);
+	return FCompression::UncompressMemory(NAME_Zlib, OutDisplacement.GetData(), UncompressedDisplacementSize, CompressedDisplacement.GetData(), CompressedDisplacement.Num());
+}
+
+bool FCausticSnapshot::SaveToBytes(TArray<uint8>& OutBytes)
+{
+	OutBytes.Reset();
+
+	FMemoryWriter Writer(OutBytes);
+	Writer << *this;
+
+	return !Writer.IsError();
+}
+
+bool FCausticSnapshot::LoadFromBytes(const TArray<uint8>& Bytes)
+{
+	FMemoryReader Reader(Bytes);
+	Reader << *this;
+
+	return !Reader.IsError();
+}
+
+FArchive& operator<<(FArchive& Ar, FCausticSnapshot& Snapshot)
+{
+	uint32 Magic = CausticSnapshotMagic;
+	Ar << Magic;
+
+	if (Magic != CausticSnapshotMagic)
+	{
+		Ar.SetError();
+		return Ar;
+	}
+
+	Ar << Snapshot.Version;
+
+	// Layouts before MinVersion and from newer builds are rejected rather than guessed at
+	if (Snapshot.Version < FCausticSnapshot::MinVersion || Snapshot.Version > FCausticSnapshot::CurrentVersion)
+	{
+		Ar.SetError();
+		return Ar;
+	}
+
+	Ar << Snapshot.Width << Snapshot.Height << Snapshot.SimulationStep;
+	SerializeLiquidParam(Ar, Snapshot.LiquidParam, Snapshot.Version);
+	Ar << Snapshot.UncompressedSize << Snapshot.CompressedHeight;
+
+	if (Snapshot.Version >= 3)
+	{
+		Ar << Snapshot.UncompressedDisplacementSize << Snapshot.CompressedDisplacement;
+	}
+
+	return Ar;
+}
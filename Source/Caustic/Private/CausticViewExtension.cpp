@@ -0,0 +1,85 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#include "CausticViewExtension.h"
+#include "CausticBody.h"
+#include "SceneView.h"
+#include "Engine/Engine.h"
+
+namespace
+{
+	TSharedPtr<FCausticViewExtension, ESPMode::ThreadSafe> CausticViewExtension;
+}
+
+FCausticViewExtension::FCausticViewExtension(const FAutoRegister& AutoRegister) :
+	FSceneViewExtensionBase(AutoRegister)
+{
+}
+
+void FCausticViewExtension::RegisterBody(ACausticBody* Body)
+{
+	check(IsInGameThread());
+
+	// GEngine does not exist yet when the module starts up
+	if (!CausticViewExtension.IsValid())
+	{
+		CausticViewExtension = FSceneViewExtensions::NewExtension<FCausticViewExtension>();
+	}
+
+	CausticViewExtension->Bodies.AddUnique(Body);
+}
+
+void FCausticViewExtension::UnregisterBody(ACausticBody* Body)
+{
+	check(IsInGameThread());
+
+	if (CausticViewExtension.IsValid())
+	{
+		CausticViewExtension->Bodies.Remove(Body);
+	}
+}
+
+void FCausticViewExtension::Shutdown()
+{
+	CausticViewExtension.Reset();
+}
+
+bool FCausticViewExtension::IsActiveThisFrame(FViewport* InViewport) const
+{
+	return Bodies.Num() > 0;
+}
+
+void FCausticViewExtension::BeginRenderViewFamily(FSceneViewFamily& InViewFamily)
+{
+	check(IsInGameThread());
+
+	Bodies.RemoveAll([](const TWeakObjectPtr<ACausticBody>& Body) { return !Body.IsValid(); });
+
+	for (const TWeakObjectPtr<ACausticBody>& BodyPtr : Bodies)
+	{
+		ACausticBody* Body = BodyPtr.Get();
+		UWorld* World = Body->GetWorld();
+
+		// Already seen this frame, or in another world than the one being rendered
+		if (Body->LastVisibleFrame == GFrameCounter || !World || World->Scene != InViewFamily.Scene)
+		{
+			continue;
+		}
+
+		// The body's own captures look straight at it and would keep it simulating forever
+		if (Body->IsOwnCaptureTarget(InViewFamily.RenderTarget))
+		{
+			continue;
+		}
+
+		const FBoxSphereBounds Bounds = Body->GetVisibilityBounds();
+
+		for (const FSceneView* View : InViewFamily.Views)
+		{
+			if (View && View->ViewFrustum.IntersectBox(Bounds.Origin, Bounds.BoxExtent))
+			{
+				Body->LastVisibleFrame = GFrameCounter;
+				break;
+			}
+		}
+	}
+}
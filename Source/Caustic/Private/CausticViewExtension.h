@@ -0,0 +1,42 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "SceneViewExtension.h"
+
+class ACausticBody;
+
+/**
+ * Sees every view family the engine renders, split screen players, stereo eyes and scene captures
+ * alike, and records which bodies any of them can see. Bodies read that on their next tick, so
+ * extra views decide whether a body simulates but never how often.
+ */
+class FCausticViewExtension : public FSceneViewExtensionBase
+{
+
+public:
+
+	FCausticViewExtension(const FAutoRegister& AutoRegister);
+
+	/** Adds a body to the visibility tests, creating the extension on first use */
+	static void RegisterBody(ACausticBody* Body);
+
+	static void UnregisterBody(ACausticBody* Body);
+
+	/** Drops the extension, called by the module on shutdown */
+	static void Shutdown();
+
+	// FSceneViewExtensionBase
+	virtual void SetupViewFamily(FSceneViewFamily& InViewFamily) override {}
+	virtual void SetupView(FSceneViewFamily& InViewFamily, FSceneView& InView) override {}
+	virtual void BeginRenderViewFamily(FSceneViewFamily& InViewFamily) override;
+	virtual void PreRenderViewFamily_RenderThread(FRHICommandListImmediate& RHICmdList, FSceneViewFamily& InViewFamily) override {}
+	virtual void PreRenderView_RenderThread(FRHICommandListImmediate& RHICmdList, FSceneView& InView) override {}
+	virtual bool IsActiveThisFrame(class FViewport* InViewport) const override;
+
+private:
+
+	/** Game thread only, like the callbacks that read it */
+	TArray<TWeakObjectPtr<ACausticBody>> Bodies;
+};
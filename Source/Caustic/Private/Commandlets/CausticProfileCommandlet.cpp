@@ -0,0 +1,690 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#include "Commandlets/CausticProfileCommandlet.h"
+#include "Caustic.h"
+#include "CausticBody.h"
+#include "Cpu/CausticCpuSimulation.h"
+#include "Pass/CausticFrameGraph.h"
+#include "Engine/TextureRenderTarget2D.h"
+#include "TextureResource.h"
+#include "RenderingThread.h"
+#include "IImageWrapper.h"
+#include "IImageWrapperModule.h"
+#include "JsonObjectConverter.h"
+#include "Dom/JsonObject.h"
+#include "Serialization/JsonReader.h"
+#include "Serialization/JsonSerializer.h"
+#include "HAL/PlatformTime.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Misc/App.h"
+#include "Modules/ModuleManager.h"
+
+namespace
+{
+	struct FCausticProfileWaypoint
+	{
+		float     Time;
+		FVector2D Position;
+	};
+
+	/** Sphere moved along a path, positions are in body space with the origin at the body centre */
+	struct FCausticProfileInteractor
+	{
+		float                          Radius = 32.0f;
+
+		/** Depth of the sphere centre below the surface */
+		float                          Depth = 0.0f;
+
+		TArray<FCausticProfileWaypoint> Path;
+
+		/** Linear between waypoints, held at both ends */
+		FVector2D GetPosition(float Time) const
+		{
+			if (Path.Num() == 0)
+			{
+				return FVector2D::ZeroVector;
+			}
+
+			for (int32 Index = 1; Index < Path.Num(); ++Index)
+			{
+				const FCausticProfileWaypoint& From = Path[Index - 1];
+				const FCausticProfileWaypoint& To = Path[Index];
+
+				if (Time < To.Time)
+				{
+					const float Alpha = (To.Time > From.Time) ? FMath::Clamp((Time - From.Time) / (To.Time - From.Time), 0.0f, 1.0f) : 1.0f;
+					return FMath::Lerp(From.Position, To.Position, Alpha);
+				}
+			}
+
+			return Path.Last().Position;
+		}
+	};
+
+	struct FCausticProfileScript
+	{
+		FLiquidParam                      LiquidParam;
+		float                             BodyWidth;
+		float                             BodyHeight;
+		float                             BodyDepth;
+		float                             CellSize;
+		float                             CausticResolutionScale;
+		FVector                           LightDirection = FVector(0.0f, 0.0f, -1.0f);
+		ECausticInteractionForce          InteractionForce;
+		int32                             Frames = 600;
+		TArray<FCausticProfileInteractor> Interactors;
+
+		/** Same sizes ACausticBody::InitSimulation gives the passes */
+		FCausticCpuSimulationConfig GetSimulationConfig() const
+		{
+			const float ResolutionScale = FMath::Clamp(CausticResolutionScale, 0.25f, 8.0f);
+
+			FCausticCpuSimulationConfig Config;
+			Config.TextureWidth = LiquidParam.DepthTextureWidth;
+			Config.TextureHeight = LiquidParam.DepthTextureHeight;
+			Config.CausticWidth = FMath::Max(FMath::RoundToInt(LiquidParam.DepthTextureWidth * ResolutionScale), 1);
+			Config.CausticHeight = FMath::Max(FMath::RoundToInt(LiquidParam.DepthTextureHeight * ResolutionScale), 1);
+			Config.CellSize = CellSize * ResolutionScale / 32.0f;
+			Config.MinDepth = 0.0f;
+			Config.MaxDepth = BodyDepth;
+			Config.BodyWidth = BodyWidth;
+			Config.BodyHeight = BodyHeight;
+			Config.BodyDepth = BodyDepth;
+			return Config;
+		}
+	};
+
+	/** Reads a property default off the body CDO, so the script starts from what a freshly placed body uses */
+	template <typename ValueType>
+	ValueType GetBodyDefault(const TCHAR* PropertyName)
+	{
+		const UProperty* Property = ACausticBody::StaticClass()->FindPropertyByName(PropertyName);
+		check(Property);
+
+		return *Property->ContainerPtrToValuePtr<ValueType>(GetDefault<ACausticBody>());
+	}
+
+	void InitScriptDefaults(FCausticProfileScript& Script)
+	{
+		Script.LiquidParam = GetBodyDefault<FLiquidParam>(TEXT("LiquidParam"));
+		Script.BodyWidth = GetBodyDefault<float>(TEXT("BodyWidth"));
+		Script.BodyHeight = GetBodyDefault<float>(TEXT("BodyHeight"));
+		Script.BodyDepth = GetBodyDefault<float>(TEXT("BodyDepth"));
+		Script.CellSize = GetBodyDefault<float>(TEXT("CellSize"));
+		Script.CausticResolutionScale = GetBodyDefault<float>(TEXT("CausticResolutionScale"));
+		Script.InteractionForce = GetBodyDefault<ECausticInteractionForce>(TEXT("InteractionForce"));
+	}
+
+	/** A single sphere crossing the body, used when no script is given */
+	void MakeDefaultScript(FCausticProfileScript& Script)
+	{
+		InitScriptDefaults(Script);
+
+		const float Duration = Script.Frames * Caustic::SimulationStepTime;
+		const float HalfWidth = Script.BodyWidth * 0.4f;
+
+		FCausticProfileInteractor& Interactor = Script.Interactors.AddDefaulted_GetRef();
+		Interactor.Radius = Script.BodyWidth / 16;
+		Interactor.Depth = 0.0f;
+		Interactor.Path.Add({ 0.0f, FVector2D(-HalfWidth, 0.0f) });
+		Interactor.Path.Add({ Duration * 0.5f, FVector2D(HalfWidth, 0.0f) });
+		Interactor.Path.Add({ Duration, FVector2D(0.0f, HalfWidth) });
+	}
+
+	/**
+	 * {
+	 *   "Frames": 600, "BodyWidth": 512, "BodyHeight": 512, "BodyDepth": 512, "CellSize": 16, "CausticResolutionScale": 4,
+	 *   "LightDirection": [0, 0, -1],
+	 *   "LiquidParam": { any FLiquidParam property },
+	 *   "Interactors": [ { "Radius": 32, "Depth": 0, "Path": [ { "Time": 0, "X": -200, "Y": 0 }, ... ] } ]
+	 * }
+	 * Missing fields keep the body defaults.
+	 */
+	bool LoadScript(const FString& ScriptPath, FCausticProfileScript& Script)
+	{
+		FString ScriptText;
+		if (!FFileHelper::LoadFileToString(ScriptText, *ScriptPath))
+		{
+			UE_LOG(LogCaustic, Error, TEXT("CausticProfile: can't read %s"), *ScriptPath);
+			return false;
+		}
+
+		TSharedPtr<FJsonObject> Root;
+		if (!FJsonSerializer::Deserialize(TJsonReaderFactory<>::Create(ScriptText), Root) || !Root.IsValid())
+		{
+			UE_LOG(LogCaustic, Error, TEXT("CausticProfile: %s is not valid JSON"), *ScriptPath);
+			return false;
+		}
+
+		InitScriptDefaults(Script);
+
+		Root->TryGetNumberField(TEXT("Frames"), Script.Frames);
+		Root->TryGetNumberField(TEXT("BodyWidth"), Script.BodyWidth);
+		Root->TryGetNumberField(TEXT("BodyHeight"), Script.BodyHeight);
+		Root->TryGetNumberField(TEXT("BodyDepth"), Script.BodyDepth);
+		Root->TryGetNumberField(TEXT("CellSize"), Script.CellSize);
+		Root->TryGetNumberField(TEXT("CausticResolutionScale"), Script.CausticResolutionScale);
+
+		const TArray<TSharedPtr<FJsonValue>>* LightDirection;
+		if (Root->TryGetArrayField(TEXT("LightDirection"), LightDirection) && LightDirection->Num() == 3)
+		{
+			Script.LightDirection = FVector((*LightDirection)[0]->AsNumber(), (*LightDirection)[1]->AsNumber(), (*LightDirection)[2]->AsNumber());
+		}
+
+		FString InteractionForce;
+		if (Root->TryGetStringField(TEXT("InteractionForce"), InteractionForce))
+		{
+			const int64 Value = StaticEnum<ECausticInteractionForce>()->GetValueByNameString(InteractionForce);
+			if (Value == INDEX_NONE || Value == (int64)ECausticInteractionForce::MAX)
+			{
+				UE_LOG(LogCaustic, Error, TEXT("CausticProfile: unknown InteractionForce %s in %s"), *InteractionForce, *ScriptPath);
+				return false;
+			}
+			Script.InteractionForce = (ECausticInteractionForce)Value;
+		}
+
+		const TSharedPtr<FJsonObject>* LiquidParam;
+		if (Root->TryGetObjectField(TEXT("LiquidParam"), LiquidParam))
+		{
+			FJsonObjectConverter::JsonObjectToUStruct(LiquidParam->ToSharedRef(), FLiquidParam::StaticStruct(), &Script.LiquidParam);
+		}
+
+		const TArray<TSharedPtr<FJsonValue>>* Interactors;
+		if (Root->TryGetArrayField(TEXT("Interactors"), Interactors))
+		{
+			for (const TSharedPtr<FJsonValue>& InteractorValue : *Interactors)
+			{
+				const TSharedPtr<FJsonObject>& InteractorObject = InteractorValue->AsObject();
+				FCausticProfileInteractor& Interactor = Script.Interactors.AddDefaulted_GetRef();
+				InteractorObject->TryGetNumberField(TEXT("Radius"), Interactor.Radius);
+				InteractorObject->TryGetNumberField(TEXT("Depth"), Interactor.Depth);
+
+				const TArray<TSharedPtr<FJsonValue>>* Path;
+				if (InteractorObject->TryGetArrayField(TEXT("Path"), Path))
+				{
+					for (const TSharedPtr<FJsonValue>& WaypointValue : *Path)
+					{
+						const TSharedPtr<FJsonObject>& WaypointObject = WaypointValue->AsObject();
+						FCausticProfileWaypoint Waypoint = { 0.0f, FVector2D::ZeroVector };
+						WaypointObject->TryGetNumberField(TEXT("Time"), Waypoint.Time);
+						WaypointObject->TryGetNumberField(TEXT("X"), Waypoint.Position.X);
+						WaypointObject->TryGetNumberField(TEXT("Y"), Waypoint.Position.Y);
+						Interactor.Path.Add(Waypoint);
+					}
+				}
+			}
+		}
+
+		return true;
+	}
+
+	/** What the orthographic depth capture would see, the top of every sphere measured down from the surface */
+	void RenderInteractorDepth(const FCausticProfileScript& Script, float Time, TArray<float>& OutDepth)
+	{
+		const int32 Width = Script.LiquidParam.DepthTextureWidth;
+		const int32 Height = Script.LiquidParam.DepthTextureHeight;
+
+		// Past MaxDepth is left alone by the depth pass, like an empty capture
+		OutDepth.Init(Script.BodyDepth * 2.0f, Width * Height);
+
+		for (const FCausticProfileInteractor& Interactor : Script.Interactors)
+		{
+			const FVector2D Center = Interactor.GetPosition(Time);
+			const float RadiusSqr = Interactor.Radius * Interactor.Radius;
+
+			for (int32 Y = 0; Y < Height; ++Y)
+			{
+				for (int32 X = 0; X < Width; ++X)
+				{
+					const FVector2D Position(((X + 0.5f) / Width - 0.5f) * Script.BodyWidth, ((Y + 0.5f) / Height - 0.5f) * Script.BodyHeight);
+					const float DistanceSqr = FVector2D::DistSquared(Position, Center);
+
+					if (DistanceSqr < RadiusSqr)
+					{
+						// The capture starts at the surface, anything above it is clipped by the near plane
+						const float Depth = FMath::Max(Interactor.Depth - FMath::Sqrt(RadiusSqr - DistanceSqr), 0.0f);
+						float& Texel = OutDepth[Y * Width + X];
+						Texel = FMath::Min(Texel, Depth);
+					}
+				}
+			}
+		}
+	}
+
+	/** DecodeDepth of CausticCommon.ush */
+	float DecodeDepth(const FFloat16Color& Encoded)
+	{
+		const float Depth = Encoded.R.GetFloat() + Encoded.G.GetFloat() / 255.0f;
+		return Encoded.B.GetFloat() > 0.5f ? Depth : -Depth;
+	}
+
+	bool SaveImage(const FString& FilePath, const TArray<FLinearColor>& Pixels, int32 Width, int32 Height)
+	{
+		IImageWrapperModule& ImageWrapperModule = FModuleManager::LoadModuleChecked<IImageWrapperModule>(TEXT("ImageWrapper"));
+		const bool bExr = FPaths::GetExtension(FilePath) == TEXT("exr");
+
+		TSharedPtr<IImageWrapper> ImageWrapper = ImageWrapperModule.CreateImageWrapper(bExr ? EImageFormat::EXR : EImageFormat::PNG);
+		if (!ImageWrapper.IsValid())
+		{
+			return false;
+		}
+
+		if (bExr)
+		{
+			ImageWrapper->SetRaw(Pixels.GetData(), Pixels.Num() * sizeof(FLinearColor), Width, Height, ERGBFormat::RGBA, 32);
+		}
+		else
+		{
+			// PNG dumps are for eyeballing, values past one are clipped
+			TArray<FColor> Colors;
+			Colors.SetNumUninitialized(Pixels.Num());
+			for (int32 Index = 0; Index < Pixels.Num(); ++Index)
+			{
+				Colors[Index] = Pixels[Index].ToFColor(false);
+			}
+
+			ImageWrapper->SetRaw(Colors.GetData(), Colors.Num() * sizeof(FColor), Width, Height, ERGBFormat::BGRA, 8);
+		}
+
+		return FFileHelper::SaveArrayToFile(ImageWrapper->GetCompressed(), *FilePath);
+	}
+
+	/** One frame of every stage output, as the dumps and the comparison see them */
+	struct FCausticProfileFrame
+	{
+		TArray<float>        Height;
+		TArray<FVector>      Normal;
+		TArray<FLinearColor> Caustic;
+	};
+
+	void DumpFrame(const FString& Directory, int32 Frame, const FCausticProfileFrame& Output, const FCausticCpuSimulationConfig& Config)
+	{
+		const FString BaseName = FPaths::Combine(Directory, FString::Printf(TEXT("Frame%05d"), Frame));
+
+		TArray<FLinearColor> Pixels;
+		Pixels.SetNumUninitialized(Output.Height.Num());
+		for (int32 Index = 0; Index < Output.Height.Num(); ++Index)
+		{
+			const float Height = Output.Height[Index];
+			Pixels[Index] = FLinearColor(Height, Height, Height, 1.0f);
+		}
+		SaveImage(BaseName + TEXT("_Height.exr"), Pixels, Config.TextureWidth, Config.TextureHeight);
+
+		for (int32 Index = 0; Index < Output.Normal.Num(); ++Index)
+		{
+			const FVector& Normal = Output.Normal[Index];
+			Pixels[Index] = FLinearColor(Normal.X, Normal.Y, Normal.Z, 1.0f);
+		}
+		SaveImage(BaseName + TEXT("_Normal.png"), Pixels, Config.TextureWidth, Config.TextureHeight);
+
+		SaveImage(BaseName + TEXT("_Caustic.exr"), Output.Caustic, Config.CausticWidth, Config.CausticHeight);
+		SaveImage(BaseName + TEXT("_Caustic.png"), Output.Caustic, Config.CausticWidth, Config.CausticHeight);
+	}
+
+	/** Root mean square difference of two buffers of the same size */
+	template <typename ElementType, typename DifferenceType>
+	double GetRootMeanSquare(const TArray<ElementType>& A, const TArray<ElementType>& B, DifferenceType GetDifferenceSqr)
+	{
+		if (A.Num() == 0 || A.Num() != B.Num())
+		{
+			return 0.0;
+		}
+
+		double Sum = 0.0;
+		for (int32 Index = 0; Index < A.Num(); ++Index)
+		{
+			Sum += GetDifferenceSqr(A[Index], B[Index]);
+		}
+
+		return FMath::Sqrt(Sum / A.Num());
+	}
+
+	/** Runs the shader passes of a body without a world, synchronously so every frame can be timed */
+	class FCausticGpuProfiler
+	{
+
+	public:
+
+		explicit FCausticGpuProfiler(const FCausticCpuSimulationConfig& InConfig) :
+			Config(InConfig),
+			DepthPass(MakeShared<FSurfaceDepthPassRenderer, ESPMode::ThreadSafe>()),
+			NormalPass(MakeShared<FSurfaceNormalPassRenderer, ESPMode::ThreadSafe>()),
+			CausticPass(MakeShared<FSurfaceCausticPassRenderer, ESPMode::ThreadSafe>()),
+			TemporalPass(MakeShared<FCausticTemporalPassRenderer, ESPMode::ThreadSafe>()),
+			BlurPass(MakeShared<FCausticBlurPassRenderer, ESPMode::ThreadSafe>()),
+			FlipbookPass(MakeShared<FCausticFlipbookPassRenderer, ESPMode::ThreadSafe>()),
+			FrameGraph(MakeShared<FCausticFrameGraph, ESPMode::ThreadSafe>(DepthPass, NormalPass, CausticPass, TemporalPass, BlurPass, FlipbookPass)),
+			StageTimings(MakeShared<FCausticStageTimings, ESPMode::ThreadSafe>())
+		{
+			// Same formats the body creates, the depth pass copies the capture into an R16F staging texture
+			DepthTarget = NewObject<UTextureRenderTarget2D>();
+			DepthTarget->AddToRoot();
+			DepthTarget->RenderTargetFormat = RTF_R16f;
+			DepthTarget->SizeX = Config.TextureWidth;
+			DepthTarget->SizeY = Config.TextureHeight;
+			DepthTarget->UpdateResource();
+
+			CausticTarget = NewObject<UTextureRenderTarget2D>();
+			CausticTarget->AddToRoot();
+			CausticTarget->RenderTargetFormat = RTF_RGBA16f;
+			CausticTarget->SizeX = Config.CausticWidth;
+			CausticTarget->SizeY = Config.CausticHeight;
+			CausticTarget->UpdateResource();
+
+			FSurfaceDepthPassConfig DepthConfig;
+			DepthConfig.MinDepth = Config.MinDepth;
+			DepthConfig.MaxDepth = Config.MaxDepth;
+			DepthConfig.TextureWidth = Config.TextureWidth;
+			DepthConfig.TextureHeight = Config.TextureHeight;
+			DepthPass->InitPass(DepthConfig);
+
+			FSurfaceNormalPassConfig NormalConfig;
+			NormalConfig.TextureWidth = Config.TextureWidth;
+			NormalConfig.TextureHeight = Config.TextureHeight;
+			NormalPass->InitPass(NormalConfig);
+
+			FSurfaceCausticPassConfig CausticConfig;
+			CausticConfig.TextureWidth = Config.CausticWidth;
+			CausticConfig.TextureHeight = Config.CausticHeight;
+			CausticConfig.CellSize = Config.CellSize;
+			CausticConfig.FarClipZ = Config.BodyDepth;
+			CausticConfig.NearClipZ = -Config.BodyDepth;
+			CausticConfig.BodyWidth = Config.BodyWidth;
+			CausticConfig.BodyHeight = Config.BodyHeight;
+			CausticPass->InitPass(CausticConfig);
+
+			FCausticTemporalPassConfig TemporalConfig;
+			TemporalConfig.TextureWidth = Config.CausticWidth;
+			TemporalConfig.TextureHeight = Config.CausticHeight;
+			TemporalPass->InitPass(TemporalConfig);
+
+			FCausticBlurPassConfig BlurConfig;
+			BlurConfig.TextureWidth = Config.CausticWidth;
+			BlurConfig.TextureHeight = Config.CausticHeight;
+			BlurPass->InitPass(BlurConfig);
+
+			// The refraction grid queues its upload from the thread pool, wait for it before flushing
+			CausticPass->WaitForPendingInit();
+			FlushRenderingCommands();
+		}
+
+		~FCausticGpuProfiler()
+		{
+			FrameGraph->ReleasePasses();
+			FlushRenderingCommands();
+
+			DepthTarget->RemoveFromRoot();
+			CausticTarget->RemoveFromRoot();
+		}
+
+		bool IsReady() const
+		{
+			return FrameGraph->IsReady();
+		}
+
+		/**
+		 * Seconds from submitting the frame until the GPU is idle again, the depth upload is not counted.
+		 * The stages are drained one by one to time them, so the frame includes the gaps between them.
+		 */
+		double Step(const FCausticFrameParams& Params, const TArray<float>& SceneDepth, FCausticStageTimings& OutStageTimings)
+		{
+			TArray<FFloat16> HalfDepth;
+			HalfDepth.SetNumUninitialized(SceneDepth.Num());
+			for (int32 Index = 0; Index < SceneDepth.Num(); ++Index)
+			{
+				HalfDepth[Index] = SceneDepth[Index];
+			}
+
+			FTextureRenderTargetResource* DepthResource = DepthTarget->GameThread_GetRenderTargetResource();
+			const uint32 Width = Config.TextureWidth;
+			const uint32 Height = Config.TextureHeight;
+
+			ENQUEUE_RENDER_COMMAND(CausticProfileUploadCommand)
+			(
+				[DepthResource, HalfDepth = MoveTemp(HalfDepth), Width, Height](FRHICommandListImmediate& RHICmdList)
+				{
+					RHIUpdateTexture2D(DepthResource->GetRenderTargetTexture(), 0, FUpdateTextureRegion2D(0, 0, 0, 0, Width, Height), Width * sizeof(FFloat16), reinterpret_cast<const uint8*>(HalfDepth.GetData()));
+					RHICmdList.BlockUntilGPUIdle();
+				}
+			);
+			FlushRenderingCommands();
+
+			const double StartTime = FPlatformTime::Seconds();
+
+			FCausticFrameInputs FrameInputs;
+			FrameInputs.Params = Params;
+			FrameInputs.DepthTargetResource = DepthResource;
+			FrameInputs.bDepthCaptured = true;
+			FrameInputs.CausticTargetResource = CausticTarget->GameThread_GetRenderTargetResource();
+			FrameInputs.StageTimings = StageTimings;
+			FrameGraph->Render(MoveTemp(FrameInputs));
+
+			ENQUEUE_RENDER_COMMAND(CausticProfileWaitCommand)
+			(
+				[](FRHICommandListImmediate& RHICmdList)
+				{
+					RHICmdList.BlockUntilGPUIdle();
+				}
+			);
+			FlushRenderingCommands();
+
+			OutStageTimings = *StageTimings;
+			return FPlatformTime::Seconds() - StartTime;
+		}
+
+		void Readback(FCausticProfileFrame& OutFrame)
+		{
+			TArray<FFloat16Color> Height;
+			TArray<FFloat16Color> Normal;
+			TArray<FFloat16Color> Caustic;
+
+			FTextureRenderTargetResource* CausticResource = CausticTarget->GameThread_GetRenderTargetResource();
+			const FIntRect Rect(0, 0, Config.TextureWidth, Config.TextureHeight);
+			const FIntRect CausticRect(0, 0, Config.CausticWidth, Config.CausticHeight);
+
+			ENQUEUE_RENDER_COMMAND(CausticProfileReadbackCommand)
+			(
+				[this, CausticResource, Rect, CausticRect, &Height, &Normal, &Caustic](FRHICommandListImmediate& RHICmdList)
+				{
+					RHICmdList.ReadSurfaceFloatData(DepthPass->GetHeightTexture(), Rect, Height, CubeFace_PosX, 0, 0);
+					RHICmdList.ReadSurfaceFloatData(NormalPass->GetNormalTexture(), Rect, Normal, CubeFace_PosX, 0, 0);
+					RHICmdList.ReadSurfaceFloatData(CausticResource->GetRenderTargetTexture(), CausticRect, Caustic, CubeFace_PosX, 0, 0);
+				}
+			);
+			FlushRenderingCommands();
+
+			OutFrame.Height.SetNumUninitialized(Height.Num());
+			OutFrame.Normal.SetNumUninitialized(Normal.Num());
+			OutFrame.Caustic.SetNumUninitialized(Caustic.Num());
+
+			for (int32 Index = 0; Index < Height.Num(); ++Index)
+			{
+				OutFrame.Height[Index] = DecodeDepth(Height[Index]);
+				OutFrame.Normal[Index] = FVector(Normal[Index].R.GetFloat(), Normal[Index].G.GetFloat(), Normal[Index].B.GetFloat());
+			}
+
+			for (int32 Index = 0; Index < Caustic.Num(); ++Index)
+			{
+				OutFrame.Caustic[Index] = FLinearColor(Caustic[Index].R.GetFloat(), Caustic[Index].G.GetFloat(), Caustic[Index].B.GetFloat(), Caustic[Index].A.GetFloat());
+			}
+		}
+
+	private:
+
+		FCausticCpuSimulationConfig Config;
+
+		TSharedRef<FSurfaceDepthPassRenderer, ESPMode::ThreadSafe>    DepthPass;
+		TSharedRef<FSurfaceNormalPassRenderer, ESPMode::ThreadSafe>   NormalPass;
+		TSharedRef<FSurfaceCausticPassRenderer, ESPMode::ThreadSafe>  CausticPass;
+		TSharedRef<FCausticTemporalPassRenderer, ESPMode::ThreadSafe> TemporalPass;
+		TSharedRef<FCausticBlurPassRenderer, ESPMode::ThreadSafe>     BlurPass;
+		TSharedRef<FCausticFlipbookPassRenderer, ESPMode::ThreadSafe> FlipbookPass;
+		TSharedRef<FCausticFrameGraph, ESPMode::ThreadSafe>           FrameGraph;
+		TSharedRef<FCausticStageTimings, ESPMode::ThreadSafe>         StageTimings;
+
+		UTextureRenderTarget2D* DepthTarget;
+		UTextureRenderTarget2D* CausticTarget;
+	};
+}
+
+UCausticProfileCommandlet::UCausticProfileCommandlet()
+{
+	IsClient = false;
+	IsEditor = false;
+	IsServer = false;
+	LogToConsole = true;
+}
+
+int32 UCausticProfileCommandlet::Main(const FString& Params)
+{
+	FCausticProfileScript Script;
+
+	FString ScriptPath;
+	if (FParse::Value(*Params, TEXT("Script="), ScriptPath))
+	{
+		if (!LoadScript(ScriptPath, Script))
+		{
+			return 1;
+		}
+	}
+	else
+	{
+		MakeDefaultScript(Script);
+	}
+
+	FParse::Value(*Params, TEXT("Frames="), Script.Frames);
+
+	int32 DumpEvery = 60;
+	FParse::Value(*Params, TEXT("DumpEvery="), DumpEvery);
+
+	FString OutputDirectory = FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("Caustic"), TEXT("Profile"));
+	FParse::Value(*Params, TEXT("Output="), OutputDirectory);
+
+	const bool bRunGpu = FParse::Param(*Params, TEXT("Gpu"));
+	const bool bRunCpu = FParse::Param(*Params, TEXT("Cpu")) || !bRunGpu;
+
+	if (bRunGpu && !FApp::CanEverRender())
+	{
+		UE_LOG(LogCaustic, Error, TEXT("CausticProfile: -Gpu needs a render device, add -AllowCommandletRendering"));
+		return 1;
+	}
+
+	const FCausticCpuSimulationConfig Config = Script.GetSimulationConfig();
+	const FString CpuDirectory = FPaths::Combine(OutputDirectory, TEXT("Cpu"));
+	const FString GpuDirectory = FPaths::Combine(OutputDirectory, TEXT("Gpu"));
+
+	TUniquePtr<FCausticCpuSimulation> CpuSimulation = bRunCpu ? MakeUnique<FCausticCpuSimulation>(Config) : nullptr;
+	TUniquePtr<FCausticGpuProfiler> GpuProfiler = bRunGpu ? MakeUnique<FCausticGpuProfiler>(Config) : nullptr;
+
+	if (GpuProfiler.IsValid() && !GpuProfiler->IsReady())
+	{
+		UE_LOG(LogCaustic, Error, TEXT("CausticProfile: the shader passes failed to initialize"));
+		return 1;
+	}
+
+	const FCausticSolverCoefficients SolverCoefficients = Caustic::ComputeSolverCoefficients(Script.LiquidParam);
+	Caustic::WarnSolverClamp(Script.LiquidParam, SolverCoefficients, TEXT("CausticProfile"));
+
+	FCausticFrameParams FrameParams = FCausticFrameParams::Create(Script.LiquidParam, SolverCoefficients);
+	FrameParams.LightDirection = Script.LightDirection;
+	FrameParams.InteractionForce = Script.InteractionForce;
+
+	UE_LOG(LogCaustic, Display, TEXT("CausticProfile: %d frames, simulation %dx%d, caustic %dx%d, %d interactors"),
+		Script.Frames, Config.TextureWidth, Config.TextureHeight, Config.CausticWidth, Config.CausticHeight, Script.Interactors.Num());
+
+	FString Csv = TEXT("Frame,CpuDepthMs,CpuHeightMs,CpuNormalMs,CpuCausticMs,GpuDepthMs,GpuHeightMs,GpuNormalMs,GpuCausticMs,GpuFrameMs\n");
+	double CpuStageTotals[(int32)ECausticCpuStage::MAX] = {};
+	FCausticStageTimings GpuStageTotals;
+	double GpuTotal = 0.0;
+	TArray<float> SceneDepth;
+
+	for (int32 Frame = 0; Frame < Script.Frames; ++Frame)
+	{
+		RenderInteractorDepth(Script, Frame * Caustic::SimulationStepTime, SceneDepth);
+
+		double CpuStageSeconds[(int32)ECausticCpuStage::MAX] = {};
+		if (CpuSimulation.IsValid())
+		{
+			CpuSimulation->Step(FrameParams, SceneDepth, CpuStageSeconds);
+
+			for (int32 Stage = 0; Stage < (int32)ECausticCpuStage::MAX; ++Stage)
+			{
+				CpuStageTotals[Stage] += CpuStageSeconds[Stage];
+			}
+		}
+
+		FCausticStageTimings GpuStageSeconds;
+		const double GpuSeconds = GpuProfiler.IsValid() ? GpuProfiler->Step(FrameParams, SceneDepth, GpuStageSeconds) : 0.0;
+		GpuTotal += GpuSeconds;
+		GpuStageTotals.DepthSeconds += GpuStageSeconds.DepthSeconds;
+		GpuStageTotals.HeightSeconds += GpuStageSeconds.HeightSeconds;
+		GpuStageTotals.NormalSeconds += GpuStageSeconds.NormalSeconds;
+		GpuStageTotals.CausticSeconds += GpuStageSeconds.CausticSeconds;
+
+		Csv += FString::Printf(TEXT("%d,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f\n"), Frame,
+			CpuStageSeconds[(int32)ECausticCpuStage::Depth] * 1000.0,
+			CpuStageSeconds[(int32)ECausticCpuStage::Height] * 1000.0,
+			CpuStageSeconds[(int32)ECausticCpuStage::Normal] * 1000.0,
+			CpuStageSeconds[(int32)ECausticCpuStage::Caustic] * 1000.0,
+			GpuStageSeconds.DepthSeconds * 1000.0,
+			GpuStageSeconds.HeightSeconds * 1000.0,
+			GpuStageSeconds.NormalSeconds * 1000.0,
+			GpuStageSeconds.CausticSeconds * 1000.0,
+			GpuSeconds * 1000.0);
+
+		if (DumpEvery > 0 && (Frame + 1) % DumpEvery == 0)
+		{
+			FCausticProfileFrame CpuFrame;
+			FCausticProfileFrame GpuFrame;
+
+			if (CpuSimulation.IsValid())
+			{
+				CpuFrame.Height = CpuSimulation->GetHeight();
+				CpuFrame.Normal = CpuSimulation->GetNormal();
+				CpuFrame.Caustic = CpuSimulation->GetCaustic();
+				DumpFrame(CpuDirectory, Frame + 1, CpuFrame, Config);
+			}
+
+			if (GpuProfiler.IsValid())
+			{
+				GpuProfiler->Readback(GpuFrame);
+				DumpFrame(GpuDirectory, Frame + 1, GpuFrame, Config);
+			}
+
+			if (CpuSimulation.IsValid() && GpuProfiler.IsValid())
+			{
+				const double HeightError = GetRootMeanSquare(CpuFrame.Height, GpuFrame.Height, [](float A, float B) { return FMath::Square(A - B); });
+				const double CausticError = GetRootMeanSquare(CpuFrame.Caustic, GpuFrame.Caustic, [](const FLinearColor& A, const FLinearColor& B) { return FMath::Square(A.G - B.G); });
+				UE_LOG(LogCaustic, Display, TEXT("CausticProfile: frame %d, height RMS difference %.6f, caustic RMS difference %.6f"), Frame + 1, HeightError, CausticError);
+			}
+		}
+	}
+
+	const FString CsvPath = FPaths::Combine(OutputDirectory, TEXT("Timings.csv"));
+	FFileHelper::SaveStringToFile(Csv, *CsvPath);
+
+	const int32 FrameCount = FMath::Max(Script.Frames, 1);
+	if (CpuSimulation.IsValid())
+	{
+		UE_LOG(LogCaustic, Display, TEXT("CausticProfile: CPU average depth %.3f ms, height %.3f ms, normal %.3f ms, caustic %.3f ms"),
+			CpuStageTotals[(int32)ECausticCpuStage::Depth] * 1000.0 / FrameCount,
+			CpuStageTotals[(int32)ECausticCpuStage::Height] * 1000.0 / FrameCount,
+			CpuStageTotals[(int32)ECausticCpuStage::Normal] * 1000.0 / FrameCount,
+			CpuStageTotals[(int32)ECausticCpuStage::Caustic] * 1000.0 / FrameCount);
+	}
+
+	if (GpuProfiler.IsValid())
+	{
+		UE_LOG(LogCaustic, Display, TEXT("CausticProfile: GPU average depth %.3f ms, height %.3f ms, normal %.3f ms, caustic %.3f ms, frame %.3f ms"),
+			GpuStageTotals.DepthSeconds * 1000.0 / FrameCount,
+			GpuStageTotals.HeightSeconds * 1000.0 / FrameCount,
+			GpuStageTotals.NormalSeconds * 1000.0 / FrameCount,
+			GpuStageTotals.CausticSeconds * 1000.0 / FrameCount,
+			GpuTotal * 1000.0 / FrameCount);
+	}
+
+	UE_LOG(LogCaustic, Display, TEXT("CausticProfile: timings written to %s"), *CsvPath);
+
+	return 0;
+}
@@ -0,0 +1,28 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "CausticProfileCommandlet.generated.h"
+
+/**
+ * Steps a body configuration through scripted interactor paths without a world, and writes per stage
+ * timings and frame dumps. Runs the CPU reference by default so it works on machines without a GPU.
+ *
+ *   UE4Editor-Cmd <Project> -run=CausticProfile [-Script=Path.json] [-Frames=N] [-DumpEvery=N] [-Output=Dir] [-Cpu] [-Gpu]
+ *
+ * -Gpu runs the shader passes as well, which needs -AllowCommandletRendering. With both, the dumped
+ * frames are compared and the differences logged.
+ */
+UCLASS()
+class UCausticProfileCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+
+	UCausticProfileCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+};
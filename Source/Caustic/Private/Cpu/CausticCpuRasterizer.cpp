@@ -0,0 +1,168 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#include "Cpu/CausticCpuRasterizer.h"
+#include "Async/ParallelFor.h"
+#include "Math/VectorRegister.h"
+
+namespace
+{
+	/** Square tile edge in pixels, a multiple of the four lanes an edge function evaluates at once */
+	const int32 CausticTileSize = 32;
+}
+
+bool FCausticCpuTriangle::Setup(const FVector2D Screen[3], const FLinearColor& InColor, int32 Width, int32 Height)
+{
+	Bounds = FIntRect();
+
+	const float Determinant = (Screen[1].X - Screen[0].X) * (Screen[2].Y - Screen[0].Y) - (Screen[2].X - Screen[0].X) * (Screen[1].Y - Screen[0].Y);
+	if (FMath::Abs(Determinant) < SMALL_NUMBER)
+	{
+		return false;
+	}
+
+	// Flipping clockwise triangles keeps the inside on the positive side of every edge
+	const float Orientation = FMath::Sign(Determinant);
+
+	for (int32 Edge = 0; Edge < 3; ++Edge)
+	{
+		const FVector2D& From = Screen[Edge];
+		const FVector2D& To = Screen[(Edge + 1) % 3];
+		const float DeltaX = To.X - From.X;
+		const float DeltaY = To.Y - From.Y;
+
+		EdgeA[Edge] = -DeltaY * Orientation;
+		EdgeB[Edge] = DeltaX * Orientation;
+		EdgeC[Edge] = (DeltaY * From.X - DeltaX * From.Y) * Orientation;
+	}
+
+	Bounds.Min.X = FMath::Max(FMath::FloorToInt(FMath::Min3(Screen[0].X, Screen[1].X, Screen[2].X)), 0);
+	Bounds.Min.Y = FMath::Max(FMath::FloorToInt(FMath::Min3(Screen[0].Y, Screen[1].Y, Screen[2].Y)), 0);
+	Bounds.Max.X = FMath::Min(FMath::CeilToInt(FMath::Max3(Screen[0].X, Screen[1].X, Screen[2].X)), Width);
+	Bounds.Max.Y = FMath::Min(FMath::CeilToInt(FMath::Max3(Screen[0].Y, Screen[1].Y, Screen[2].Y)), Height);
+
+	Color = InColor;
+
+	return IsValid();
+}
+
+FCausticCpuRasterizer::FCausticCpuRasterizer(int32 InWidth, int32 InHeight) :
+	Width(InWidth),
+	Height(InHeight),
+	TilesX(FMath::DivideAndRoundUp(InWidth, CausticTileSize)),
+	TilesY(FMath::DivideAndRoundUp(InHeight, CausticTileSize))
+{
+	TileBins.SetNum(TilesX * TilesY);
+}
+
+void FCausticCpuRasterizer::Rasterize(const TArray<FCausticCpuTriangle>& Triangles, TArray<FLinearColor>& Output)
+{
+	Output.SetNumUninitialized(Width * Height);
+
+	for (TArray<int32>& TileBin : TileBins)
+	{
+		TileBin.Reset();
+	}
+
+	// Binning runs in submission order so every tile keeps the overwrite order of the grid
+	for (int32 TriangleIndex = 0; TriangleIndex < Triangles.Num(); ++TriangleIndex)
+	{
+		const FCausticCpuTriangle& Triangle = Triangles[TriangleIndex];
+		if (!Triangle.IsValid())
+		{
+			continue;
+		}
+
+		const int32 MinTileX = Triangle.Bounds.Min.X / CausticTileSize;
+		const int32 MinTileY = Triangle.Bounds.Min.Y / CausticTileSize;
+		const int32 MaxTileX = (Triangle.Bounds.Max.X - 1) / CausticTileSize;
+		const int32 MaxTileY = (Triangle.Bounds.Max.Y - 1) / CausticTileSize;
+
+		for (int32 TileY = MinTileY; TileY <= MaxTileY; ++TileY)
+		{
+			for (int32 TileX = MinTileX; TileX <= MaxTileX; ++TileX)
+			{
+				TileBins[TileY * TilesX + TileX].Add(TriangleIndex);
+			}
+		}
+	}
+
+	// Tiles share no pixels, so they are filled without synchronization
+	ParallelFor(TileBins.Num(), [this, &Triangles, &Output](int32 TileIndex)
+	{
+		RasterizeTile(TileIndex, Triangles, Output);
+	});
+}
+
+void FCausticCpuRasterizer::RasterizeTile(int32 TileIndex, const TArray<FCausticCpuTriangle>& Triangles, TArray<FLinearColor>& Output) const
+{
+	const int32 TileMinX = (TileIndex % TilesX) * CausticTileSize;
+	const int32 TileMinY = (TileIndex / TilesX) * CausticTileSize;
+	const int32 TileMaxX = FMath::Min(TileMinX + CausticTileSize, Width);
+	const int32 TileMaxY = FMath::Min(TileMinY + CausticTileSize, Height);
+
+	FLinearColor* Pixels = Output.GetData();
+
+	for (int32 Y = TileMinY; Y < TileMaxY; ++Y)
+	{
+		for (int32 X = TileMinX; X < TileMaxX; ++X)
+		{
+			Pixels[Y * Width + X] = FLinearColor::Black;
+		}
+	}
+
+	const VectorRegister LaneCenters = MakeVectorRegister(0.5f, 1.5f, 2.5f, 3.5f);
+	const VectorRegister Zero = VectorZero();
+
+	for (const int32 TriangleIndex : TileBins[TileIndex])
+	{
+		const FCausticCpuTriangle& Triangle = Triangles[TriangleIndex];
+
+		const int32 MinX = FMath::Max(Triangle.Bounds.Min.X, TileMinX);
+		const int32 MinY = FMath::Max(Triangle.Bounds.Min.Y, TileMinY);
+		const int32 MaxX = FMath::Min(Triangle.Bounds.Max.X, TileMaxX);
+		const int32 MaxY = FMath::Min(Triangle.Bounds.Max.Y, TileMaxY);
+
+		const VectorRegister EdgeA[3] = { VectorSetFloat1(Triangle.EdgeA[0]), VectorSetFloat1(Triangle.EdgeA[1]), VectorSetFloat1(Triangle.EdgeA[2]) };
+		const VectorRegister EdgeStepX[3] = { VectorSetFloat1(Triangle.EdgeA[0] * 4.0f), VectorSetFloat1(Triangle.EdgeA[1] * 4.0f), VectorSetFloat1(Triangle.EdgeA[2] * 4.0f) };
+		const VectorRegister FirstCenterX = VectorAdd(VectorSetFloat1((float)MinX), LaneCenters);
+
+		for (int32 Y = MinY; Y < MaxY; ++Y)
+		{
+			const float CenterY = Y + 0.5f;
+
+			VectorRegister Edge[3];
+			for (int32 EdgeIndex = 0; EdgeIndex < 3; ++EdgeIndex)
+			{
+				Edge[EdgeIndex] = VectorMultiplyAdd(EdgeA[EdgeIndex], FirstCenterX, VectorSetFloat1(Triangle.EdgeB[EdgeIndex] * CenterY + Triangle.EdgeC[EdgeIndex]));
+			}
+
+			FLinearColor* Row = Pixels + Y * Width;
+
+			for (int32 X = MinX; X < MaxX; X += 4)
+			{
+				const VectorRegister Inside = VectorBitwiseAnd(
+					VectorBitwiseAnd(VectorCompareGE(Edge[0], Zero), VectorCompareGE(Edge[1], Zero)),
+					VectorCompareGE(Edge[2], Zero));
+
+				uint32 LaneMask = VectorMaskBits(Inside);
+
+				// Lanes past the end of the span belong to the next tile or lie outside the texture
+				if (MaxX - X < 4)
+				{
+					LaneMask &= (1u << (MaxX - X)) - 1;
+				}
+
+				while (LaneMask)
+				{
+					Row[X + FMath::CountTrailingZeros(LaneMask)] = Triangle.Color;
+					LaneMask &= LaneMask - 1;
+				}
+
+				for (int32 EdgeIndex = 0; EdgeIndex < 3; ++EdgeIndex)
+				{
+					Edge[EdgeIndex] = VectorAdd(Edge[EdgeIndex], EdgeStepX[EdgeIndex]);
+				}
+			}
+		}
+	}
+}
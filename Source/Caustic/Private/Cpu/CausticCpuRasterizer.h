@@ -0,0 +1,53 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/** Edge equations of a screen space triangle with a constant colour, a pixel centre is inside when all three are non-negative */
+struct FCausticCpuTriangle
+{
+	float                     EdgeA[3];
+	float                     EdgeB[3];
+	float                     EdgeC[3];
+
+	/** Pixels the triangle can cover, empty for triangles left out of the raster */
+	FIntRect                  Bounds;
+
+	FLinearColor              Color;
+
+	/** Returns false for degenerate and off screen triangles, either winding is accepted since the pass does not cull */
+	bool Setup(const FVector2D Screen[3], const FLinearColor& InColor, int32 Width, int32 Height);
+
+	FORCEINLINE bool IsValid() const { return Bounds.Min.X < Bounds.Max.X && Bounds.Min.Y < Bounds.Max.Y; }
+};
+
+/**
+ * Rasterizes the caustic grid on the CPU. Triangles are binned into square tiles in submission order, and
+ * the tiles are filled in parallel with four pixels per edge function evaluation. Later triangles
+ * overwrite earlier ones, like the opaque blend of the GPU pass.
+ */
+class FCausticCpuRasterizer
+{
+
+public:
+
+	FCausticCpuRasterizer(int32 InWidth, int32 InHeight);
+
+	/** Clears Output to black and draws the valid triangles into it */
+	void Rasterize(const TArray<FCausticCpuTriangle>& Triangles, TArray<FLinearColor>& Output);
+
+private:
+
+	void RasterizeTile(int32 TileIndex, const TArray<FCausticCpuTriangle>& Triangles, TArray<FLinearColor>& Output) const;
+
+private:
+
+	int32                     Width;
+	int32                     Height;
+	int32                     TilesX;
+	int32                     TilesY;
+
+	/** Triangle indices per tile, kept between frames so the bins do not reallocate */
+	TArray<TArray<int32>>     TileBins;
+};
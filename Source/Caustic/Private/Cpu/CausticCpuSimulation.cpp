@@ -0,0 +1,404 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#include "Cpu/CausticCpuSimulation.h"
+#include "Pass/SurfaceCausticPass.h"
+#include "HAL/PlatformTime.h"
+#include "Async/ParallelFor.h"
+
+namespace
+{
+	/** HLSL refract, a zero vector on total internal reflection */
+	FVector Refract(const FVector& Incident, const FVector& Normal, float Eta)
+	{
+		const float CosI = FVector::DotProduct(Normal, Incident);
+		const float K = 1.0f - Eta * Eta * (1.0f - CosI * CosI);
+
+		return (K < 0.0f) ? FVector::ZeroVector : Eta * Incident - (Eta * CosI + FMath::Sqrt(K)) * Normal;
+	}
+
+	/** Screen space gradient of an attribute interpolated over a triangle, the CPU side of ddx and ddy */
+	void GetAttributeGradient(const FVector2D Screen[3], const FVector2D Attribute[3], float InvDeterminant, FVector2D& OutDdx, FVector2D& OutDdy)
+	{
+		const FVector2D ScreenEdge1 = Screen[1] - Screen[0];
+		const FVector2D ScreenEdge2 = Screen[2] - Screen[0];
+		const FVector2D AttributeEdge1 = Attribute[1] - Attribute[0];
+		const FVector2D AttributeEdge2 = Attribute[2] - Attribute[0];
+
+		OutDdx = (AttributeEdge1 * ScreenEdge2.Y - AttributeEdge2 * ScreenEdge1.Y) * InvDeterminant;
+		OutDdy = (AttributeEdge2 * ScreenEdge1.X - AttributeEdge1 * ScreenEdge2.X) * InvDeterminant;
+	}
+}
+
+FCausticCpuSimulation::FCausticCpuSimulation(const FCausticCpuSimulationConfig& InConfig) :
+	Config(InConfig),
+	Rasterizer(InConfig.CausticWidth, InConfig.CausticHeight),
+	bHasObstacleMask(false)
+{
+	const int32 TexelCount = Config.TextureWidth * Config.TextureHeight;
+
+	CurrentHeight.SetNumZeroed(TexelCount);
+	PreviousHeight.SetNumZeroed(TexelCount);
+	NextHeight.SetNumZeroed(TexelCount);
+	SolverScratch.SetNumZeroed(TexelCount);
+	ObstacleMask.SetNumZeroed(TexelCount);
+	Displacement.SetNumZeroed(TexelCount);
+	Normal.Init(FVector(0.5f, 0.5f, 1.0f), TexelCount);
+	Caustic.Init(FLinearColor::Black, Config.CausticWidth * Config.CausticHeight);
+}
+
+void FCausticCpuSimulation::SetObstacleMask(const TArray<float>& SceneDepth, float ObstacleDepth)
+{
+	check(SceneDepth.Num() == ObstacleMask.Num());
+
+	for (int32 Index = 0; Index < ObstacleMask.Num(); ++Index)
+	{
+		ObstacleMask[Index] = (SceneDepth[Index] <= ObstacleDepth) ? 1 : 0;
+	}
+
+	bHasObstacleMask = true;
+}
+
+void FCausticCpuSimulation::RenderDepth(const FCausticFrameParams& Params, const TArray<float>& SceneDepth)
+{
+	check(SceneDepth.Num() == CurrentHeight.Num());
+
+	const float DepthRange = Config.MaxDepth - Config.MinDepth;
+
+	if (Params.InteractionForce == ECausticInteractionForce::DisplacedVolume)
+	{
+		for (int32 Index = 0; Index < CurrentHeight.Num(); ++Index)
+		{
+			// The column below the highest point of an interactor counts as displaced, a miss displaces nothing
+			const float Depth = SceneDepth[Index];
+			const float Displaced = (Config.MaxDepth >= Depth) ? FMath::Clamp((Config.MaxDepth - Depth) / DepthRange, 0.0f, 1.0f) : 0.0f;
+			const float Delta = Displaced - Displacement[Index];
+			Displacement[Index] = Displaced;
+
+			// The GPU keeps the displacement as a half float, so the two drift apart by its precision
+			if (Delta != 0.0f)
+			{
+				CurrentHeight[Index] = FMath::Clamp(CurrentHeight[Index] + Delta * Params.ForceFactor, -0.999f, 0.999f);
+			}
+		}
+		return;
+	}
+
+	// Texels past the far end of the capture keep their simulated height
+	for (int32 Index = 0; Index < CurrentHeight.Num(); ++Index)
+	{
+		const float Depth = SceneDepth[Index];
+		if (Config.MaxDepth >= Depth)
+		{
+			CurrentHeight[Index] = (Depth - Config.MinDepth) / DepthRange * Params.ForceFactor;
+		}
+	}
+}
+
+FIntPoint FCausticCpuSimulation::ResolveBoundaryTexel(int32 X, int32 Y, ECausticBoundaryMode BoundaryMode) const
+{
+	const int32 Width = Config.TextureWidth;
+	const int32 Height = Config.TextureHeight;
+
+	if (BoundaryMode == ECausticBoundaryMode::Periodic)
+	{
+		return FIntPoint((X + Width) % Width, (Y + Height) % Height);
+	}
+
+	// Reusing the edge texel gives a zero gradient wall that reflects waves
+	return FIntPoint(FMath::Clamp(X, 0, Width - 1), FMath::Clamp(Y, 0, Height - 1));
+}
+
+void FCausticCpuSimulation::RenderHeight(const FCausticFrameParams& Params)
+{
+	const int32 Width = Config.TextureWidth;
+	const int32 Height = Config.TextureHeight;
+	const FVector4& LiquidParam = Params.HeightParam;
+	const ECausticBoundaryMode BoundaryMode = Params.BoundaryMode;
+	const bool bNinePointStencil = Params.Solver == ECausticSolver::NinePoint;
+	const bool bAbsorbing = BoundaryMode == ECausticBoundaryMode::Absorbing;
+
+	const int32 StepX = FMath::Max(FMath::RoundToInt(LiquidParam.W * Width), 1);
+	const int32 StepY = FMath::Max(FMath::RoundToInt(LiquidParam.W * Height), 1);
+
+	for (int32 Iteration = 0; Iteration < Params.SolverIterations; ++Iteration)
+	{
+		// Same ping-pong as the GPU, the last iteration lands in NextHeight
+		const bool bWriteOutput = (Params.SolverIterations - 1 - Iteration) % 2 == 0;
+		TArray<float>& Target = bWriteOutput ? NextHeight : SolverScratch;
+		const TArray<float>& Neighbours = (Iteration == 0) ? CurrentHeight : bWriteOutput ? SolverScratch : NextHeight;
+
+		for (int32 Y = 0; Y < Height; ++Y)
+		{
+			for (int32 X = 0; X < Width; ++X)
+			{
+				const int32 Index = Y * Width + X;
+
+				// The surface is pinned inside solid geometry
+				if (bHasObstacleMask && ObstacleMask[Index])
+				{
+					Target[Index] = 0.0f;
+					continue;
+				}
+
+				const float NeighbourCenterHeight = Neighbours[Index];
+
+				// Solid neighbours mirror the centre texel so waves reflect off them
+				auto LoadNeighbourHeight = [&](int32 OffsetX, int32 OffsetY)
+				{
+					const int32 NeighbourIndex = GetIndex(ResolveBoundaryTexel(X + OffsetX, Y + OffsetY, BoundaryMode));
+					return (bHasObstacleMask && ObstacleMask[NeighbourIndex]) ? NeighbourCenterHeight : Neighbours[NeighbourIndex];
+				};
+
+				float NeighbourSum =
+					LoadNeighbourHeight(StepX, 0) +
+					LoadNeighbourHeight(-StepX, 0) +
+					LoadNeighbourHeight(0, StepY) +
+					LoadNeighbourHeight(0, -StepY);
+
+				if (bNinePointStencil)
+				{
+					const float CornerSum =
+						LoadNeighbourHeight(StepX, StepY) +
+						LoadNeighbourHeight(-StepX, StepY) +
+						LoadNeighbourHeight(StepX, -StepY) +
+						LoadNeighbourHeight(-StepX, -StepY);
+
+					NeighbourSum = (4.0f * NeighbourSum + CornerSum) / 5.0f;
+				}
+
+				float NewHeight = LiquidParam.X * CurrentHeight[Index] + LiquidParam.Z * NeighbourSum + LiquidParam.Y * PreviousHeight[Index];
+				NewHeight *= Params.AttenuationCoefficient;
+
+				if (bAbsorbing)
+				{
+					const int32 EdgeDistance = FMath::Min(FMath::Min(X, Width - 1 - X), FMath::Min(Y, Height - 1 - Y));
+					const float LayerDepth = FMath::Clamp(1.0f - EdgeDistance / Params.SpongeWidth, 0.0f, 1.0f);
+					NewHeight *= 1.0f - Params.SpongeStrength * LayerDepth * LayerDepth;
+				}
+
+				Target[Index] = NewHeight;
+			}
+		}
+	}
+
+	// Rotate the frames, what was current becomes previous
+	Swap(PreviousHeight, CurrentHeight);
+	Swap(CurrentHeight, NextHeight);
+}
+
+void FCausticCpuSimulation::RenderNormal(const FCausticFrameParams& Params)
+{
+	const int32 Width = Config.TextureWidth;
+	const int32 Height = Config.TextureHeight;
+	const ECausticBoundaryMode BoundaryMode = Params.BoundaryMode;
+
+	for (int32 Y = 0; Y < Height; ++Y)
+	{
+		for (int32 X = 0; X < Width; ++X)
+		{
+			const int32 Index = Y * Width + X;
+
+			if (bHasObstacleMask && ObstacleMask[Index])
+			{
+				Normal[Index] = FVector(0.5f, 0.5f, 1.0f);
+				continue;
+			}
+
+			const float LeftHeight = CurrentHeight[GetIndex(ResolveBoundaryTexel(X - 1, Y, BoundaryMode))];
+			const float RightHeight = CurrentHeight[GetIndex(ResolveBoundaryTexel(X + 1, Y, BoundaryMode))];
+			const float BottomHeight = CurrentHeight[GetIndex(ResolveBoundaryTexel(X, Y - 1, BoundaryMode))];
+			const float TopHeight = CurrentHeight[GetIndex(ResolveBoundaryTexel(X, Y + 1, BoundaryMode))];
+
+			const FVector SurfaceNormal = FVector(LeftHeight - RightHeight, BottomHeight - TopHeight, 5.0f / Width).GetSafeNormal();
+			Normal[Index] = SurfaceNormal * 0.5f + 0.5f;
+		}
+	}
+}
+
+FVector FCausticCpuSimulation::SampleNormal(float U, float V) const
+{
+	const int32 Width = Config.TextureWidth;
+	const int32 Height = Config.TextureHeight;
+
+	const float TexelX = FMath::Clamp(U * Width - 0.5f, 0.0f, Width - 1.0f);
+	const float TexelY = FMath::Clamp(V * Height - 0.5f, 0.0f, Height - 1.0f);
+	const int32 X0 = FMath::FloorToInt(TexelX);
+	const int32 Y0 = FMath::FloorToInt(TexelY);
+	const int32 X1 = FMath::Min(X0 + 1, Width - 1);
+	const int32 Y1 = FMath::Min(Y0 + 1, Height - 1);
+	const float FracX = TexelX - X0;
+	const float FracY = TexelY - Y0;
+
+	const FVector Top = FMath::Lerp(Normal[Y0 * Width + X0], Normal[Y0 * Width + X1], FracX);
+	const FVector Bottom = FMath::Lerp(Normal[Y1 * Width + X0], Normal[Y1 * Width + X1], FracX);
+
+	return FMath::Lerp(Top, Bottom, FracY);
+}
+
+bool FCausticCpuSimulation::IsObstacleAt(float U, float V) const
+{
+	if (!bHasObstacleMask)
+	{
+		return false;
+	}
+
+	const int32 X = FMath::Clamp(FMath::FloorToInt(U * Config.TextureWidth), 0, Config.TextureWidth - 1);
+	const int32 Y = FMath::Clamp(FMath::FloorToInt(V * Config.TextureHeight), 0, Config.TextureHeight - 1);
+
+	return ObstacleMask[Y * Config.TextureWidth + X] != 0;
+}
+
+void FCausticCpuSimulation::RenderCaustic(const FCausticFrameParams& Params)
+{
+	const int32 CausticWidth = Config.CausticWidth;
+	const int32 CausticHeight = Config.CausticHeight;
+	const FIntPoint GridSize = FSurfaceCausticPassRenderer::GetGridSize(CausticWidth, CausticHeight, Config.CellSize);
+	const int32 SizeX = GridSize.X;
+	const int32 SizeY = GridSize.Y;
+	const bool bDispersion = Params.Dispersion > 0.0f;
+	const bool bRefracted = Params.Projection == ECausticProjection::Refracted;
+
+	const FVector LightDirection = Params.LightDirection.GetSafeNormal(SMALL_NUMBER, FVector(0.0f, 0.0f, -1.0f));
+	const FVector2D FloorOffsetScale(2.0f * Config.BodyDepth / FMath::Max(Config.BodyWidth, 1.0f), 2.0f * Config.BodyDepth / FMath::Max(Config.BodyHeight, 1.0f));
+
+	// GetRefractedOffset of the vertex shader
+	auto GetRefractedOffset = [&](const FVector& SurfaceNormal, float Strength)
+	{
+		if (bRefracted)
+		{
+			const float IndexOfRefraction = 1.0f + (Params.IndexOfRefraction - 1.0f) * Strength;
+			const FVector Refracted = Refract(LightDirection, SurfaceNormal.GetSafeNormal(), 1.0f / IndexOfRefraction);
+			const float Distance = FMath::Max(-Refracted.Z, 0.01f);
+
+			return FVector2D(Refracted.X / Distance * FloorOffsetScale.X, Refracted.Y / Distance * FloorOffsetScale.Y);
+		}
+
+		return FVector2D(SurfaceNormal.X, SurfaceNormal.Y) * Params.Refraction * Strength;
+	};
+
+	// Vertex stage, positions in clip space like the grid vertex buffer
+	const int32 VertexCount = (SizeX + 1) * (SizeY + 1);
+	OldPositions.SetNumUninitialized(VertexCount);
+	DryVertices.SetNumUninitialized(VertexCount);
+	for (TArray<FVector2D>& Positions : NewPositions)
+	{
+		Positions.SetNumUninitialized(VertexCount);
+	}
+
+	ParallelFor(SizeY + 1, [&](int32 Y)
+	{
+		for (int32 X = 0; X <= SizeX; ++X)
+		{
+			const int32 Index = Y * (SizeX + 1) + X;
+			const float U = (float)X / SizeX;
+			const float V = 1.0f - (float)Y / SizeY;
+
+			const FVector SurfaceNormal = SampleNormal(U, V) - 0.5f;
+			const FVector2D OldPosition(FMath::Lerp(-1.0f, 1.0f, (float)X / SizeX), FMath::Lerp(-1.0f, 1.0f, (float)Y / SizeY));
+
+			OldPositions[Index] = OldPosition;
+			NewPositions[1][Index] = OldPosition + GetRefractedOffset(SurfaceNormal, 1.0f);
+			NewPositions[0][Index] = bDispersion ? OldPosition + GetRefractedOffset(SurfaceNormal, 1.0f - Params.Dispersion) : NewPositions[1][Index];
+			NewPositions[2][Index] = bDispersion ? OldPosition + GetRefractedOffset(SurfaceNormal, 1.0f + Params.Dispersion) : NewPositions[1][Index];
+			DryVertices[Index] = IsObstacleAt(U, V);
+		}
+	});
+
+	// Clip space area of one pixel, the area of NewPos under the derivatives of the green channel
+	const FVector2D PixelSize(2.0f / CausticWidth, 2.0f / CausticHeight);
+
+	auto ToScreen = [CausticWidth, CausticHeight](const FVector2D& Clip)
+	{
+		return FVector2D((Clip.X + 1.0f) * 0.5f * CausticWidth, (1.0f - Clip.Y) * 0.5f * CausticHeight);
+	};
+
+	auto SetupTriangle = [&](int32 A, int32 B, int32 C, FCausticCpuTriangle& OutTriangle)
+	{
+		OutTriangle.Bounds = FIntRect();
+
+		// The GPU clips dry vertices past the far plane, the whole triangle is dropped here
+		if (DryVertices[A] || DryVertices[B] || DryVertices[C])
+		{
+			return;
+		}
+
+		const FVector2D Screen[3] = { ToScreen(NewPositions[1][A]), ToScreen(NewPositions[1][B]), ToScreen(NewPositions[1][C]) };
+		const float Determinant = (Screen[1].X - Screen[0].X) * (Screen[2].Y - Screen[0].Y) - (Screen[2].X - Screen[0].X) * (Screen[1].Y - Screen[0].Y);
+		if (FMath::Abs(Determinant) < SMALL_NUMBER)
+		{
+			return;
+		}
+
+		const float InvDeterminant = 1.0f / Determinant;
+
+		// Attributes are affine over a triangle, so the pixel shader output is constant across it
+		auto GetAreaRatio = [&](const FVector2D Attribute[3], float OldArea)
+		{
+			FVector2D Ddx, Ddy;
+			GetAttributeGradient(Screen, Attribute, InvDeterminant, Ddx, Ddy);
+			return OldArea / FMath::Max(Ddx.Size() * Ddy.Size(), SMALL_NUMBER) * 0.5f;
+		};
+
+		const FVector2D Old[3] = { OldPositions[A], OldPositions[B], OldPositions[C] };
+		FVector2D OldDdx, OldDdy;
+		GetAttributeGradient(Screen, Old, InvDeterminant, OldDdx, OldDdy);
+		const float OldArea = OldDdx.Size() * OldDdy.Size();
+
+		const float GreenRatio = OldArea / (PixelSize.X * PixelSize.Y) * 0.5f;
+		FLinearColor Color(GreenRatio, GreenRatio, GreenRatio, 1.0f);
+
+		if (bDispersion)
+		{
+			const FVector2D Red[3] = { NewPositions[0][A], NewPositions[0][B], NewPositions[0][C] };
+			const FVector2D Blue[3] = { NewPositions[2][A], NewPositions[2][B], NewPositions[2][C] };
+			Color.R = GetAreaRatio(Red, OldArea);
+			Color.B = GetAreaRatio(Blue, OldArea);
+		}
+
+		OutTriangle.Setup(Screen, Color, CausticWidth, CausticHeight);
+	};
+
+	// Same triangle order as the grid index buffer, two triangles per cell
+	Triangles.SetNumUninitialized(SizeX * SizeY * 2);
+
+	ParallelFor(SizeY, [&](int32 Y)
+	{
+		for (int32 X = 0; X < SizeX; ++X)
+		{
+			const int32 A = Y * (SizeX + 1) + X;
+			const int32 B = A + SizeX + 1;
+			const int32 C = A + SizeX + 2;
+			const int32 D = A + 1;
+			const int32 Cell = Y * SizeX + X;
+
+			SetupTriangle(A, B, C, Triangles[Cell * 2]);
+			SetupTriangle(A, C, D, Triangles[Cell * 2 + 1]);
+		}
+	});
+
+	Rasterizer.Rasterize(Triangles, Caustic);
+}
+
+void FCausticCpuSimulation::Step(const FCausticFrameParams& Params, const TArray<float>& SceneDepth, double OutStageSeconds[(int32)ECausticCpuStage::MAX])
+{
+	double StartTime = FPlatformTime::Seconds();
+
+	auto EndStage = [&StartTime, OutStageSeconds](ECausticCpuStage Stage)
+	{
+		const double EndTime = FPlatformTime::Seconds();
+		OutStageSeconds[(int32)Stage] += EndTime - StartTime;
+		StartTime = EndTime;
+	};
+
+	RenderDepth(Params, SceneDepth);
+	EndStage(ECausticCpuStage::Depth);
+
+	RenderHeight(Params);
+	EndStage(ECausticCpuStage::Height);
+
+	RenderNormal(Params);
+	EndStage(ECausticCpuStage::Normal);
+
+	RenderCaustic(Params);
+	EndStage(ECausticCpuStage::Caustic);
+}
@@ -0,0 +1,113 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Pass/CausticFrameParams.h"
+#include "Cpu/CausticCpuRasterizer.h"
+
+struct FCausticCpuSimulationConfig
+{
+	/** Simulation grid, the size of the depth capture */
+	int32                     TextureWidth;
+	int32                     TextureHeight;
+
+	/** Caustic output and the refraction grid cell in caustic texels */
+	int32                     CausticWidth;
+	int32                     CausticHeight;
+	float                     CellSize;
+
+	/** Captured depth range that is encoded as interaction */
+	float                     MinDepth;
+	float                     MaxDepth;
+
+	/** Body size in world units, the refracted projection needs it to reach the floor */
+	float                     BodyWidth;
+	float                     BodyHeight;
+	float                     BodyDepth;
+};
+
+/** Stages of one CPU step, in the order the GPU frame graph runs them */
+enum class ECausticCpuStage : uint8
+{
+	Depth,
+	Height,
+	Normal,
+	Caustic,
+	MAX
+};
+
+/**
+ * Reference implementation of the depth encode, height, normal and caustic passes on the CPU. Heights are
+ * kept as floats instead of the packed RG encoding, and the ambient waves are not synthesized, so the
+ * output matches the GPU up to the packing precision on bodies without ambient waves.
+ */
+class FCausticCpuSimulation
+{
+
+public:
+
+	explicit FCausticCpuSimulation(const FCausticCpuSimulationConfig& InConfig);
+
+	/** Marks texels whose captured scene depth is at most ObstacleDepth as solid */
+	void SetObstacleMask(const TArray<float>& SceneDepth, float ObstacleDepth);
+
+	/** Writes the captured interaction depth into the current height, or pushes it by the change in displaced volume */
+	void RenderDepth(const FCausticFrameParams& Params, const TArray<float>& SceneDepth);
+
+	/** Advances the height field by one step */
+	void RenderHeight(const FCausticFrameParams& Params);
+
+	void RenderNormal(const FCausticFrameParams& Params);
+
+	/** Refracts the grid and rasterizes it into the caustic buffer, rows and tiles in parallel */
+	void RenderCaustic(const FCausticFrameParams& Params);
+
+	/** Runs every stage and adds the seconds each one took to OutStageSeconds */
+	void Step(const FCausticFrameParams& Params, const TArray<float>& SceneDepth, double OutStageSeconds[(int32)ECausticCpuStage::MAX]);
+
+	FORCEINLINE const TArray<float>& GetHeight() const { return CurrentHeight; }
+
+	/** Normals encoded as on the GPU, N * 0.5 + 0.5 */
+	FORCEINLINE const TArray<FVector>& GetNormal() const { return Normal; }
+
+	FORCEINLINE const TArray<FLinearColor>& GetCaustic() const { return Caustic; }
+
+	FORCEINLINE const FCausticCpuSimulationConfig& GetConfig() const { return Config; }
+
+private:
+
+	FCausticCpuSimulationConfig Config;
+
+	TArray<float>               CurrentHeight;
+	TArray<float>               PreviousHeight;
+	TArray<float>               NextHeight;
+	TArray<float>               SolverScratch;
+	TArray<uint8>               ObstacleMask;
+
+	/** Volume displaced below each texel on the last step, for the displaced volume force */
+	TArray<float>               Displacement;
+	TArray<FVector>             Normal;
+	TArray<FLinearColor>        Caustic;
+
+	/** Refracted grid of the caustic stage, kept between steps so it does not reallocate */
+	TArray<FVector2D>           OldPositions;
+	TArray<FVector2D>           NewPositions[3];
+	TArray<bool>                DryVertices;
+	TArray<FCausticCpuTriangle> Triangles;
+	FCausticCpuRasterizer       Rasterizer;
+
+	bool                        bHasObstacleMask;
+
+private:
+
+	/** Maps a neighbour texel that may lie outside the domain back into it, see ResolveBoundaryTexel */
+	FIntPoint ResolveBoundaryTexel(int32 X, int32 Y, ECausticBoundaryMode BoundaryMode) const;
+
+	FORCEINLINE int32 GetIndex(const FIntPoint& Texel) const { return Texel.Y * Config.TextureWidth + Texel.X; }
+
+	/** Bilinear sample at a UV, clamped to the edge like the caustic pass sampler */
+	FVector SampleNormal(float U, float V) const;
+
+	bool IsObstacleAt(float U, float V) const;
+};
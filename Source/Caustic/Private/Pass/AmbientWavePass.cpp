@@ -0,0 +1,401 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#include "Pass/AmbientWavePass.h"
+#include "RenderCore/Public/GlobalShader.h"
+#include "RenderCore/Public/ShaderParameterUtils.h"
+#include "RenderCore/Public/ShaderParameterMacros.h"
+#include "RenderCore/Public/ShaderPermutation.h"
+
+#include "Public/GlobalShader.h"
+#include "Public/SceneUtils.h"
+#include "Public/ShaderParameterUtils.h"
+#include "RHI/Public/RHICommandList.h"
+#include "Math/RandomStream.h"
+#include "Pass/CausticMemory.h"
+
+namespace
+{
+	/** Dispersion is quantized to this period so the field loops and the shader time stays small */
+	const float AmbientWaveLoopPeriod = 128.0f;
+
+	const float Gravity = 9.81f;
+}
+
+BEGIN_GLOBAL_SHADER_PARAMETER_STRUCT(FAmbientWaveSpectrumComputeShaderParameters, )
+	SHADER_PARAMETER(float, Time)
+	SHADER_PARAMETER(float, LoopPeriod)
+	SHADER_PARAMETER(float, PatchLength)
+	SHADER_PARAMETER(float, Resolution)
+END_GLOBAL_SHADER_PARAMETER_STRUCT()
+IMPLEMENT_GLOBAL_SHADER_PARAMETER_STRUCT(FAmbientWaveSpectrumComputeShaderParameters, "AmbientWaveSpectrumUniform");
+
+class FAmbientWaveSpectrumComputeShader : public FGlobalShader
+{
+	DECLARE_GLOBAL_SHADER(FAmbientWaveSpectrumComputeShader);
+
+public:
+
+	FAmbientWaveSpectrumComputeShader() {}
+	FAmbientWaveSpectrumComputeShader(const ShaderMetaType::CompiledShaderInitializerType& Initializer)
+		: FGlobalShader(Initializer)
+	{
+		InitialSpectrumTexture.Bind(Initializer.ParameterMap, TEXT("InitialSpectrumTexture"));
+		OutputSpectrumTexture.Bind(Initializer.ParameterMap, TEXT("OutputSpectrumTexture"));
+	}
+
+	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
+	{
+		return IsFeatureLevelSupported(Parameters.Platform, ERHIFeatureLevel::SM5);
+	}
+
+	virtual bool Serialize(FArchive& Ar) override
+	{
+		bool bShaderHasOutdatedParameters = FGlobalShader::Serialize(Ar);
+		Ar << InitialSpectrumTexture << OutputSpectrumTexture;
+		return bShaderHasOutdatedParameters;
+	}
+
+	void BindShaderTextures(FRHICommandList& RHICmdList, FUnorderedAccessViewRHIRef OutputTextureUAV, FShaderResourceViewRHIRef InputTextureSRV)
+	{
+		FRHIComputeShader* ComputeShaderRHI = GetComputeShader();
+
+		SetUAVParameter(RHICmdList, ComputeShaderRHI, OutputSpectrumTexture, OutputTextureUAV);
+		SetSRVParameter(RHICmdList, ComputeShaderRHI, InitialSpectrumTexture, InputTextureSRV);
+	}
+
+	void UnbindShaderTextures(FRHICommandList& RHICmdList)
+	{
+		FRHIComputeShader* ComputeShaderRHI = GetComputeShader();
+
+		SetUAVParameter(RHICmdList, ComputeShaderRHI, OutputSpectrumTexture, FUnorderedAccessViewRHIRef());
+		SetSRVParameter(RHICmdList, ComputeShaderRHI, InitialSpectrumTexture, FShaderResourceViewRHIRef());
+	}
+
+	void SetShaderParameters(FRHICommandList& RHICmdList, const FAmbientWaveSpectrumComputeShaderParameters& Parameters)
+	{
+		FRHIComputeShader* ComputeShaderRHI = GetComputeShader();
+		SetUniformBufferParameterImmediate(RHICmdList, ComputeShaderRHI, GetUniformBufferParameter<FAmbientWaveSpectrumComputeShaderParameters>(), Parameters);
+	}
+
+private:
+
+	FShaderResourceParameter InitialSpectrumTexture;
+	FShaderResourceParameter OutputSpectrumTexture;
+};
+
+class FAmbientWaveFFTComputeShader : public FGlobalShader
+{
+	DECLARE_GLOBAL_SHADER(FAmbientWaveFFTComputeShader);
+
+public:
+
+	class FFFTSizeDim : SHADER_PERMUTATION_SPARSE_INT("CAUSTIC_FFT_SIZE", 64, 128, 256);
+	class FFFTVerticalDim : SHADER_PERMUTATION_BOOL("CAUSTIC_FFT_VERTICAL");
+
+	using FPermutationDomain = TShaderPermutationDomain<FFFTSizeDim, FFFTVerticalDim>;
+
+	FAmbientWaveFFTComputeShader() {}
+	FAmbientWaveFFTComputeShader(const ShaderMetaType::CompiledShaderInitializerType& Initializer)
+		: FGlobalShader(Initializer)
+	{
+		SourceTexture.Bind(Initializer.ParameterMap, TEXT("SourceTexture"));
+		OutputTexture.Bind(Initializer.ParameterMap, TEXT("OutputTexture"));
+	}
+
+	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
+	{
+		return IsFeatureLevelSupported(Parameters.Platform, ERHIFeatureLevel::SM5);
+	}
+
+	virtual bool Serialize(FArchive& Ar) override
+	{
+		bool bShaderHasOutdatedParameters = FGlobalShader::Serialize(Ar);
+		Ar << SourceTexture << OutputTexture;
+		return bShaderHasOutdatedParameters;
+	}
+
+	void BindShaderTextures(FRHICommandList& RHICmdList, FUnorderedAccessViewRHIRef OutputTextureUAV, FShaderResourceViewRHIRef InputTextureSRV)
+	{
+		FRHIComputeShader* ComputeShaderRHI = GetComputeShader();
+
+		SetUAVParameter(RHICmdList, ComputeShaderRHI, OutputTexture, OutputTextureUAV);
+		SetSRVParameter(RHICmdList, ComputeShaderRHI, SourceTexture, InputTextureSRV);
+	}
+
+	void UnbindShaderTextures(FRHICommandList& RHICmdList)
+	{
+		FRHIComputeShader* ComputeShaderRHI = GetComputeShader();
+
+		SetUAVParameter(RHICmdList, ComputeShaderRHI, OutputTexture, FUnorderedAccessViewRHIRef());
+		SetSRVParameter(RHICmdList, ComputeShaderRHI, SourceTexture, FShaderResourceViewRHIRef());
+	}
+
+private:
+
+	FShaderResourceParameter SourceTexture;
+	FShaderResourceParameter OutputTexture;
+};
+
+IMPLEMENT_SHADER_TYPE(, FAmbientWaveSpectrumComputeShader, TEXT("/Plugin/Caustic/AmbientWaveComputeShader.usf"), TEXT("ComputeSpectrum"), SF_Compute);
+IMPLEMENT_SHADER_TYPE(, FAmbientWaveFFTComputeShader, TEXT("/Plugin/Caustic/AmbientWaveComputeShader.usf"), TEXT("ComputeFFT"), SF_Compute);
+
+static float EvaluateSpectrum(const FAmbientWaveSpectrumKey& Key, const FVector2D& K, const FVector2D& WindDirection)
+{
+	const float KLength = K.Size();
+
+	if (KLength < KINDA_SMALL_NUMBER)
+	{
+		return 0.0f;
+	}
+
+	// cos^2 spreading, waves running against the wind are mostly suppressed
+	const float Alignment = FVector2D::DotProduct(K / KLength, WindDirection);
+	const float Spreading = Alignment * Alignment * (Alignment < 0.0f ? 0.07f : 1.0f);
+
+	if (Key.Spectrum == ECausticWaveSpectrum::Phillips)
+	{
+		const float LargestWave = Key.WindSpeed * Key.WindSpeed / Gravity;
+		const float SmallestWave = LargestWave * 0.001f;
+		const float KLengthSqr = KLength * KLength;
+
+		return FMath::Exp(-1.0f / (KLengthSqr * LargestWave * LargestWave)) / (KLengthSqr * KLengthSqr) * Spreading * FMath::Exp(-KLengthSqr * SmallestWave * SmallestWave);
+	}
+
+	// JONSWAP is defined over frequency, map it to wavenumbers with the deep water dispersion w^2 = g k
+	const float Omega = FMath::Sqrt(Gravity * KLength);
+	const float PeakOmega = 0.877f * Gravity / Key.WindSpeed;
+	const float Sigma = (Omega <= PeakOmega) ? 0.07f : 0.09f;
+	const float PeakShape = FMath::Exp(-FMath::Square(Omega - PeakOmega) / (2.0f * Sigma * Sigma * PeakOmega * PeakOmega));
+	const float FrequencySpectrum = 0.0081f * Gravity * Gravity / FMath::Pow(Omega, 5.0f) * FMath::Exp(-1.25f * FMath::Pow(PeakOmega / Omega, 4.0f)) * FMath::Pow(Key.PeakEnhancement, PeakShape);
+
+	return FrequencySpectrum * Gravity / (2.0f * Omega) / KLength * Spreading;
+}
+
+FAmbientWaveSpectrumKey FAmbientWaveSpectrumKey::Create(const FAmbientWaveParam& Param)
+{
+	FAmbientWaveSpectrumKey Key;
+	Key.Spectrum = Param.Spectrum;
+	Key.Resolution = FMath::Clamp<uint32>(FMath::RoundUpToPowerOfTwo(FMath::Max(Param.Resolution, 1)), 64, 256);
+	Key.PatchSize = FMath::Max(Param.PatchSize, 1.0f);
+	Key.WindSpeed = FMath::Max(Param.WindSpeed, 0.1f);
+	Key.WindDirection = Param.WindDirection;
+	Key.PeakEnhancement = FMath::Max(Param.PeakEnhancement, 1.0f);
+	Key.UpdateRate = FMath::Max(Param.UpdateRate, 0.0f);
+	Key.Seed = Param.Seed;
+
+	return Key;
+}
+
+FAmbientWaveSpectrum::FAmbientWaveSpectrum(const FAmbientWaveSpectrumKey& InKey) :
+	Key(InKey),
+	LastUpdateFrame(0),
+	LastUpdateTime(-BIG_NUMBER),
+	SpectrumShader(nullptr),
+	HorizontalFFTShader(nullptr),
+	VerticalFFTShader(nullptr),
+	bResourcesReady(false)
+{
+
+}
+
+uint64 FAmbientWaveSpectrum::GetMemorySize(const FAmbientWaveParam& Param)
+{
+	// Initial spectrum, plus the ping pong pair the FFT runs through
+	const uint32 Resolution = FAmbientWaveSpectrumKey::Create(Param).Resolution;
+	return Caustic::GetTextureMemorySize(Resolution, Resolution, PF_A32B32G32R32F) + Caustic::GetTextureMemorySize(Resolution, Resolution, PF_G32R32F) * 2;
+}
+
+FAmbientWaveSpectrum::~FAmbientWaveSpectrum()
+{
+	ReleaseSpectrumResources();
+}
+
+void FAmbientWaveSpectrum::InitSpectrum()
+{
+	// A few hundred microseconds at 256x256, cheap enough to build on the calling thread
+	TArray<FLinearColor> SpectrumData;
+	BuildInitialSpectrum(SpectrumData);
+
+	ENQUEUE_RENDER_COMMAND(AmbientWaveSpectrumInitCommand)
+	(
+		[WaveSpectrum = AsShared(), SpectrumData = MoveTemp(SpectrumData)](FRHICommandListImmediate& RHICmdList)
+		{
+			WaveSpectrum->InitSpectrum_RenderThread(RHICmdList, SpectrumData);
+		}
+	);
+}
+
+// Reference: Tessendorf, Simulating Ocean Water
+void FAmbientWaveSpectrum::BuildInitialSpectrum(TArray<FLinearColor>& OutSpectrum) const
+{
+	const int32 Resolution = Key.Resolution;
+	const float PatchLength = Key.PatchSize / 100.0f;
+	const float DeltaK = 2.0f * PI / PatchLength;
+	const float WindAngle = FMath::DegreesToRadians(Key.WindDirection);
+	const FVector2D WindDirection(FMath::Cos(WindAngle), FMath::Sin(WindAngle));
+
+	FRandomStream RandomStream(Key.Seed);
+
+	TArray<FVector2D> Amplitudes;
+	Amplitudes.SetNumUninitialized(Resolution * Resolution);
+	double EnergySum = 0.0;
+
+	for (int32 Y = 0; Y < Resolution; ++Y)
+	{
+		for (int32 X = 0; X < Resolution; ++X)
+		{
+			// The spectrum is centered, texel N/2 holds k = 0
+			const FVector2D K(DeltaK * (X - Resolution / 2), DeltaK * (Y - Resolution / 2));
+			const float Energy = EvaluateSpectrum(Key, K, WindDirection);
+
+			// Box-Muller for a complex gaussian sample
+			const float Radius = FMath::Sqrt(-2.0f * FMath::Loge(FMath::Max(RandomStream.GetFraction(), SMALL_NUMBER)));
+			const float Angle = 2.0f * PI * RandomStream.GetFraction();
+
+			const FVector2D Amplitude = FVector2D(Radius * FMath::Cos(Angle), Radius * FMath::Sin(Angle)) * FMath::Sqrt(Energy * 0.5f) * DeltaK;
+			Amplitudes[Y * Resolution + X] = Amplitude;
+			EnergySum += Amplitude.SizeSquared();
+		}
+	}
+
+	// Normalize to unit RMS height, so Amplitude alone sets the wave height whatever the spectrum and wind
+	const float Normalization = (EnergySum > 0.0) ? 1.0f / FMath::Sqrt(2.0 * EnergySum) : 0.0f;
+
+	OutSpectrum.SetNumUninitialized(Resolution * Resolution);
+
+	for (int32 Y = 0; Y < Resolution; ++Y)
+	{
+		for (int32 X = 0; X < Resolution; ++X)
+		{
+			const int32 NegatedIndex = ((Resolution - Y) % Resolution) * Resolution + (Resolution - X) % Resolution;
+			const FVector2D Amplitude = Amplitudes[Y * Resolution + X] * Normalization;
+			const FVector2D NegatedAmplitude = Amplitudes[NegatedIndex] * Normalization;
+
+			// h0(k) and conj(h0(-k)), the pair the time evolution needs to keep the field real
+			OutSpectrum[Y * Resolution + X] = FLinearColor(Amplitude.X, Amplitude.Y, NegatedAmplitude.X, -NegatedAmplitude.Y);
+		}
+	}
+}
+
+void FAmbientWaveSpectrum::InitSpectrum_RenderThread(FRHICommandListImmediate& RHICmdList, const TArray<FLinearColor>& Spectrum)
+{
+	check(IsInRenderingThread());
+
+	FCausticResourcePool& Pool = FCausticResourcePool::Get();
+	const uint32 Resolution = Key.Resolution;
+
+	InitialSpectrum = Pool.AcquireTexture(Resolution, Resolution, PF_A32B32G32R32F, TexCreate_ShaderResource);
+	SpectrumPing = Pool.AcquireTexture(Resolution, Resolution, PF_G32R32F, TexCreate_ShaderResource | TexCreate_UAV);
+	SpectrumPong = Pool.AcquireTexture(Resolution, Resolution, PF_G32R32F, TexCreate_ShaderResource | TexCreate_UAV);
+
+	const FUpdateTextureRegion2D Region(0, 0, 0, 0, Resolution, Resolution);
+	RHIUpdateTexture2D(InitialSpectrum.Texture, 0, Region, Resolution * sizeof(FLinearColor), reinterpret_cast<const uint8*>(Spectrum.GetData()));
+
+	// Resolve the shaders once instead of looking them up every update
+	TShaderMap<FGlobalShaderType>* GlobalShaderMap = GetGlobalShaderMap(ERHIFeatureLevel::SM5);
+	SpectrumShader = *TShaderMapRef<FAmbientWaveSpectrumComputeShader>(GlobalShaderMap);
+
+	FAmbientWaveFFTComputeShader::FPermutationDomain PermutationVector;
+	PermutationVector.Set<FAmbientWaveFFTComputeShader::FFFTSizeDim>(Resolution);
+	PermutationVector.Set<FAmbientWaveFFTComputeShader::FFFTVerticalDim>(false);
+	HorizontalFFTShader = *TShaderMapRef<FAmbientWaveFFTComputeShader>(GlobalShaderMap, PermutationVector);
+	PermutationVector.Set<FAmbientWaveFFTComputeShader::FFFTVerticalDim>(true);
+	VerticalFFTShader = *TShaderMapRef<FAmbientWaveFFTComputeShader>(GlobalShaderMap, PermutationVector);
+
+	bResourcesReady = true;
+}
+
+void FAmbientWaveSpectrum::ReleaseSpectrumResources()
+{
+	FCausticResourcePool& Pool = FCausticResourcePool::Get();
+	Pool.ReleaseTexture(InitialSpectrum);
+	Pool.ReleaseTexture(SpectrumPing);
+	Pool.ReleaseTexture(SpectrumPong);
+}
+
+void FAmbientWaveSpectrum::Update_RenderThread(FRHICommandListImmediate& RHICmdList, float Time)
+{
+	check(IsInRenderingThread());
+
+	if (!bResourcesReady || LastUpdateFrame == GFrameNumberRenderThread)
+	{
+		return;
+	}
+
+	if (Key.UpdateRate > 0.0f && FMath::Abs(Time - LastUpdateTime) < 1.0f / Key.UpdateRate)
+	{
+		return;
+	}
+
+	LastUpdateFrame = GFrameNumberRenderThread;
+	LastUpdateTime = Time;
+
+	SCOPED_DRAW_EVENT(RHICmdList, AmbientWavePass);
+
+	const uint32 Resolution = Key.Resolution;
+
+	// Evolve the spectrum into the ping texture
+	RHICmdList.SetComputeShader(SpectrumShader->GetComputeShader());
+	SpectrumShader->BindShaderTextures(RHICmdList, SpectrumPing.UAV, InitialSpectrum.SRV);
+
+	FAmbientWaveSpectrumComputeShaderParameters UniformParam;
+	UniformParam.Time = FMath::Fmod(Time, AmbientWaveLoopPeriod);
+	UniformParam.LoopPeriod = AmbientWaveLoopPeriod;
+	UniformParam.PatchLength = Key.PatchSize / 100.0f;
+	UniformParam.Resolution = Resolution;
+	SpectrumShader->SetShaderParameters(RHICmdList, UniformParam);
+
+	DispatchComputeShader(RHICmdList, SpectrumShader, FMath::DivideAndRoundUp<uint32>(Resolution, 8), FMath::DivideAndRoundUp<uint32>(Resolution, 8), 1);
+	SpectrumShader->UnbindShaderTextures(RHICmdList);
+	RHICmdList.TransitionResource(EResourceTransitionAccess::EReadable, EResourceTransitionPipeline::EComputeToCompute, SpectrumPing.UAV);
+
+	// Inverse FFT over rows into pong, then over columns back into ping, one group per line
+	RHICmdList.SetComputeShader(HorizontalFFTShader->GetComputeShader());
+	HorizontalFFTShader->BindShaderTextures(RHICmdList, SpectrumPong.UAV, SpectrumPing.SRV);
+	DispatchComputeShader(RHICmdList, HorizontalFFTShader, Resolution, 1, 1);
+	HorizontalFFTShader->UnbindShaderTextures(RHICmdList);
+	RHICmdList.TransitionResource(EResourceTransitionAccess::EReadable, EResourceTransitionPipeline::EComputeToCompute, SpectrumPong.UAV);
+
+	RHICmdList.SetComputeShader(VerticalFFTShader->GetComputeShader());
+	VerticalFFTShader->BindShaderTextures(RHICmdList, SpectrumPing.UAV, SpectrumPong.SRV);
+	DispatchComputeShader(RHICmdList, VerticalFFTShader, Resolution, 1, 1);
+	VerticalFFTShader->UnbindShaderTextures(RHICmdList);
+	RHICmdList.TransitionResource(EResourceTransitionAccess::EReadable, EResourceTransitionPipeline::EComputeToCompute, SpectrumPing.UAV);
+}
+
+FAmbientWaveSpectrumCache& FAmbientWaveSpectrumCache::Get()
+{
+	static FAmbientWaveSpectrumCache Cache;
+	return Cache;
+}
+
+TSharedRef<FAmbientWaveSpectrum, ESPMode::ThreadSafe> FAmbientWaveSpectrumCache::FindOrCreate(const FAmbientWaveParam& Param)
+{
+	check(IsInGameThread());
+
+	const FAmbientWaveSpectrumKey Key = FAmbientWaveSpectrumKey::Create(Param);
+
+	// Forget spectrums whose bodies are all gone
+	for (auto It = Spectrums.CreateIterator(); It; ++It)
+	{
+		if (!It.Value().IsValid())
+		{
+			It.RemoveCurrent();
+		}
+	}
+
+	if (TWeakPtr<FAmbientWaveSpectrum, ESPMode::ThreadSafe>* Existing = Spectrums.Find(Key))
+	{
+		TSharedPtr<FAmbientWaveSpectrum, ESPMode::ThreadSafe> Spectrum = Existing->Pin();
+		if (Spectrum.IsValid())
+		{
+			return Spectrum.ToSharedRef();
+		}
+	}
+
+	TSharedRef<FAmbientWaveSpectrum, ESPMode::ThreadSafe> Spectrum = MakeShared<FAmbientWaveSpectrum, ESPMode::ThreadSafe>(Key);
+	Spectrum->InitSpectrum();
+	Spectrums.Add(Key, Spectrum);
+
+	return Spectrum;
+}
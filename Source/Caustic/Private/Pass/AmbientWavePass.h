@@ -0,0 +1,107 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "CausticTypes.h"
+#include "HAL/ThreadSafeBool.h"
+#include "HAL/CriticalSection.h"
+#include "Pass/CausticResourcePool.h"
+#include "RHI/Public/RHIResources.h"
+#include "RHI/Public/RHICommandList.h"
+
+/** Settings that change the synthesized field, amplitude is applied per body and not part of the key */
+struct FAmbientWaveSpectrumKey
+{
+	ECausticWaveSpectrum Spectrum;
+	uint32               Resolution;
+	float                PatchSize;
+	float                WindSpeed;
+	float                WindDirection;
+	float                PeakEnhancement;
+	float                UpdateRate;
+	int32                Seed;
+
+	static FAmbientWaveSpectrumKey Create(const FAmbientWaveParam& Param);
+
+	FORCEINLINE bool operator==(const FAmbientWaveSpectrumKey& Other) const
+	{
+		return Spectrum == Other.Spectrum && Resolution == Other.Resolution && PatchSize == Other.PatchSize && WindSpeed == Other.WindSpeed
+			&& WindDirection == Other.WindDirection && PeakEnhancement == Other.PeakEnhancement && UpdateRate == Other.UpdateRate && Seed == Other.Seed;
+	}
+
+	friend FORCEINLINE uint32 GetTypeHash(const FAmbientWaveSpectrumKey& Key)
+	{
+		uint32 Hash = HashCombine(GetTypeHash((uint8)Key.Spectrum), GetTypeHash(Key.Resolution));
+		Hash = HashCombine(Hash, HashCombine(GetTypeHash(Key.PatchSize), GetTypeHash(Key.WindSpeed)));
+		Hash = HashCombine(Hash, HashCombine(GetTypeHash(Key.WindDirection), GetTypeHash(Key.PeakEnhancement)));
+		return HashCombine(Hash, HashCombine(GetTypeHash(Key.UpdateRate), GetTypeHash(Key.Seed)));
+	}
+};
+
+/**
+ * Tileable ambient height field synthesized from an ocean spectrum. The initial spectrum is built on
+ * the CPU once, every update evolves it in time and runs an inverse FFT on the GPU.
+ */
+class FAmbientWaveSpectrum : public TSharedFromThis<FAmbientWaveSpectrum, ESPMode::ThreadSafe>
+{
+
+public:
+
+	FAmbientWaveSpectrum(const FAmbientWaveSpectrumKey& InKey);
+	~FAmbientWaveSpectrum();
+
+	/** GPU bytes of the spectrum textures a field with these settings holds */
+	static uint64 GetMemorySize(const FAmbientWaveParam& Param);
+
+	/** Builds the initial spectrum and enqueues its upload */
+	void InitSpectrum();
+
+	/** Advances the field to the given time. Shared between bodies, so it runs at most once per frame and at the configured rate */
+	void Update_RenderThread(FRHICommandListImmediate& RHICmdList, float Time);
+
+	/** Whether the render thread has uploaded the initial spectrum */
+	FORCEINLINE bool IsReady() const { return bResourcesReady; }
+
+	/** Height in the red channel, sample with a wrapping sampler */
+	FORCEINLINE FShaderResourceViewRHIRef GetHeightTextureSRV() const { return SpectrumPing.SRV; }
+
+private:
+
+	FAmbientWaveSpectrumKey    Key;
+
+	FCausticPooledTexture      InitialSpectrum;
+	FCausticPooledTexture      SpectrumPing;
+	FCausticPooledTexture      SpectrumPong;
+
+	uint32                     LastUpdateFrame;
+	float                      LastUpdateTime;
+
+	class FAmbientWaveSpectrumComputeShader* SpectrumShader;
+	class FAmbientWaveFFTComputeShader*      HorizontalFFTShader;
+	class FAmbientWaveFFTComputeShader*      VerticalFFTShader;
+
+	FThreadSafeBool            bResourcesReady;
+
+private:
+
+	void BuildInitialSpectrum(TArray<FLinearColor>& OutSpectrum) const;
+	void InitSpectrum_RenderThread(FRHICommandListImmediate& RHICmdList, const TArray<FLinearColor>& Spectrum);
+	void ReleaseSpectrumResources();
+};
+
+/** Hands out one spectrum per distinct set of settings, so bodies with the same ambient waves share the synthesis */
+class FAmbientWaveSpectrumCache
+{
+
+public:
+
+	static FAmbientWaveSpectrumCache& Get();
+
+	/** Game thread only */
+	TSharedRef<FAmbientWaveSpectrum, ESPMode::ThreadSafe> FindOrCreate(const FAmbientWaveParam& Param);
+
+private:
+
+	TMap<FAmbientWaveSpectrumKey, TWeakPtr<FAmbientWaveSpectrum, ESPMode::ThreadSafe>> Spectrums;
+};
@@ -0,0 +1,210 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#include "Pass/CausticBlurPass.h"
+#include "RenderCore/Public/GlobalShader.h"
+#include "RenderCore/Public/ShaderParameterUtils.h"
+#include "RenderCore/Public/ShaderParameterMacros.h"
+#include "RenderCore/Public/ShaderPermutation.h"
+
+#include "Public/GlobalShader.h"
+#include "Public/SceneUtils.h"
+#include "Public/ShaderParameterUtils.h"
+#include "RHI/Public/RHICommandList.h"
+#include "Pass/CausticMemory.h"
+
+namespace
+{
+	/** Texels along the blurred line per group, matches CAUSTIC_BLUR_GROUP_SIZE */
+	const uint32 CausticBlurGroupSize = 64;
+
+	/** Largest radius the group shared cache has room for, matches CAUSTIC_BLUR_MAX_RADIUS */
+	const int32 CausticBlurMaxRadius = 8;
+}
+
+BEGIN_GLOBAL_SHADER_PARAMETER_STRUCT(FCausticBlurComputeShaderParameters, )
+	SHADER_PARAMETER(int32, BlurRadius)
+END_GLOBAL_SHADER_PARAMETER_STRUCT()
+IMPLEMENT_GLOBAL_SHADER_PARAMETER_STRUCT(FCausticBlurComputeShaderParameters, "CausticBlurUniform");
+
+class FCausticBlurComputeShader : public FGlobalShader
+{
+	DECLARE_GLOBAL_SHADER(FCausticBlurComputeShader);
+
+public:
+
+	class FBlurVerticalDim : SHADER_PERMUTATION_BOOL("CAUSTIC_BLUR_VERTICAL");
+
+	using FPermutationDomain = TShaderPermutationDomain<FBlurVerticalDim>;
+
+	FCausticBlurComputeShader() {}
+	FCausticBlurComputeShader(const ShaderMetaType::CompiledShaderInitializerType& Initializer)
+		: FGlobalShader(Initializer)
+	{
+		InputCausticTexture.Bind(Initializer.ParameterMap, TEXT("InputCausticTexture"));
+		OutputCausticTexture.Bind(Initializer.ParameterMap, TEXT("OutputCausticTexture"));
+	}
+
+	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
+	{
+		return IsFeatureLevelSupported(Parameters.Platform, ERHIFeatureLevel::SM5);
+	}
+
+	static void ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
+	{
+		FGlobalShader::ModifyCompilationEnvironment(Parameters, OutEnvironment);
+		OutEnvironment.SetDefine(TEXT("CAUSTIC_BLUR_GROUP_SIZE"), CausticBlurGroupSize);
+		OutEnvironment.SetDefine(TEXT("CAUSTIC_BLUR_MAX_RADIUS"), CausticBlurMaxRadius);
+	}
+
+	virtual bool Serialize(FArchive& Ar) override
+	{
+		bool bShaderHasOutdatedParameters = FGlobalShader::Serialize(Ar);
+		Ar << InputCausticTexture << OutputCausticTexture;
+		return bShaderHasOutdatedParameters;
+	}
+
+	void BindShaderTextures(FRHICommandList& RHICmdList, FUnorderedAccessViewRHIRef OutputTextureUAV, FShaderResourceViewRHIRef InputTextureSRV)
+	{
+		FRHIComputeShader* ComputeShaderRHI = GetComputeShader();
+
+		SetUAVParameter(RHICmdList, ComputeShaderRHI, OutputCausticTexture, OutputTextureUAV);
+		SetSRVParameter(RHICmdList, ComputeShaderRHI, InputCausticTexture, InputTextureSRV);
+	}
+
+	void UnbindShaderTextures(FRHICommandList& RHICmdList)
+	{
+		FRHIComputeShader* ComputeShaderRHI = GetComputeShader();
+
+		SetUAVParameter(RHICmdList, ComputeShaderRHI, OutputCausticTexture, FUnorderedAccessViewRHIRef());
+		SetSRVParameter(RHICmdList, ComputeShaderRHI, InputCausticTexture, FShaderResourceViewRHIRef());
+	}
+
+	void SetShaderParameters(FRHICommandList& RHICmdList, const FCausticBlurComputeShaderParameters& Parameters)
+	{
+		FRHIComputeShader* ComputeShaderRHI = GetComputeShader();
+		SetUniformBufferParameterImmediate(RHICmdList, ComputeShaderRHI, GetUniformBufferParameter<FCausticBlurComputeShaderParameters>(), Parameters);
+	}
+
+private:
+
+	FShaderResourceParameter InputCausticTexture;
+	FShaderResourceParameter OutputCausticTexture;
+};
+
+IMPLEMENT_SHADER_TYPE(, FCausticBlurComputeShader, TEXT("/Plugin/Caustic/CausticBlurComputeShader.usf"), TEXT("ComputeBlur"), SF_Compute);
+
+FCausticBlurPassRenderer::FCausticBlurPassRenderer() :
+	HorizontalBlurShader(nullptr),
+	VerticalBlurShader(nullptr),
+	bInitiated(false),
+	bResourcesReady(false)
+{
+
+}
+
+FCausticBlurPassRenderer::~FCausticBlurPassRenderer()
+{
+	ReleasePassResources();
+}
+
+uint64 FCausticBlurPassRenderer::GetMemorySize(const FCausticBlurPassConfig& InConfig)
+{
+	return Caustic::GetTextureMemorySize(InConfig.TextureWidth, InConfig.TextureHeight, PF_FloatRGBA) * 2;
+}
+
+void FCausticBlurPassRenderer::InitPass(const FCausticBlurPassConfig& InConfig)
+{
+	if (!bInitiated)
+	{
+		Config = InConfig;
+		bInitiated = true;
+
+		ENQUEUE_RENDER_COMMAND(CausticBlurPassInitCommand)
+		(
+			[Renderer = AsShared()](FRHICommandListImmediate& RHICmdList)
+			{
+				Renderer->InitPass_RenderThread(RHICmdList);
+			}
+		);
+	}
+}
+
+void FCausticBlurPassRenderer::InitPass_RenderThread(FRHICommandListImmediate& RHICmdList)
+{
+	check(IsInRenderingThread());
+
+	uint32 TextureWidth = Config.TextureWidth;
+	uint32 TextureHeight = Config.TextureHeight;
+
+	FCausticResourcePool& Pool = FCausticResourcePool::Get();
+	BlurScratch = Pool.AcquireTexture(TextureWidth, TextureHeight, PF_FloatRGBA, TexCreate_ShaderResource | TexCreate_UAV);
+	BlurOutput = Pool.AcquireTexture(TextureWidth, TextureHeight, PF_FloatRGBA, TexCreate_ShaderResource | TexCreate_UAV);
+
+	TShaderMap<FGlobalShaderType>* GlobalShaderMap = GetGlobalShaderMap(ERHIFeatureLevel::SM5);
+
+	FCausticBlurComputeShader::FPermutationDomain PermutationVector;
+	PermutationVector.Set<FCausticBlurComputeShader::FBlurVerticalDim>(false);
+	HorizontalBlurShader = *TShaderMapRef<FCausticBlurComputeShader>(GlobalShaderMap, PermutationVector);
+	PermutationVector.Set<FCausticBlurComputeShader::FBlurVerticalDim>(true);
+	VerticalBlurShader = *TShaderMapRef<FCausticBlurComputeShader>(GlobalShaderMap, PermutationVector);
+
+	bResourcesReady = true;
+}
+
+void FCausticBlurPassRenderer::ReleasePass()
+{
+	if (bInitiated)
+	{
+		bInitiated = false;
+		bResourcesReady = false;
+
+		ENQUEUE_RENDER_COMMAND(CausticBlurPassReleaseCommand)
+		(
+			[Renderer = AsShared()](FRHICommandListImmediate& RHICmdList)
+			{
+				Renderer->ReleasePassResources();
+			}
+		);
+	}
+}
+
+void FCausticBlurPassRenderer::ReleasePassResources()
+{
+	FCausticResourcePool& Pool = FCausticResourcePool::Get();
+	Pool.ReleaseTexture(BlurScratch);
+	Pool.ReleaseTexture(BlurOutput);
+}
+
+void FCausticBlurPassRenderer::Render_RenderThread(FRHICommandListImmediate& RHICmdList, const FCausticFrameParams& Params, FShaderResourceViewRHIRef CausticTextureSRV)
+{
+	check(IsInRenderingThread());
+
+	SCOPED_DRAW_EVENT(RHICmdList, CausticBlurPass);
+
+	const uint32 TextureWidth = Config.TextureWidth;
+	const uint32 TextureHeight = Config.TextureHeight;
+
+	FCausticBlurComputeShaderParameters UniformParam;
+	UniformParam.BlurRadius = FMath::Clamp(Params.CausticBlurRadius, 1, CausticBlurMaxRadius);
+
+	// Rows into the scratch texture, each group caches one segment of a row plus its apron
+	RHICmdList.SetComputeShader(HorizontalBlurShader->GetComputeShader());
+	HorizontalBlurShader->BindShaderTextures(RHICmdList, BlurScratch.UAV, CausticTextureSRV);
+	HorizontalBlurShader->SetShaderParameters(RHICmdList, UniformParam);
+	DispatchComputeShader(RHICmdList, HorizontalBlurShader, FMath::DivideAndRoundUp(TextureWidth, CausticBlurGroupSize), TextureHeight, 1);
+	HorizontalBlurShader->UnbindShaderTextures(RHICmdList);
+	RHICmdList.TransitionResource(EResourceTransitionAccess::EReadable, EResourceTransitionPipeline::EComputeToCompute, BlurScratch.UAV);
+
+	// Then columns into the output
+	RHICmdList.SetComputeShader(VerticalBlurShader->GetComputeShader());
+	VerticalBlurShader->BindShaderTextures(RHICmdList, BlurOutput.UAV, BlurScratch.SRV);
+	VerticalBlurShader->SetShaderParameters(RHICmdList, UniformParam);
+	DispatchComputeShader(RHICmdList, VerticalBlurShader, FMath::DivideAndRoundUp(TextureHeight, CausticBlurGroupSize), TextureWidth, 1);
+	VerticalBlurShader->UnbindShaderTextures(RHICmdList);
+	RHICmdList.TransitionResource(EResourceTransitionAccess::EReadable, EResourceTransitionPipeline::EComputeToCompute, BlurOutput.UAV);
+}
+
+bool FCausticBlurPassRenderer::IsValidPass() const
+{
+	return BlurScratch.IsValid() && BlurOutput.IsValid() && HorizontalBlurShader != nullptr && VerticalBlurShader != nullptr;
+}
@@ -0,0 +1,62 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/ObjectMacros.h"
+#include "HAL/ThreadSafeBool.h"
+#include "Pass/CausticResourcePool.h"
+#include "Pass/CausticFrameParams.h"
+#include "RHI/Public/RHIResources.h"
+#include "RHI/Public/RHICommandList.h"
+
+struct FCausticBlurPassConfig
+{
+	uint32                    TextureWidth;
+	uint32                    TextureHeight;
+};
+
+/** Separable gaussian over the caustic texture, one horizontal and one vertical dispatch */
+class FCausticBlurPassRenderer : public TSharedFromThis<FCausticBlurPassRenderer, ESPMode::ThreadSafe>
+{
+
+public:
+
+	FCausticBlurPassRenderer();
+	~FCausticBlurPassRenderer();
+
+	void InitPass(const FCausticBlurPassConfig& InConfig);
+
+	/** GPU bytes InitPass allocates for a config, the budget checks this before a body creates its passes */
+	static uint64 GetMemorySize(const FCausticBlurPassConfig& InConfig);
+
+	/** Blurs the given caustic texture into the output texture, called by the frame graph */
+	void Render_RenderThread(FRHICommandListImmediate& RHICmdList, const FCausticFrameParams& Params, FShaderResourceViewRHIRef CausticTextureSRV);
+
+	bool IsValidPass() const;
+
+	/** Whether the render thread has finished creating the pass resources */
+	FORCEINLINE bool IsReady() const { return bResourcesReady; }
+
+	/** Returns the blur textures to the resource pool */
+	void ReleasePass();
+
+	FORCEINLINE FRHITexture2D* GetOutputTexture() const { return BlurOutput.Texture; }
+
+private:
+
+	FCausticPooledTexture      BlurScratch;
+	FCausticPooledTexture      BlurOutput;
+
+	class FCausticBlurComputeShader* HorizontalBlurShader;
+	class FCausticBlurComputeShader* VerticalBlurShader;
+
+	FCausticBlurPassConfig     Config;
+	bool                       bInitiated;
+	FThreadSafeBool            bResourcesReady;
+
+private:
+
+	void InitPass_RenderThread(FRHICommandListImmediate& RHICmdList);
+	void ReleasePassResources();
+};
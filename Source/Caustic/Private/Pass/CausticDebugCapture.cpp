@@ -0,0 +1,87 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#include "Pass/CausticDebugCapture.h"
+#include "HAL/IConsoleManager.h"
+#include "TextureResource.h"
+
+#if !UE_BUILD_SHIPPING
+
+static uint32 GCausticDebugCaptureSerial = 0;
+static ECausticDebugStage GCausticDebugCaptureStages = ECausticDebugStage::None;
+
+static void RequestCausticDebugCapture(const TArray<FString>& Args)
+{
+	ECausticDebugStage Stages = ECausticDebugStage::None;
+
+	for (const FString& Arg : Args)
+	{
+		if (Arg.Equals(TEXT("Depth"), ESearchCase::IgnoreCase))
+		{
+			Stages |= ECausticDebugStage::Depth;
+		}
+		else if (Arg.Equals(TEXT("Height"), ESearchCase::IgnoreCase))
+		{
+			Stages |= ECausticDebugStage::Height;
+		}
+		else if (Arg.Equals(TEXT("Normal"), ESearchCase::IgnoreCase))
+		{
+			Stages |= ECausticDebugStage::Normal;
+		}
+		else if (Arg.Equals(TEXT("Caustic"), ESearchCase::IgnoreCase))
+		{
+			Stages |= ECausticDebugStage::Caustic;
+		}
+		else if (Arg.Equals(TEXT("All"), ESearchCase::IgnoreCase))
+		{
+			Stages |= ECausticDebugStage::All;
+		}
+	}
+
+	GCausticDebugCaptureStages = (Stages == ECausticDebugStage::None) ? ECausticDebugStage::All : Stages;
+	++GCausticDebugCaptureSerial;
+}
+
+static FAutoConsoleCommand CausticCaptureCommand(
+	TEXT("Caustic.Capture"),
+	TEXT("Snapshots intermediate caustic pass outputs into each body's debug render targets for one frame.\n")
+	TEXT("Usage: Caustic.Capture [Depth] [Height] [Normal] [Caustic] [All]. Captures every stage when no stage is given."),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&RequestCausticDebugCapture)
+);
+
+uint32 Caustic::GetDebugCaptureSerial()
+{
+	return GCausticDebugCaptureSerial;
+}
+
+ECausticDebugStage Caustic::GetDebugCaptureStages()
+{
+	return GCausticDebugCaptureStages;
+}
+
+void FCausticDebugCapture::Capture_RenderThread(FRHICommandListImmediate& RHICmdList, ECausticDebugStage Stage, FRHITexture* SourceTexture) const
+{
+	check(IsInRenderingThread());
+
+	if (!ShouldCapture(Stage) || !SourceTexture)
+	{
+		return;
+	}
+
+	FTextureRenderTargetResource* Target = nullptr;
+
+	switch (Stage)
+	{
+	case ECausticDebugStage::Depth:   Target = DepthTarget;   break;
+	case ECausticDebugStage::Height:  Target = HeightTarget;  break;
+	case ECausticDebugStage::Normal:  Target = NormalTarget;  break;
+	case ECausticDebugStage::Caustic: Target = CausticTarget; break;
+	default: break;
+	}
+
+	if (Target)
+	{
+		RHICmdList.CopyToResolveTarget(SourceTexture, Target->GetRenderTargetTexture(), FResolveParams());
+	}
+}
+
+#endif
@@ -0,0 +1,50 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "RHI/Public/RHIResources.h"
+#include "RHI/Public/RHICommandList.h"
+
+enum class ECausticDebugStage : uint8
+{
+	None    = 0,
+	Depth   = 1 << 0,
+	Height  = 1 << 1,
+	Normal  = 1 << 2,
+	Caustic = 1 << 3,
+	All     = Depth | Height | Normal | Caustic,
+};
+
+ENUM_CLASS_FLAGS(ECausticDebugStage);
+
+#if !UE_BUILD_SHIPPING
+
+/**
+ * One frame snapshot of intermediate pass outputs into the body's debug render targets.
+ * Requested with the Caustic.Capture console command, compiled out of shipping builds.
+ */
+struct FCausticDebugCapture
+{
+	ECausticDebugStage            Stages = ECausticDebugStage::None;
+	FTextureRenderTargetResource* DepthTarget = nullptr;
+	FTextureRenderTargetResource* HeightTarget = nullptr;
+	FTextureRenderTargetResource* NormalTarget = nullptr;
+	FTextureRenderTargetResource* CausticTarget = nullptr;
+
+	FORCEINLINE bool ShouldCapture(ECausticDebugStage Stage) const { return EnumHasAnyFlags(Stages, Stage); }
+
+	/** Copies the stage output into its debug target if that stage was requested */
+	void Capture_RenderThread(FRHICommandListImmediate& RHICmdList, ECausticDebugStage Stage, FRHITexture* SourceTexture) const;
+};
+
+namespace Caustic
+{
+	/** Incremented by every capture request, each body services a given serial once */
+	uint32 GetDebugCaptureSerial();
+
+	/** Stages selected by the latest capture request */
+	ECausticDebugStage GetDebugCaptureStages();
+}
+
+#endif
@@ -0,0 +1,201 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#include "Pass/CausticFlipbookPass.h"
+#include "RenderCore/Public/GlobalShader.h"
+#include "RenderCore/Public/ShaderParameterUtils.h"
+#include "RenderCore/Public/ShaderParameterMacros.h"
+#include "TextureResource.h"
+
+#include "Public/GlobalShader.h"
+#include "Public/SceneUtils.h"
+#include "Public/ShaderParameterUtils.h"
+#include "RHI/Public/RHICommandList.h"
+#include "Pass/CausticMemory.h"
+
+BEGIN_GLOBAL_SHADER_PARAMETER_STRUCT(FCausticFlipbookComputeShaderParameters, )
+	SHADER_PARAMETER(int32, Columns)
+	SHADER_PARAMETER(int32, CurrentFrame)
+	SHADER_PARAMETER(int32, NextFrame)
+	SHADER_PARAMETER(float, FrameBlend)
+END_GLOBAL_SHADER_PARAMETER_STRUCT()
+IMPLEMENT_GLOBAL_SHADER_PARAMETER_STRUCT(FCausticFlipbookComputeShaderParameters, "CausticFlipbookUniform");
+
+class FCausticFlipbookComputeShader : public FGlobalShader
+{
+	DECLARE_GLOBAL_SHADER(FCausticFlipbookComputeShader);
+
+public:
+
+	using FPermutationDomain = TShaderPermutationDomain<Caustic::FThreadGroupShapeDim>;
+
+	FCausticFlipbookComputeShader() {}
+	FCausticFlipbookComputeShader(const ShaderMetaType::CompiledShaderInitializerType& Initializer)
+		: FGlobalShader(Initializer)
+	{
+		FlipbookTexture.Bind(Initializer.ParameterMap, TEXT("FlipbookTexture"));
+		OutputCausticTexture.Bind(Initializer.ParameterMap, TEXT("OutputCausticTexture"));
+	}
+
+	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
+	{
+		return IsFeatureLevelSupported(Parameters.Platform, ERHIFeatureLevel::SM5) && Caustic::ShouldCompileThreadGroupShape<FPermutationDomain>(Parameters.Platform, Parameters.PermutationId);
+	}
+
+	static void ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
+	{
+		FGlobalShader::ModifyCompilationEnvironment(Parameters, OutEnvironment);
+
+		FPermutationDomain PermutationVector(Parameters.PermutationId);
+		Caustic::ModifyThreadGroupCompilationEnvironment((Caustic::EThreadGroupShape)PermutationVector.Get<Caustic::FThreadGroupShapeDim>(), OutEnvironment);
+	}
+
+	virtual bool Serialize(FArchive& Ar) override
+	{
+		bool bShaderHasOutdatedParameters = FGlobalShader::Serialize(Ar);
+		Ar << FlipbookTexture << OutputCausticTexture;
+		return bShaderHasOutdatedParameters;
+	}
+
+	void BindShaderTextures(FRHICommandList& RHICmdList, FUnorderedAccessViewRHIRef OutputTextureUAV, FRHITexture* InputFlipbookTexture)
+	{
+		FRHIComputeShader* ComputeShaderRHI = GetComputeShader();
+
+		SetUAVParameter(RHICmdList, ComputeShaderRHI, OutputCausticTexture, OutputTextureUAV);
+		SetTextureParameter(RHICmdList, ComputeShaderRHI, FlipbookTexture, InputFlipbookTexture);
+	}
+
+	void UnbindShaderTextures(FRHICommandList& RHICmdList)
+	{
+		FRHIComputeShader* ComputeShaderRHI = GetComputeShader();
+
+		SetUAVParameter(RHICmdList, ComputeShaderRHI, OutputCausticTexture, FUnorderedAccessViewRHIRef());
+	}
+
+	void SetShaderParameters(FRHICommandList& RHICmdList, const FCausticFlipbookComputeShaderParameters& Parameters)
+	{
+		FRHIComputeShader* ComputeShaderRHI = GetComputeShader();
+		SetUniformBufferParameterImmediate(RHICmdList, ComputeShaderRHI, GetUniformBufferParameter<FCausticFlipbookComputeShaderParameters>(), Parameters);
+	}
+
+private:
+
+	FShaderResourceParameter FlipbookTexture;
+	FShaderResourceParameter OutputCausticTexture;
+};
+
+IMPLEMENT_SHADER_TYPE(, FCausticFlipbookComputeShader, TEXT("/Plugin/Caustic/CausticFlipbookComputeShader.usf"), TEXT("ComputeFlipbook"), SF_Compute);
+
+FCausticFlipbookPassRenderer::FCausticFlipbookPassRenderer() :
+	FlipbookComputeShader(nullptr),
+	ThreadGroupShape(Caustic::EThreadGroupShape::Group8x8),
+	bInitiated(false),
+	bResourcesReady(false)
+{
+
+}
+
+FCausticFlipbookPassRenderer::~FCausticFlipbookPassRenderer()
+{
+	ReleasePassResources();
+}
+
+uint64 FCausticFlipbookPassRenderer::GetMemorySize(const FCausticFlipbookPassConfig& InConfig)
+{
+	return Caustic::GetTextureMemorySize(InConfig.TextureWidth, InConfig.TextureHeight, PF_FloatRGBA);
+}
+
+void FCausticFlipbookPassRenderer::InitPass(const FCausticFlipbookPassConfig& InConfig)
+{
+	if (!bInitiated)
+	{
+		Config = InConfig;
+		bInitiated = true;
+
+		ENQUEUE_RENDER_COMMAND(CausticFlipbookPassInitCommand)
+		(
+			[Renderer = AsShared()](FRHICommandListImmediate& RHICmdList)
+			{
+				Renderer->InitPass_RenderThread(RHICmdList);
+			}
+		);
+	}
+}
+
+void FCausticFlipbookPassRenderer::InitPass_RenderThread(FRHICommandListImmediate& RHICmdList)
+{
+	check(IsInRenderingThread());
+
+	FlipbookOutput = FCausticResourcePool::Get().AcquireTexture(Config.TextureWidth, Config.TextureHeight, PF_FloatRGBA, TexCreate_ShaderResource | TexCreate_UAV);
+
+	ThreadGroupShape = Caustic::GetThreadGroupShape(GMaxRHIShaderPlatform);
+	TShaderMap<FGlobalShaderType>* GlobalShaderMap = GetGlobalShaderMap(ERHIFeatureLevel::SM5);
+
+	FCausticFlipbookComputeShader::FPermutationDomain PermutationVector;
+	PermutationVector.Set<Caustic::FThreadGroupShapeDim>((int32)ThreadGroupShape);
+	FlipbookComputeShader = *TShaderMapRef<FCausticFlipbookComputeShader>(GlobalShaderMap, PermutationVector);
+
+	bResourcesReady = true;
+}
+
+void FCausticFlipbookPassRenderer::ReleasePass()
+{
+	if (bInitiated)
+	{
+		bInitiated = false;
+		bResourcesReady = false;
+
+		ENQUEUE_RENDER_COMMAND(CausticFlipbookPassReleaseCommand)
+		(
+			[Renderer = AsShared()](FRHICommandListImmediate& RHICmdList)
+			{
+				Renderer->ReleasePassResources();
+			}
+		);
+	}
+}
+
+void FCausticFlipbookPassRenderer::ReleasePassResources()
+{
+	FCausticResourcePool::Get().ReleaseTexture(FlipbookOutput);
+}
+
+void FCausticFlipbookPassRenderer::Render_RenderThread(FRHICommandListImmediate& RHICmdList, const FCausticFlipbookFrame& Frame)
+{
+	check(IsInRenderingThread());
+
+	SCOPED_DRAW_EVENT(RHICmdList, CausticFlipbookPass);
+
+	// Until the atlas has finished building its RHI texture the output is left as it was
+	FRHITexture* FlipbookTextureRHI = Frame.Resource->TextureRHI;
+	if (!FlipbookTextureRHI)
+	{
+		return;
+	}
+
+	const int32 CurrentFrame = FMath::FloorToInt(Frame.Position) % Frame.FrameCount;
+
+	// Bind shader textures
+	RHICmdList.SetComputeShader(FlipbookComputeShader->GetComputeShader());
+	FlipbookComputeShader->BindShaderTextures(RHICmdList, FlipbookOutput.UAV, FlipbookTextureRHI);
+
+	// Bind shader uniform, the last frame blends back into the first since the bake is loopable
+	FCausticFlipbookComputeShaderParameters UniformParam;
+	UniformParam.Columns = FMath::Max(Frame.Columns, 1);
+	UniformParam.CurrentFrame = CurrentFrame;
+	UniformParam.NextFrame = (CurrentFrame + 1) % Frame.FrameCount;
+	UniformParam.FrameBlend = FMath::Frac(Frame.Position);
+	FlipbookComputeShader->SetShaderParameters(RHICmdList, UniformParam);
+
+	// Dispatch shader
+	const FIntVector GroupCount = Caustic::GetGroupCount(Config.TextureWidth, Config.TextureHeight, ThreadGroupShape);
+	DispatchComputeShader(RHICmdList, FlipbookComputeShader, GroupCount.X, GroupCount.Y, GroupCount.Z);
+
+	// Unbind shader textures
+	FlipbookComputeShader->UnbindShaderTextures(RHICmdList);
+	RHICmdList.TransitionResource(EResourceTransitionAccess::EReadable, EResourceTransitionPipeline::EComputeToGfx, FlipbookOutput.UAV);
+}
+
+bool FCausticFlipbookPassRenderer::IsValidPass() const
+{
+	return FlipbookOutput.IsValid() && FlipbookComputeShader != nullptr;
+}
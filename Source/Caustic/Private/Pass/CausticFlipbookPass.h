@@ -0,0 +1,77 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/ObjectMacros.h"
+#include "HAL/ThreadSafeBool.h"
+#include "Pass/CausticResourcePool.h"
+#include "Pass/PassUtils.h"
+#include "RHI/Public/RHIResources.h"
+#include "RHI/Public/RHICommandList.h"
+
+class FTextureResource;
+
+struct FCausticFlipbookPassConfig
+{
+	uint32                    TextureWidth;
+	uint32                    TextureHeight;
+};
+
+/** Playback state of a baked flipbook for one frame, captured on the game thread */
+struct FCausticFlipbookFrame
+{
+	/** Atlas of the baked caustic frames, row major from the top left cell */
+	FTextureResource*         Resource = nullptr;
+	int32                     Columns = 1;
+	int32                     FrameCount = 0;
+
+	/** Fractional frame index, the pass blends the two frames around it */
+	float                     Position = 0.0f;
+
+	FORCEINLINE bool IsValid() const { return Resource != nullptr && FrameCount > 0; }
+};
+
+/** Plays a baked caustic flipbook back into a pooled texture, the replacement for the whole simulation chain */
+class FCausticFlipbookPassRenderer : public TSharedFromThis<FCausticFlipbookPassRenderer, ESPMode::ThreadSafe>
+{
+
+public:
+
+	FCausticFlipbookPassRenderer();
+	~FCausticFlipbookPassRenderer();
+
+	void InitPass(const FCausticFlipbookPassConfig& InConfig);
+
+	/** GPU bytes InitPass allocates for a config, the budget checks this before a body creates its passes */
+	static uint64 GetMemorySize(const FCausticFlipbookPassConfig& InConfig);
+
+	/** Blends the two atlas cells around the playback position into the output texture, called by the frame graph */
+	void Render_RenderThread(FRHICommandListImmediate& RHICmdList, const FCausticFlipbookFrame& Frame);
+
+	bool IsValidPass() const;
+
+	/** Whether the render thread has finished creating the pass resources */
+	FORCEINLINE bool IsReady() const { return bResourcesReady; }
+
+	/** Returns the output texture to the resource pool */
+	void ReleasePass();
+
+	FORCEINLINE FRHITexture2D* GetOutputTexture() const { return FlipbookOutput.Texture; }
+
+private:
+
+	FCausticPooledTexture      FlipbookOutput;
+
+	class FCausticFlipbookComputeShader* FlipbookComputeShader;
+	Caustic::EThreadGroupShape           ThreadGroupShape;
+
+	FCausticFlipbookPassConfig Config;
+	bool                       bInitiated;
+	FThreadSafeBool            bResourcesReady;
+
+private:
+
+	void InitPass_RenderThread(FRHICommandListImmediate& RHICmdList);
+	void ReleasePassResources();
+};
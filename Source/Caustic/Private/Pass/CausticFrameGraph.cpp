@@ -0,0 +1,243 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#include "Pass/CausticFrameGraph.h"
+#include "Pass/CausticStats.h"
+#include "TextureResource.h"
+#include "GenerateMips.h"
+
+DECLARE_CYCLE_STAT(TEXT("Record Frame Graph"), STAT_CausticRecordFrameGraph, STATGROUP_Caustic);
+
+FCausticFrameGraph::FCausticFrameGraph(
+	TSharedRef<FSurfaceDepthPassRenderer, ESPMode::ThreadSafe>    InDepthPass,
+	TSharedRef<FSurfaceNormalPassRenderer, ESPMode::ThreadSafe>   InNormalPass,
+	TSharedRef<FSurfaceCausticPassRenderer, ESPMode::ThreadSafe>  InCausticPass,
+	TSharedRef<FCausticTemporalPassRenderer, ESPMode::ThreadSafe> InTemporalPass,
+	TSharedRef<FCausticBlurPassRenderer, ESPMode::ThreadSafe>     InBlurPass,
+	TSharedRef<FCausticFlipbookPassRenderer, ESPMode::ThreadSafe> InFlipbookPass
+) :
+	DepthPass(InDepthPass),
+	NormalPass(InNormalPass),
+	CausticPass(InCausticPass),
+	TemporalPass(InTemporalPass),
+	BlurPass(InBlurPass),
+	FlipbookPass(InFlipbookPass)
+{
+
+}
+
+bool FCausticFrameGraph::IsReady() const
+{
+	return DepthPass->IsReady() && NormalPass->IsReady() && CausticPass->IsReady() && TemporalPass->IsReady() && BlurPass->IsReady();
+}
+
+void FCausticFrameGraph::Render(FCausticFrameInputs Inputs)
+{
+	if (IsReady() && Inputs.DepthTargetResource)
+	{
+		ENQUEUE_RENDER_COMMAND(CausticFrameGraphCommand)
+		(
+			[Graph = AsShared(), Inputs = MoveTemp(Inputs)](FRHICommandListImmediate& RHICmdList)
+			{
+				Graph->Render_RenderThread(RHICmdList, Inputs);
+			}
+		);
+	}
+}
+
+void FCausticFrameGraph::ReleasePasses()
+{
+	DepthPass->ReleasePass();
+	NormalPass->ReleasePass();
+	CausticPass->ReleasePass();
+	TemporalPass->ReleasePass();
+	BlurPass->ReleasePass();
+	FlipbookPass->ReleasePass();
+}
+
+/** Waits for the stage to finish on the GPU and charges the time since the previous mark to it */
+static void MarkStageTime(FRHICommandListImmediate& RHICmdList, FCausticStageTimings* StageTimings, double& InOutMarkTime, double FCausticStageTimings::* Stage)
+{
+	if (StageTimings)
+	{
+		RHICmdList.BlockUntilGPUIdle();
+
+		const double Now = FPlatformTime::Seconds();
+		StageTimings->*Stage = Now - InOutMarkTime;
+		InOutMarkTime = Now;
+	}
+}
+
+void FCausticFrameGraph::Render_RenderThread(FRHICommandListImmediate& RHICmdList, const FCausticFrameInputs& Inputs)
+{
+	check(IsInRenderingThread());
+
+	SCOPE_CYCLE_COUNTER(STAT_CausticRecordFrameGraph);
+	SCOPED_DRAW_EVENT(RHICmdList, CausticFrameGraph);
+
+	if (!DepthPass->IsValidPass() || !NormalPass->IsValidPass() || !CausticPass->IsValidPass() || !TemporalPass->IsValidPass() || !BlurPass->IsValidPass())
+	{
+		return;
+	}
+
+	// Unless a flipbook plays the height field always advances, the rest of the chain only runs when its output is consumed
+	bool bRenderCaustic = Inputs.CausticTargetResource != nullptr;
+	bool bRenderNormal = bRenderCaustic;
+
+#if !UE_BUILD_SHIPPING
+	const FCausticDebugCapture& DebugCapture = Inputs.DebugCapture;
+	bRenderNormal |= DebugCapture.ShouldCapture(ECausticDebugStage::Normal);
+#endif
+
+	if (Inputs.ObstacleMaskResource)
+	{
+		DepthPass->RenderObstacleMaskPass(RHICmdList, Inputs.ObstacleMaskResource->GetRenderTargetTexture(), Inputs.ObstacleDepth);
+	}
+
+	// A baked body skips the whole chain, the height field is left where the last live frame put it
+	if (Inputs.Flipbook.IsValid() && Inputs.CausticTargetResource && FlipbookPass->IsValidPass())
+	{
+		RenderFlipbook_RenderThread(RHICmdList, Inputs);
+		return;
+	}
+
+	FCausticStageTimings* StageTimings = Inputs.StageTimings.Get();
+	double StageMarkTime = 0.0;
+	if (StageTimings)
+	{
+		*StageTimings = FCausticStageTimings();
+		RHICmdList.BlockUntilGPUIdle();
+		StageMarkTime = FPlatformTime::Seconds();
+	}
+
+	// Without anything overlapping there is no source term, the height field just carries on
+	if (Inputs.DepthProxies.Num() > 0 || Inputs.DepthMeshes.Num() > 0)
+	{
+		// A body that switched to the mesh source after it began play has no mesh targets and only traces its proxies
+		const bool bMeshDepth = Inputs.DepthMeshes.Num() > 0 && DepthPass->HasMeshDepthTargets();
+		if (bMeshDepth)
+		{
+			DepthPass->RenderMeshDepthPass(RHICmdList, Inputs.DepthMeshes, Inputs.BodySize);
+		}
+
+		DepthPass->RenderProxyDepthPass(RHICmdList, Inputs.DepthProxies, Inputs.BodySize, bMeshDepth);
+		DepthPass->RenderSurfaceDepthPass(RHICmdList, Inputs.Params, nullptr);
+	}
+	else if (Inputs.bDepthCaptured)
+	{
+		DepthPass->RenderSurfaceDepthPass(RHICmdList, Inputs.Params, Inputs.DepthTargetResource->GetRenderTargetTexture());
+	}
+	else if (!Inputs.bHasInteractors && DepthPass->HasDisplacement())
+	{
+		DepthPass->RenderEmptyDepthPass(RHICmdList, Inputs.Params);
+	}
+
+	DepthPass->RenderSurfaceImpulsePass(RHICmdList, Inputs.Params, Inputs.Impulses);
+	MarkStageTime(RHICmdList, StageTimings, StageMarkTime, &FCausticStageTimings::DepthSeconds);
+
+#if !UE_BUILD_SHIPPING
+	DebugCapture.Capture_RenderThread(RHICmdList, ECausticDebugStage::Depth, DepthPass->GetDepthTexture());
+#endif
+
+	DepthPass->RenderSurfaceHeightPass(RHICmdList, Inputs.Params);
+	MarkStageTime(RHICmdList, StageTimings, StageMarkTime, &FCausticStageTimings::HeightSeconds);
+
+#if !UE_BUILD_SHIPPING
+	DebugCapture.Capture_RenderThread(RHICmdList, ECausticDebugStage::Height, DepthPass->GetHeightTexture());
+#endif
+
+	if (bRenderNormal)
+	{
+		FShaderResourceViewRHIRef AmbientHeightSRV;
+		if (Inputs.AmbientWaves.IsValid() && Inputs.AmbientWaves->IsReady())
+		{
+			Inputs.AmbientWaves->Update_RenderThread(RHICmdList, Inputs.AmbientTime);
+			AmbientHeightSRV = Inputs.AmbientWaves->GetHeightTextureSRV();
+		}
+
+		FShaderResourceViewRHIRef ObstacleMaskSRV = DepthPass->HasObstacleMask() ? DepthPass->GetObstacleMaskSRV() : FShaderResourceViewRHIRef();
+		NormalPass->Render_RenderThread(RHICmdList, Inputs.Params, DepthPass->GetHeightTextureSRV(), ObstacleMaskSRV, AmbientHeightSRV);
+		MarkStageTime(RHICmdList, StageTimings, StageMarkTime, &FCausticStageTimings::NormalSeconds);
+
+#if !UE_BUILD_SHIPPING
+		DebugCapture.Capture_RenderThread(RHICmdList, ECausticDebugStage::Normal, NormalPass->GetNormalTexture());
+#endif
+	}
+
+	if (bRenderCaustic)
+	{
+		RenderCaustic_RenderThread(RHICmdList, Inputs);
+		MarkStageTime(RHICmdList, StageTimings, StageMarkTime, &FCausticStageTimings::CausticSeconds);
+
+#if !UE_BUILD_SHIPPING
+		DebugCapture.Capture_RenderThread(RHICmdList, ECausticDebugStage::Caustic, Inputs.CausticTargetResource->GetRenderTargetTexture());
+#endif
+	}
+}
+
+void FCausticFrameGraph::RenderCaustic_RenderThread(FRHICommandListImmediate& RHICmdList, const FCausticFrameInputs& Inputs)
+{
+	const FCausticFrameParams& Params = Inputs.Params;
+	FTexture2DRHIRef CausticTarget = Inputs.CausticTargetResource->GetRenderTargetTexture();
+
+	const bool bTemporalFilter = Params.TemporalBlendWeight < 1.0f;
+	const bool bBlur = Params.CausticBlurRadius > 0;
+
+	if (!bTemporalFilter && !bBlur)
+	{
+		// Unfiltered caustics rasterize straight into the output
+		CausticPass->Render_RenderThread(RHICmdList, Params, NormalPass->GetNormalTextureSRV(), DepthPass->GetObstacleMaskSRV(), CausticTarget);
+		TemporalPass->ResetHistory();
+	}
+	else
+	{
+		// Filters chain through pooled textures and the last one is resolved into the output
+		CausticPass->Render_RenderThread(RHICmdList, Params, NormalPass->GetNormalTextureSRV(), DepthPass->GetObstacleMaskSRV(), TemporalPass->GetCausticInputTexture());
+		RHICmdList.TransitionResource(EResourceTransitionAccess::EReadable, TemporalPass->GetCausticInputTexture());
+
+		FRHITexture2D* ResultTexture = TemporalPass->GetCausticInputTexture();
+		FShaderResourceViewRHIRef ResultSRV = TemporalPass->GetCausticInputSRV();
+
+		if (bTemporalFilter)
+		{
+			TemporalPass->Render_RenderThread(RHICmdList, Params);
+			ResultTexture = TemporalPass->GetHistoryTexture();
+			ResultSRV = TemporalPass->GetHistorySRV();
+		}
+		else
+		{
+			TemporalPass->ResetHistory();
+		}
+
+		if (bBlur)
+		{
+			BlurPass->Render_RenderThread(RHICmdList, Params, ResultSRV);
+			ResultTexture = BlurPass->GetOutputTexture();
+		}
+
+		RHICmdList.CopyToResolveTarget(ResultTexture, CausticTarget, FResolveParams());
+	}
+
+	FinishCausticTarget_RenderThread(RHICmdList, CausticTarget);
+}
+
+void FCausticFrameGraph::RenderFlipbook_RenderThread(FRHICommandListImmediate& RHICmdList, const FCausticFrameInputs& Inputs)
+{
+	FTexture2DRHIRef CausticTarget = Inputs.CausticTargetResource->GetRenderTargetTexture();
+
+	FlipbookPass->Render_RenderThread(RHICmdList, Inputs.Flipbook);
+	RHICmdList.CopyToResolveTarget(FlipbookPass->GetOutputTexture(), CausticTarget, FResolveParams());
+
+	// The history would blend stale live frames into the first frames after the switch back
+	TemporalPass->ResetHistory();
+
+	FinishCausticTarget_RenderThread(RHICmdList, CausticTarget);
+}
+
+void FCausticFrameGraph::FinishCausticTarget_RenderThread(FRHICommandListImmediate& RHICmdList, FRHITexture2D* CausticTarget)
+{
+	// Distant receivers sample the lower mips, only targets created with a mip chain get one
+	if (CausticTarget->GetNumMips() > 1)
+	{
+		FGenerateMips::Execute(RHICmdList, CausticTarget);
+	}
+}
@@ -0,0 +1,121 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Pass/CausticFrameParams.h"
+#include "Pass/CausticDebugCapture.h"
+#include "Pass/SurfaceDepthPass.h"
+#include "Pass/SurfaceNormalPass.h"
+#include "Pass/SurfaceCausticPass.h"
+#include "Pass/CausticTemporalPass.h"
+#include "Pass/CausticBlurPass.h"
+#include "Pass/CausticFlipbookPass.h"
+#include "Pass/AmbientWavePass.h"
+
+/** GPU time of each stage of a frame, the GPU is drained between the stages while they are timed */
+struct FCausticStageTimings
+{
+	double DepthSeconds = 0.0;
+	double HeightSeconds = 0.0;
+	double NormalSeconds = 0.0;
+	double CausticSeconds = 0.0;
+};
+
+/** Everything one frame of a body needs, captured on the game thread */
+struct FCausticFrameInputs
+{
+	FCausticFrameParams           Params;
+	FTextureRenderTargetResource* DepthTargetResource = nullptr;
+
+	/** Whether the depth capture ran for this frame, a stale capture is never read */
+	bool                          bDepthCaptured = false;
+
+	/** Whether anything overlaps the body, the displaced volume is only given back once nothing does */
+	bool                          bHasInteractors = false;
+
+	/** Collision shapes traced instead of the capture, in body space with the surface at Z 0 */
+	TArray<FSurfaceDepthProxy>    DepthProxies;
+
+	/** Static meshes drawn instead of the capture, the proxies are traced on top of them */
+	TArray<FSurfaceDepthMesh>     DepthMeshes;
+
+	/** World extent of the body the depth texture covers */
+	FVector2D                     BodySize = FVector2D::ZeroVector;
+
+	/** Production caustic output, the caustic stage is skipped when nobody samples it */
+	FTextureRenderTargetResource* CausticTargetResource = nullptr;
+
+	/** Scene depth captured for the obstacle mask, only set on the frame after a bake */
+	FTextureRenderTargetResource* ObstacleMaskResource = nullptr;
+
+	/** Captured depth at or below which a texel is solid */
+	float                         ObstacleDepth = 0.0f;
+
+	/** Impulses queued on the body since the last step, splatted after the depth pass */
+	TArray<FSurfaceImpulse>       Impulses;
+
+	/** Shared ambient field summed into the normals, null when the body has none */
+	TSharedPtr<FAmbientWaveSpectrum, ESPMode::ThreadSafe> AmbientWaves;
+	float                         AmbientTime = 0.0f;
+
+	/** Baked playback that replaces the simulation this frame, invalid while the body simulates */
+	FCausticFlipbookFrame         Flipbook;
+
+	/** Filled on the render thread when set, serializes the frame so only profiling should ask for it */
+	TSharedPtr<FCausticStageTimings, ESPMode::ThreadSafe> StageTimings;
+
+#if !UE_BUILD_SHIPPING
+	FCausticDebugCapture          DebugCapture;
+#endif
+};
+
+/**
+ * Records every pass of a body into a single render command per frame, and skips the stages
+ * whose output nobody consumes.
+ */
+class FCausticFrameGraph : public TSharedFromThis<FCausticFrameGraph, ESPMode::ThreadSafe>
+{
+
+public:
+
+	FCausticFrameGraph(
+		TSharedRef<FSurfaceDepthPassRenderer, ESPMode::ThreadSafe>    InDepthPass,
+		TSharedRef<FSurfaceNormalPassRenderer, ESPMode::ThreadSafe>   InNormalPass,
+		TSharedRef<FSurfaceCausticPassRenderer, ESPMode::ThreadSafe>  InCausticPass,
+		TSharedRef<FCausticTemporalPassRenderer, ESPMode::ThreadSafe> InTemporalPass,
+		TSharedRef<FCausticBlurPassRenderer, ESPMode::ThreadSafe>     InBlurPass,
+		TSharedRef<FCausticFlipbookPassRenderer, ESPMode::ThreadSafe> InFlipbookPass
+	);
+
+	/** Whether every simulation pass has finished its deferred initialization, the flipbook pass is optional */
+	bool IsReady() const;
+
+	/** Enqueues the frame as one render command */
+	void Render(FCausticFrameInputs Inputs);
+
+	/** Returns the pass resources to the resource pool */
+	void ReleasePasses();
+
+private:
+
+	void Render_RenderThread(FRHICommandListImmediate& RHICmdList, const FCausticFrameInputs& Inputs);
+
+	/** Rasterizes the caustics and runs the filters the frame asks for, ending in the output target */
+	void RenderCaustic_RenderThread(FRHICommandListImmediate& RHICmdList, const FCausticFrameInputs& Inputs);
+
+	/** Plays the baked flipbook into the output target, nothing else runs */
+	void RenderFlipbook_RenderThread(FRHICommandListImmediate& RHICmdList, const FCausticFrameInputs& Inputs);
+
+	/** Builds the mip chain of targets that have one */
+	void FinishCausticTarget_RenderThread(FRHICommandListImmediate& RHICmdList, FRHITexture2D* CausticTarget);
+
+private:
+
+	TSharedRef<FSurfaceDepthPassRenderer, ESPMode::ThreadSafe>    DepthPass;
+	TSharedRef<FSurfaceNormalPassRenderer, ESPMode::ThreadSafe>   NormalPass;
+	TSharedRef<FSurfaceCausticPassRenderer, ESPMode::ThreadSafe>  CausticPass;
+	TSharedRef<FCausticTemporalPassRenderer, ESPMode::ThreadSafe> TemporalPass;
+	TSharedRef<FCausticBlurPassRenderer, ESPMode::ThreadSafe>     BlurPass;
+	TSharedRef<FCausticFlipbookPassRenderer, ESPMode::ThreadSafe> FlipbookPass;
+};
@@ -0,0 +1,96 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#include "Pass/CausticFrameParams.h"
+#include "Caustic.h"
+
+FCausticFrameParams FCausticFrameParams::Create(const FLiquidParam& LiquidParam, const FCausticSolverCoefficients& SolverCoefficients)
+{
+	check(IsInGameThread());
+
+	FCausticFrameParams Params;
+	Params.HeightParam = SolverCoefficients.HeightParam;
+	Params.Solver = LiquidParam.Solver;
+	Params.SolverIterations = (LiquidParam.Solver == ECausticSolver::SemiImplicit) ? FMath::Clamp(LiquidParam.JacobiIterations, 1, 16) : 1;
+	Params.AttenuationCoefficient = LiquidParam.AttenuationCoefficient;
+	Params.ForceFactor = LiquidParam.ForceFactor;
+	Params.Refraction = LiquidParam.Refraction;
+	Params.Dispersion = FMath::Clamp(LiquidParam.Dispersion, 0.0f, 0.5f);
+	Params.Projection = LiquidParam.Projection;
+	Params.IndexOfRefraction = FMath::Clamp(LiquidParam.IndexOfRefraction, 1.0f, 3.0f);
+	Params.BoundaryMode = LiquidParam.BoundaryMode;
+	Params.SpongeWidth = FMath::Max(LiquidParam.SpongeWidth, 1);
+	Params.SpongeStrength = FMath::Clamp(LiquidParam.SpongeStrength, 0.0f, 1.0f);
+
+	return Params;
+}
+
+bool FCausticSolverCoefficients::IsStable() const
+{
+	// A velocity on the clamp lands exactly on the bound, leave room for rounding
+	return Caustic::SimulationStepTime <= MaxStableStep * (1.0f + KINDA_SMALL_NUMBER);
+}
+
+namespace
+{
+	/** The body defaults at the fixed step, a flat surface must stay flat for every solver */
+	constexpr FCausticSolverTerms FivePointDefaults = Caustic::ComputeSolverTerms(ECausticSolver::FivePoint, 0.5426512f, 0.15f, Caustic::SimulationStepTime);
+	constexpr FCausticSolverTerms NinePointDefaults = Caustic::ComputeSolverTerms(ECausticSolver::NinePoint, 0.5426512f, 0.15f, Caustic::SimulationStepTime);
+	constexpr FCausticSolverTerms SemiImplicitDefaults = Caustic::ComputeSolverTerms(ECausticSolver::SemiImplicit, 0.5426512f, 0.15f, Caustic::SimulationStepTime);
+
+	static_assert(Caustic::GetFlatSurfaceGain(FivePointDefaults) > 0.9999f && Caustic::GetFlatSurfaceGain(FivePointDefaults) < 1.0001f, "Five point stencil weights must sum to one");
+	static_assert(Caustic::GetFlatSurfaceGain(NinePointDefaults) > 0.9999f && Caustic::GetFlatSurfaceGain(NinePointDefaults) < 1.0001f, "Nine point stencil weights must sum to one");
+	static_assert(Caustic::GetFlatSurfaceGain(SemiImplicitDefaults) > 0.9999f && Caustic::GetFlatSurfaceGain(SemiImplicitDefaults) < 1.0001f, "Semi implicit stencil weights must sum to one");
+}
+
+// Reference: https://github.com/AsehesL/UnityWaveEquation
+FCausticSolverCoefficients Caustic::ComputeSolverCoefficients(const FLiquidParam& LiquidParam)
+{
+	const float SampleSpacing = 1.0f / LiquidParam.DepthTextureWidth;
+	const float FixedDeltaTime = Caustic::SimulationStepTime;
+	const ECausticSolver Solver = LiquidParam.Solver;
+
+	// Largest Laplacian eigenvalue of the stencil times h^2, 8 for five points and 16/3 for nine points
+	const float StencilEigenvalue = (Solver == ECausticSolver::NinePoint) ? 16.0f / 3.0f : 8.0f;
+
+	// Velocity is normalized to the five point bound, the stencil is clamped to what the solver stays stable at
+	const float RequestedScale = FMath::Abs(LiquidParam.Velocity);
+	const float VelocityScale = FMath::Min(RequestedScale, GetMaxVelocityScale(Solver));
+
+	// The bound is taken at the requested velocity, so settings past it are reported rather than hidden by the clamp
+	const float Viscosity = FMath::Abs(LiquidParam.Viscosity);
+	const float MaxVelocity = SampleSpacing / (2 * FixedDeltaTime) * FMath::Sqrt(Viscosity * FixedDeltaTime + 2);
+	const float Velocity = RequestedScale * MaxVelocity;
+	const float ViscositySqr = Viscosity * Viscosity;
+	const float VelocitySqr = Velocity * Velocity;
+	const float DeltaSizeSqr = SampleSpacing * SampleSpacing;
+	const float DeltaT = FMath::Sqrt(ViscositySqr + 4 * StencilEigenvalue * VelocitySqr / DeltaSizeSqr);
+	const float DeltaTDensity = StencilEigenvalue * VelocitySqr / DeltaSizeSqr;
+	const float MaxT1 = (Viscosity + DeltaT) / DeltaTDensity;
+	const float MaxT2 = (Viscosity - DeltaT) / DeltaTDensity;
+
+	const FCausticSolverTerms Terms = ComputeSolverTerms(Solver, LiquidParam.Velocity, LiquidParam.Viscosity, FixedDeltaTime);
+
+	FCausticSolverCoefficients Coefficients;
+	Coefficients.HeightParam = FVector4(Terms.K1, Terms.K2, Terms.K3, SampleSpacing);
+	Coefficients.Velocity = VelocityScale;
+
+	// The implicit Laplacian is unconditionally stable, the bound only applies to the explicit stencils
+	Coefficients.MaxStableStep = (Solver == ECausticSolver::SemiImplicit) ? MAX_flt : (MaxT2 > 0) ? FMath::Min(MaxT1, MaxT2) : MaxT1;
+
+	return Coefficients;
+}
+
+void Caustic::WarnSolverClamp(const FLiquidParam& LiquidParam, const FCausticSolverCoefficients& Coefficients, const FString& OwnerName)
+{
+	const FString SolverName = StaticEnum<ECausticSolver>()->GetNameStringByValue((int64)LiquidParam.Solver);
+
+	if (!Coefficients.IsStable())
+	{
+		UE_LOG(LogCaustic, Warning, TEXT("%s: Velocity %.3f keeps the %s solver stable only up to a %.4f s step, the simulation steps %.4f s. Clamped to %.3f"),
+			*OwnerName, LiquidParam.Velocity, *SolverName, Coefficients.MaxStableStep, Caustic::SimulationStepTime, Coefficients.Velocity);
+	}
+	else if (FMath::Abs(LiquidParam.Velocity) > Coefficients.Velocity)
+	{
+		UE_LOG(LogCaustic, Warning, TEXT("%s: Velocity %.3f is past the range of the %s solver, clamped to %.3f"), *OwnerName, LiquidParam.Velocity, *SolverName, Coefficients.Velocity);
+	}
+}
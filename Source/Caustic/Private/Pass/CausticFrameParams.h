@@ -0,0 +1,131 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "CausticTypes.h"
+
+/** K1, K2 and K3 of the height stencil */
+struct FCausticSolverTerms
+{
+	float K1;
+	float K2;
+	float K3;
+};
+
+/** Solver coefficients of one set of wave settings, computed when the settings change and cached by their owner */
+struct FCausticSolverCoefficients
+{
+	/** K1, K2, K3 and the sample spacing, as the height shader reads them */
+	FVector4 HeightParam;
+
+	/** Velocity after the clamp to the stable range of the solver, as a fraction of the five point bound */
+	float    Velocity;
+
+	/** Largest step the explicit update stays stable at with the requested velocity, before the clamp */
+	float    MaxStableStep;
+
+	/** Whether the requested velocity is stable at the fixed step, when it is not Velocity has been clamped */
+	bool IsStable() const;
+};
+
+/**
+ * Immutable snapshot of everything the passes read from FLiquidParam during one frame.
+ * Built on the game thread and moved into the render command, so the render thread never
+ * touches the live UPROPERTY.
+ */
+struct FCausticFrameParams
+{
+	/** Wave equation coefficients K1, K2, K3 of the selected solver and the sample spacing */
+	FVector4 HeightParam;
+
+	ECausticSolver Solver;
+
+	/** Number of height dispatches per step, more than one only for the semi implicit solver */
+	int32    SolverIterations;
+
+	float    AttenuationCoefficient;
+	float    ForceFactor;
+
+	/** Whether interactors push by their penetration or by the change in displaced volume, set by the body. Defaults to the body default */
+	ECausticInteractionForce InteractionForce = ECausticInteractionForce::DisplacedVolume;
+	float    Refraction;
+	float    Dispersion;
+
+	ECausticProjection Projection;
+	float    IndexOfRefraction;
+
+	/** Direction the light travels in, in body space, set by the body */
+	FVector  LightDirection = FVector(0.0f, 0.0f, -1.0f);
+
+	ECausticBoundaryMode BoundaryMode;
+
+	/** Absorbing layer width in texels and damping at the edge */
+	float    SpongeWidth;
+	float    SpongeStrength;
+
+	/** Ambient wave patches across the body and their height scale, set by the body */
+	FVector2D AmbientTiling = FVector2D::UnitVector;
+	float     AmbientAmplitude = 0.0f;
+
+	/** Weight of the current frame in the caustic history, 1 disables the temporal filter */
+	float     TemporalBlendWeight = 1.0f;
+
+	/** Gaussian radius in caustic texels, 0 skips the blur */
+	int32     CausticBlurRadius = 0;
+
+	static FCausticFrameParams Create(const FLiquidParam& LiquidParam, const FCausticSolverCoefficients& SolverCoefficients);
+};
+
+namespace Caustic
+{
+	/** Time advanced by one solver step, the simulation takes exactly one per rendered frame */
+	constexpr float SimulationStepTime = 0.016f;
+
+	/** Fraction of the five point velocity bound a solver is used up to, sqrt(8 / (16 / 3)) for nine points */
+	constexpr float GetMaxVelocityScale(ECausticSolver Solver)
+	{
+		return (Solver == ECausticSolver::NinePoint) ? 1.2247449f : (Solver == ECausticSolver::SemiImplicit) ? 4.0f : 1.0f;
+	}
+
+	/**
+	 * Stencil weights for a velocity given as a fraction of the five point bound. With the velocity normalized
+	 * the grid spacing cancels out, Factor = Velocity^2 * (Viscosity * DeltaTime + 2) / 4, so fixed presets
+	 * are evaluated by the compiler.
+	 */
+	constexpr FCausticSolverTerms ComputeSolverTerms(ECausticSolver Solver, float Velocity, float Viscosity, float DeltaTime)
+	{
+		const float AbsVelocity = (Velocity < 0.0f) ? -Velocity : Velocity;
+		const float AbsViscosity = (Viscosity < 0.0f) ? -Viscosity : Viscosity;
+		const float MaxVelocityScale = GetMaxVelocityScale(Solver);
+		const float VelocityScale = (AbsVelocity < MaxVelocityScale) ? AbsVelocity : MaxVelocityScale;
+
+		const float I = AbsViscosity * DeltaTime - 2;
+		const float J = AbsViscosity * DeltaTime + 2;
+		const float Factor = VelocityScale * VelocityScale * J / 4;
+
+		switch (Solver)
+		{
+		case ECausticSolver::NinePoint:
+			// Neighbour sum is (4 * edges + corners) / 5, the Laplacian is 5/6 * (sum - 4 * center)
+			return { (4 - 20 * Factor / 3) / J, I / J, 5 * Factor / (3 * J) };
+		case ECausticSolver::SemiImplicit:
+			// Laplacian taken at the new step, z = (4z + I * zprev + 2F * neighbours) / (J + 8F) relaxed by Jacobi
+			return { 4 / (J + 8 * Factor), I / (J + 8 * Factor), 2 * Factor / (J + 8 * Factor) };
+		default:
+			return { (4 - 8 * Factor) / J, I / J, 2 * Factor / J };
+		}
+	}
+
+	/** Height a flat surface keeps after one step, anything but 1 makes a resting body drift */
+	constexpr float GetFlatSurfaceGain(const FCausticSolverTerms& Terms)
+	{
+		return Terms.K1 + Terms.K2 + 4 * Terms.K3;
+	}
+
+	/** Full derivation including the stability bound, owners cache the result until their LiquidParam changes */
+	FCausticSolverCoefficients ComputeSolverCoefficients(const FLiquidParam& LiquidParam);
+
+	/** Warns when the requested velocity is unstable or past the range of the solver, before the clamp hides it */
+	void WarnSolverClamp(const FLiquidParam& LiquidParam, const FCausticSolverCoefficients& Coefficients, const FString& OwnerName);
+}
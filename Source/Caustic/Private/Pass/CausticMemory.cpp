@@ -0,0 +1,79 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#include "Pass/CausticMemory.h"
+#include "HAL/IConsoleManager.h"
+#include "RenderUtils.h"
+
+DEFINE_STAT(STAT_CausticTextureMemory);
+DEFINE_STAT(STAT_CausticFreeTextureMemory);
+DEFINE_STAT(STAT_CausticGeometryMemory);
+DEFINE_STAT(STAT_CausticBufferMemory);
+DEFINE_STAT(STAT_CausticReservedMemory);
+DEFINE_STAT(STAT_CausticBodies);
+DEFINE_STAT(STAT_CausticSleepingBodies);
+DEFINE_STAT(STAT_CausticRefusedBodies);
+
+static TAutoConsoleVariable<int32> CVarCausticMemoryBudgetMB(
+	TEXT("r.Caustic.MemoryBudgetMB"),
+	0,
+	TEXT("GPU memory all caustic bodies together may reserve, in megabytes.\n")
+	TEXT("Bodies past the budget lower their caustic resolution, or are not simulated if that is not enough.\n")
+	TEXT("0 disables the budget."),
+	ECVF_Default
+);
+
+#if ENABLE_LOW_LEVEL_MEM_TRACKER
+DECLARE_LLM_MEMORY_STAT(TEXT("Caustic"), STAT_CausticLLM, STATGROUP_LLMFULL);
+DECLARE_LLM_MEMORY_STAT(TEXT("Caustic"), STAT_CausticSummaryLLM, STATGROUP_LLM);
+
+void Caustic::RegisterLLMTag()
+{
+	FLowLevelMemTracker::Get().RegisterProjectTag((int32)LLMTag, TEXT("Caustic"), GET_STATFNAME(STAT_CausticLLM), GET_STATFNAME(STAT_CausticSummaryLLM));
+}
+#endif
+
+uint64 Caustic::GetTextureMemorySize(uint32 Width, uint32 Height, EPixelFormat Format, uint32 NumMips)
+{
+	return CalcTextureSize(Width, Height, Format, NumMips);
+}
+
+FCausticMemoryBudget& FCausticMemoryBudget::Get()
+{
+	static FCausticMemoryBudget Budget;
+	return Budget;
+}
+
+uint64 FCausticMemoryBudget::GetBudgetBytes()
+{
+	return (uint64)FMath::Max(CVarCausticMemoryBudgetMB.GetValueOnGameThread(), 0) * 1024 * 1024;
+}
+
+bool FCausticMemoryBudget::CanReserve(uint64 Bytes) const
+{
+	const uint64 BudgetBytes = GetBudgetBytes();
+	return BudgetBytes == 0 || ReservedBytes + Bytes <= BudgetBytes;
+}
+
+bool FCausticMemoryBudget::TryReserve(uint64 Bytes)
+{
+	check(IsInGameThread());
+
+	if (!CanReserve(Bytes))
+	{
+		return false;
+	}
+
+	ReservedBytes += Bytes;
+	INC_MEMORY_STAT_BY(STAT_CausticReservedMemory, Bytes);
+
+	return true;
+}
+
+void FCausticMemoryBudget::Release(uint64 Bytes)
+{
+	check(IsInGameThread());
+	check(ReservedBytes >= Bytes);
+
+	ReservedBytes -= Bytes;
+	DEC_MEMORY_STAT_BY(STAT_CausticReservedMemory, Bytes);
+}
@@ -0,0 +1,74 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/LowLevelMemTracker.h"
+#include "Pass/CausticStats.h"
+
+/**
+ * Slot of the plugin's tag in the project LLM range. Games usually number their tags up from ProjectTagStart,
+ * so the default sits well past the first ones. A project whose own tags reach it moves the plugin elsewhere
+ * with PublicDefinitions.Add("CAUSTIC_LLM_TAG_OFFSET=<n>") in its target rules.
+ */
+#ifndef CAUSTIC_LLM_TAG_OFFSET
+#define CAUSTIC_LLM_TAG_OFFSET 24
+#endif
+
+#if ENABLE_LOW_LEVEL_MEM_TRACKER
+namespace Caustic
+{
+	/**
+	 * Project LLM tag of the plugin. LLM only tracks CPU allocations made inside the scope, like RHI resource
+	 * objects, uploads and readbacks. The VRAM behind the textures and buffers is reported by stat Caustic instead.
+	 */
+	const ELLMTag LLMTag = (ELLMTag)((int32)ELLMTag::ProjectTagStart + CAUSTIC_LLM_TAG_OFFSET);
+	static_assert((int32)ELLMTag::ProjectTagStart + CAUSTIC_LLM_TAG_OFFSET <= (int32)ELLMTag::ProjectTagEnd, "CAUSTIC_LLM_TAG_OFFSET is past the project LLM tag range");
+
+	/** Called once by the module */
+	void RegisterLLMTag();
+}
+
+#define CAUSTIC_LLM_SCOPE() LLM_SCOPE(Caustic::LLMTag)
+#else
+#define CAUSTIC_LLM_SCOPE()
+#endif
+
+namespace Caustic
+{
+	/** Bytes of a 2D texture with its first NumMips mips */
+	uint64 GetTextureMemorySize(uint32 Width, uint32 Height, EPixelFormat Format, uint32 NumMips = 1);
+}
+
+/**
+ * Game thread bookkeeping of the GPU memory bodies reserve before creating their passes, checked
+ * against r.Caustic.MemoryBudgetMB. A body that does not fit is downgraded or not simulated.
+ */
+class FCausticMemoryBudget
+{
+
+public:
+
+	static FCausticMemoryBudget& Get();
+
+	/** Budget in bytes, 0 when unlimited */
+	static uint64 GetBudgetBytes();
+
+	/** Whether Bytes more still fit, always true without a budget */
+	bool CanReserve(uint64 Bytes) const;
+
+	/** Reserves Bytes if they fit */
+	bool TryReserve(uint64 Bytes);
+
+	void Release(uint64 Bytes);
+
+	FORCEINLINE uint64 GetReservedBytes() const { return ReservedBytes; }
+
+private:
+
+	FCausticMemoryBudget() : ReservedBytes(0) {}
+
+private:
+
+	uint64 ReservedBytes;
+};
@@ -0,0 +1,171 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#include "Pass/CausticResourcePool.h"
+#include "Pass/CausticMemory.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/ScopeLock.h"
+
+static TAutoConsoleVariable<int32> CVarCausticPoolRetentionSize(
+	TEXT("r.Caustic.PoolRetentionSize"),
+	4,
+	TEXT("Number of free caustic textures and refraction grids kept alive per size and format.\n")
+	TEXT("0 disables pooling."),
+	ECVF_RenderThreadSafe
+);
+
+FCausticResourcePool& FCausticResourcePool::Get()
+{
+	static FCausticResourcePool Pool;
+	return Pool;
+}
+
+FCausticPooledTexture FCausticResourcePool::AcquireTexture(uint32 Width, uint32 Height, EPixelFormat Format, uint32 Flags)
+{
+	check(IsInRenderingThread());
+
+	const FCausticTextureKey Key = { Width, Height, Format, Flags };
+
+	{
+		FScopeLock Lock(&PoolLock);
+
+		TArray<FCausticPooledTexture>* FreeList = FreeTextures.Find(Key);
+		if (FreeList && FreeList->Num() > 0)
+		{
+			FCausticPooledTexture Result = FreeList->Pop(false);
+			DEC_MEMORY_STAT_BY(STAT_CausticFreeTextureMemory, GetMemorySize(Result));
+			return Result;
+		}
+	}
+
+	CAUSTIC_LLM_SCOPE();
+
+	FRHIResourceCreateInfo CreateInfo;
+	FCausticPooledTexture Result;
+	Result.Texture = RHICreateTexture2D(Width, Height, Format, 1, 1, Flags, CreateInfo);
+
+	if (Flags & TexCreate_UAV)
+	{
+		Result.UAV = RHICreateUnorderedAccessView(Result.Texture);
+	}
+
+	if (Flags & TexCreate_ShaderResource)
+	{
+		Result.SRV = RHICreateShaderResourceView(Result.Texture, 0);
+	}
+
+	INC_MEMORY_STAT_BY(STAT_CausticTextureMemory, GetMemorySize(Result));
+
+	return Result;
+}
+
+void FCausticResourcePool::ReleaseTexture(FCausticPooledTexture& Texture)
+{
+	if (Texture.IsValid())
+	{
+		const FCausticTextureKey Key = { Texture.Texture->GetSizeX(), Texture.Texture->GetSizeY(), Texture.Texture->GetFormat(), Texture.Texture->GetFlags() };
+
+		INC_MEMORY_STAT_BY(STAT_CausticFreeTextureMemory, GetMemorySize(Texture));
+
+		FScopeLock Lock(&PoolLock);
+		FreeTextures.FindOrAdd(Key).Add(MoveTemp(Texture));
+		TrimFreeList(FreeTextures, Key);
+	}
+
+	Texture = FCausticPooledTexture();
+}
+
+bool FCausticResourcePool::AcquireGeometry(const FCausticGeometryKey& Key, FCausticPooledGeometry& OutGeometry)
+{
+	FScopeLock Lock(&PoolLock);
+
+	TArray<FCausticPooledGeometry>* FreeList = FreeGeometries.Find(Key);
+	if (FreeList && FreeList->Num() > 0)
+	{
+		OutGeometry = FreeList->Pop(false);
+		return true;
+	}
+
+	return false;
+}
+
+void FCausticResourcePool::ReleaseGeometry(const FCausticGeometryKey& Key, FCausticPooledGeometry& Geometry)
+{
+	if (Geometry.IsValid())
+	{
+		FScopeLock Lock(&PoolLock);
+		FreeGeometries.FindOrAdd(Key).Add(MoveTemp(Geometry));
+		TrimFreeList(FreeGeometries, Key);
+	}
+
+	Geometry = FCausticPooledGeometry();
+}
+
+void FCausticResourcePool::Empty()
+{
+	FScopeLock Lock(&PoolLock);
+
+	for (TPair<FCausticTextureKey, TArray<FCausticPooledTexture>>& FreeList : FreeTextures)
+	{
+		for (const FCausticPooledTexture& Texture : FreeList.Value)
+		{
+			TrackDestroyed(Texture);
+		}
+	}
+
+	for (TPair<FCausticGeometryKey, TArray<FCausticPooledGeometry>>& FreeList : FreeGeometries)
+	{
+		for (const FCausticPooledGeometry& Geometry : FreeList.Value)
+		{
+			TrackDestroyed(Geometry);
+		}
+	}
+
+	FreeTextures.Empty();
+	FreeGeometries.Empty();
+}
+
+uint64 FCausticResourcePool::GetMemorySize(const FCausticPooledTexture& Texture)
+{
+	return Caustic::GetTextureMemorySize(Texture.Texture->GetSizeX(), Texture.Texture->GetSizeY(), Texture.Texture->GetFormat());
+}
+
+uint64 FCausticResourcePool::GetMemorySize(const FCausticPooledGeometry& Geometry)
+{
+	return (uint64)Geometry.VertexBuffer->GetSize() + Geometry.IndexBuffer->GetSize();
+}
+
+void FCausticResourcePool::TrackDestroyed(const FCausticPooledTexture& Texture)
+{
+	const uint64 Size = GetMemorySize(Texture);
+	DEC_MEMORY_STAT_BY(STAT_CausticFreeTextureMemory, Size);
+	DEC_MEMORY_STAT_BY(STAT_CausticTextureMemory, Size);
+}
+
+void FCausticResourcePool::TrackDestroyed(const FCausticPooledGeometry& Geometry)
+{
+	DEC_MEMORY_STAT_BY(STAT_CausticGeometryMemory, GetMemorySize(Geometry));
+}
+
+template <typename KeyType, typename ValueType>
+void FCausticResourcePool::TrimFreeList(TMap<KeyType, TArray<ValueType>>& FreeLists, const KeyType& Key)
+{
+	const int32 RetentionSize = FMath::Max(0, CVarCausticPoolRetentionSize.GetValueOnAnyThread());
+
+	TArray<ValueType>& FreeList = FreeLists.FindChecked(Key);
+	if (FreeList.Num() > RetentionSize)
+	{
+		// Oldest entries go first, dropping the last reference frees the RHI resource
+		const int32 TrimCount = FreeList.Num() - RetentionSize;
+		for (int32 Index = 0; Index < TrimCount; ++Index)
+		{
+			TrackDestroyed(FreeList[Index]);
+		}
+
+		FreeList.RemoveAt(0, TrimCount);
+	}
+
+	if (FreeList.Num() == 0)
+	{
+		FreeLists.Remove(Key);
+	}
+}
@@ -0,0 +1,112 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/CriticalSection.h"
+#include "RHI/Public/RHIResources.h"
+#include "RHI/Public/RHICommandList.h"
+
+struct FCausticPooledTexture
+{
+	FTexture2DRHIRef           Texture;
+	FUnorderedAccessViewRHIRef UAV;
+	FShaderResourceViewRHIRef  SRV;
+
+	FORCEINLINE bool IsValid() const { return Texture.IsValid(); }
+};
+
+struct FCausticPooledGeometry
+{
+	FVertexBufferRHIRef VertexBuffer;
+	FIndexBufferRHIRef  IndexBuffer;
+	int32               VertexCount = 0;
+	int32               IndexCount = 0;
+
+	FORCEINLINE bool IsValid() const { return VertexBuffer.IsValid() && IndexBuffer.IsValid(); }
+};
+
+struct FCausticTextureKey
+{
+	uint32       Width;
+	uint32       Height;
+	EPixelFormat Format;
+	uint32       Flags;
+
+	FORCEINLINE bool operator==(const FCausticTextureKey& Other) const
+	{
+		return Width == Other.Width && Height == Other.Height && Format == Other.Format && Flags == Other.Flags;
+	}
+
+	friend FORCEINLINE uint32 GetTypeHash(const FCausticTextureKey& Key)
+	{
+		return HashCombine(HashCombine(GetTypeHash(Key.Width), GetTypeHash(Key.Height)), HashCombine(GetTypeHash((uint32)Key.Format), GetTypeHash(Key.Flags)));
+	}
+};
+
+struct FCausticGeometryKey
+{
+	/** Refraction grid cells along each axis */
+	uint32 SizeX;
+	uint32 SizeY;
+
+	FORCEINLINE bool operator==(const FCausticGeometryKey& Other) const
+	{
+		return SizeX == Other.SizeX && SizeY == Other.SizeY;
+	}
+
+	friend FORCEINLINE uint32 GetTypeHash(const FCausticGeometryKey& Key)
+	{
+		return HashCombine(GetTypeHash(Key.SizeX), GetTypeHash(Key.SizeY));
+	}
+};
+
+/**
+ * Recycles simulation textures and refraction grids between caustic bodies, so spawning and
+ * despawning bodies of the same size does not churn GPU allocations. The number of free entries
+ * kept per key is bounded by r.Caustic.PoolRetentionSize. Everything the pool holds or hands out
+ * is counted in the memory stats of stat Caustic.
+ */
+class FCausticResourcePool
+{
+
+public:
+
+	static FCausticResourcePool& Get();
+
+	/** Hands out a texture with views matching the creation flags. Render thread only, as it may allocate. */
+	FCausticPooledTexture AcquireTexture(uint32 Width, uint32 Height, EPixelFormat Format, uint32 Flags);
+
+	/** Returns a texture to the pool and resets the caller's references */
+	void ReleaseTexture(FCausticPooledTexture& Texture);
+
+	/** Hands out a previously released refraction grid if one matches. Never allocates. */
+	bool AcquireGeometry(const FCausticGeometryKey& Key, FCausticPooledGeometry& OutGeometry);
+
+	/** Returns a refraction grid to the pool and resets the caller's references */
+	void ReleaseGeometry(const FCausticGeometryKey& Key, FCausticPooledGeometry& Geometry);
+
+	/** Drops every free entry */
+	void Empty();
+
+	/** Bytes of the RHI resources of a pool entry */
+	static uint64 GetMemorySize(const FCausticPooledTexture& Texture);
+	static uint64 GetMemorySize(const FCausticPooledGeometry& Geometry);
+
+private:
+
+	FCausticResourcePool() {}
+
+	template <typename KeyType, typename ValueType>
+	static void TrimFreeList(TMap<KeyType, TArray<ValueType>>& FreeLists, const KeyType& Key);
+
+	/** Removes a free entry that is about to be destroyed from the memory stats */
+	static void TrackDestroyed(const FCausticPooledTexture& Texture);
+	static void TrackDestroyed(const FCausticPooledGeometry& Geometry);
+
+private:
+
+	FCriticalSection                                               PoolLock;
+	TMap<FCausticTextureKey, TArray<FCausticPooledTexture>>        FreeTextures;
+	TMap<FCausticGeometryKey, TArray<FCausticPooledGeometry>>      FreeGeometries;
+};
@@ -0,0 +1,17 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Stats/Stats.h"
+
+DECLARE_STATS_GROUP(TEXT("Caustic"), STATGROUP_Caustic, STATCAT_Advanced);
+
+DECLARE_MEMORY_STAT_EXTERN(TEXT("Pooled Textures"), STAT_CausticTextureMemory, STATGROUP_Caustic, );
+DECLARE_MEMORY_STAT_EXTERN(TEXT("Free Pooled Textures"), STAT_CausticFreeTextureMemory, STATGROUP_Caustic, );
+DECLARE_MEMORY_STAT_EXTERN(TEXT("Refraction Grids"), STAT_CausticGeometryMemory, STATGROUP_Caustic, );
+DECLARE_MEMORY_STAT_EXTERN(TEXT("Impulse And Proxy Buffers"), STAT_CausticBufferMemory, STATGROUP_Caustic, );
+DECLARE_MEMORY_STAT_EXTERN(TEXT("Reserved By Bodies"), STAT_CausticReservedMemory, STATGROUP_Caustic, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Simulated Bodies"), STAT_CausticBodies, STATGROUP_Caustic, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Sleeping Bodies"), STAT_CausticSleepingBodies, STATGROUP_Caustic, );
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Refused Bodies"), STAT_CausticRefusedBodies, STATGROUP_Caustic, );
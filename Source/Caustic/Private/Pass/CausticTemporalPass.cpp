@@ -0,0 +1,212 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#include "Pass/CausticTemporalPass.h"
+#include "RenderCore/Public/GlobalShader.h"
+#include "RenderCore/Public/ShaderParameterUtils.h"
+#include "RenderCore/Public/ShaderParameterMacros.h"
+
+#include "Public/GlobalShader.h"
+#include "Public/SceneUtils.h"
+#include "Public/ShaderParameterUtils.h"
+#include "RHI/Public/RHICommandList.h"
+#include "Pass/CausticMemory.h"
+
+BEGIN_GLOBAL_SHADER_PARAMETER_STRUCT(FCausticTemporalComputeShaderParameters, )
+	SHADER_PARAMETER(float, BlendWeight)
+END_GLOBAL_SHADER_PARAMETER_STRUCT()
+IMPLEMENT_GLOBAL_SHADER_PARAMETER_STRUCT(FCausticTemporalComputeShaderParameters, "CausticTemporalUniform");
+
+class FCausticTemporalComputeShader : public FGlobalShader
+{
+	DECLARE_GLOBAL_SHADER(FCausticTemporalComputeShader);
+
+public:
+
+	using FPermutationDomain = TShaderPermutationDomain<Caustic::FThreadGroupShapeDim>;
+
+	FCausticTemporalComputeShader() {}
+	FCausticTemporalComputeShader(const ShaderMetaType::CompiledShaderInitializerType& Initializer)
+		: FGlobalShader(Initializer)
+	{
+		CurrentCausticTexture.Bind(Initializer.ParameterMap, TEXT("CurrentCausticTexture"));
+		HistoryCausticTexture.Bind(Initializer.ParameterMap, TEXT("HistoryCausticTexture"));
+		OutputCausticTexture.Bind(Initializer.ParameterMap, TEXT("OutputCausticTexture"));
+	}
+
+	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
+	{
+		return IsFeatureLevelSupported(Parameters.Platform, ERHIFeatureLevel::SM5) && Caustic::ShouldCompileThreadGroupShape<FPermutationDomain>(Parameters.Platform, Parameters.PermutationId);
+	}
+
+	static void ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
+	{
+		FGlobalShader::ModifyCompilationEnvironment(Parameters, OutEnvironment);
+
+		FPermutationDomain PermutationVector(Parameters.PermutationId);
+		Caustic::ModifyThreadGroupCompilationEnvironment((Caustic::EThreadGroupShape)PermutationVector.Get<Caustic::FThreadGroupShapeDim>(), OutEnvironment);
+	}
+
+	virtual bool Serialize(FArchive& Ar) override
+	{
+		bool bShaderHasOutdatedParameters = FGlobalShader::Serialize(Ar);
+		Ar << CurrentCausticTexture << HistoryCausticTexture << OutputCausticTexture;
+		return bShaderHasOutdatedParameters;
+	}
+
+	void BindShaderTextures(FRHICommandList& RHICmdList, FUnorderedAccessViewRHIRef OutputTextureUAV, FShaderResourceViewRHIRef CurrentTextureSRV, FShaderResourceViewRHIRef HistoryTextureSRV)
+	{
+		FRHIComputeShader* ComputeShaderRHI = GetComputeShader();
+
+		SetUAVParameter(RHICmdList, ComputeShaderRHI, OutputCausticTexture, OutputTextureUAV);
+		SetSRVParameter(RHICmdList, ComputeShaderRHI, CurrentCausticTexture, CurrentTextureSRV);
+		SetSRVParameter(RHICmdList, ComputeShaderRHI, HistoryCausticTexture, HistoryTextureSRV);
+	}
+
+	void UnbindShaderTextures(FRHICommandList& RHICmdList)
+	{
+		FRHIComputeShader* ComputeShaderRHI = GetComputeShader();
+
+		SetUAVParameter(RHICmdList, ComputeShaderRHI, OutputCausticTexture, FUnorderedAccessViewRHIRef());
+		SetSRVParameter(RHICmdList, ComputeShaderRHI, CurrentCausticTexture, FShaderResourceViewRHIRef());
+		SetSRVParameter(RHICmdList, ComputeShaderRHI, HistoryCausticTexture, FShaderResourceViewRHIRef());
+	}
+
+	void SetShaderParameters(FRHICommandList& RHICmdList, const FCausticTemporalComputeShaderParameters& Parameters)
+	{
+		FRHIComputeShader* ComputeShaderRHI = GetComputeShader();
+		SetUniformBufferParameterImmediate(RHICmdList, ComputeShaderRHI, GetUniformBufferParameter<FCausticTemporalComputeShaderParameters>(), Parameters);
+	}
+
+private:
+
+	FShaderResourceParameter CurrentCausticTexture;
+	FShaderResourceParameter HistoryCausticTexture;
+	FShaderResourceParameter OutputCausticTexture;
+};
+
+IMPLEMENT_SHADER_TYPE(, FCausticTemporalComputeShader, TEXT("/Plugin/Caustic/CausticTemporalComputeShader.usf"), TEXT("ComputeTemporalFilter"), SF_Compute);
+
+FCausticTemporalPassRenderer::FCausticTemporalPassRenderer() :
+	HistoryIndex(0),
+	bHistoryValid(false),
+	TemporalComputeShader(nullptr),
+	ThreadGroupShape(Caustic::EThreadGroupShape::Group8x8),
+	bInitiated(false),
+	bResourcesReady(false)
+{
+
+}
+
+FCausticTemporalPassRenderer::~FCausticTemporalPassRenderer()
+{
+	ReleasePassResources();
+}
+
+uint64 FCausticTemporalPassRenderer::GetMemorySize(const FCausticTemporalPassConfig& InConfig)
+{
+	// The raw raster and both history frames
+	return Caustic::GetTextureMemorySize(InConfig.TextureWidth, InConfig.TextureHeight, PF_FloatRGBA) * 3;
+}
+
+void FCausticTemporalPassRenderer::InitPass(const FCausticTemporalPassConfig& InConfig)
+{
+	if (!bInitiated)
+	{
+		Config = InConfig;
+		bInitiated = true;
+
+		ENQUEUE_RENDER_COMMAND(CausticTemporalPassInitCommand)
+		(
+			[Renderer = AsShared()](FRHICommandListImmediate& RHICmdList)
+			{
+				Renderer->InitPass_RenderThread(RHICmdList);
+			}
+		);
+	}
+}
+
+void FCausticTemporalPassRenderer::InitPass_RenderThread(FRHICommandListImmediate& RHICmdList)
+{
+	check(IsInRenderingThread());
+
+	uint32 TextureWidth = Config.TextureWidth;
+	uint32 TextureHeight = Config.TextureHeight;
+
+	FCausticResourcePool& Pool = FCausticResourcePool::Get();
+	CausticInput = Pool.AcquireTexture(TextureWidth, TextureHeight, PF_FloatRGBA, TexCreate_RenderTargetable | TexCreate_ShaderResource);
+	History[0] = Pool.AcquireTexture(TextureWidth, TextureHeight, PF_FloatRGBA, TexCreate_ShaderResource | TexCreate_UAV);
+	History[1] = Pool.AcquireTexture(TextureWidth, TextureHeight, PF_FloatRGBA, TexCreate_ShaderResource | TexCreate_UAV);
+
+	// Pooled textures may hold another body's caustics, the first frame starts from the raw raster
+	HistoryIndex = 0;
+	bHistoryValid = false;
+
+	ThreadGroupShape = Caustic::GetThreadGroupShape(GMaxRHIShaderPlatform);
+	TShaderMap<FGlobalShaderType>* GlobalShaderMap = GetGlobalShaderMap(ERHIFeatureLevel::SM5);
+
+	FCausticTemporalComputeShader::FPermutationDomain PermutationVector;
+	PermutationVector.Set<Caustic::FThreadGroupShapeDim>((int32)ThreadGroupShape);
+	TemporalComputeShader = *TShaderMapRef<FCausticTemporalComputeShader>(GlobalShaderMap, PermutationVector);
+
+	bResourcesReady = true;
+}
+
+void FCausticTemporalPassRenderer::ReleasePass()
+{
+	if (bInitiated)
+	{
+		bInitiated = false;
+		bResourcesReady = false;
+
+		ENQUEUE_RENDER_COMMAND(CausticTemporalPassReleaseCommand)
+		(
+			[Renderer = AsShared()](FRHICommandListImmediate& RHICmdList)
+			{
+				Renderer->ReleasePassResources();
+			}
+		);
+	}
+}
+
+void FCausticTemporalPassRenderer::ReleasePassResources()
+{
+	FCausticResourcePool& Pool = FCausticResourcePool::Get();
+	Pool.ReleaseTexture(CausticInput);
+	Pool.ReleaseTexture(History[0]);
+	Pool.ReleaseTexture(History[1]);
+}
+
+void FCausticTemporalPassRenderer::Render_RenderThread(FRHICommandListImmediate& RHICmdList, const FCausticFrameParams& Params)
+{
+	check(IsInRenderingThread());
+
+	SCOPED_DRAW_EVENT(RHICmdList, CausticTemporalPass);
+
+	const FCausticPooledTexture& PrevHistory = History[HistoryIndex];
+	const FCausticPooledTexture& NextHistory = History[1 - HistoryIndex];
+
+	// Bind shader textures
+	RHICmdList.SetComputeShader(TemporalComputeShader->GetComputeShader());
+	TemporalComputeShader->BindShaderTextures(RHICmdList, NextHistory.UAV, CausticInput.SRV, PrevHistory.SRV);
+
+	// Bind shader uniform, a weight of one passes the raw raster through while there is no history
+	FCausticTemporalComputeShaderParameters UniformParam;
+	UniformParam.BlendWeight = bHistoryValid ? FMath::Clamp(Params.TemporalBlendWeight, 0.01f, 1.0f) : 1.0f;
+	TemporalComputeShader->SetShaderParameters(RHICmdList, UniformParam);
+
+	// Dispatch shader
+	const FIntVector GroupCount = Caustic::GetGroupCount(Config.TextureWidth, Config.TextureHeight, ThreadGroupShape);
+	DispatchComputeShader(RHICmdList, TemporalComputeShader, GroupCount.X, GroupCount.Y, GroupCount.Z);
+
+	// Unbind shader textures
+	TemporalComputeShader->UnbindShaderTextures(RHICmdList);
+	RHICmdList.TransitionResource(EResourceTransitionAccess::EReadable, EResourceTransitionPipeline::EComputeToCompute, NextHistory.UAV);
+
+	HistoryIndex = 1 - HistoryIndex;
+	bHistoryValid = true;
+}
+
+bool FCausticTemporalPassRenderer::IsValidPass() const
+{
+	return CausticInput.IsValid() && History[0].IsValid() && History[1].IsValid() && TemporalComputeShader != nullptr;
+}
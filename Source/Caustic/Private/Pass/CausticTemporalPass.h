@@ -0,0 +1,79 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/ObjectMacros.h"
+#include "HAL/ThreadSafeBool.h"
+#include "Pass/CausticResourcePool.h"
+#include "Pass/CausticFrameParams.h"
+#include "Pass/PassUtils.h"
+#include "RHI/Public/RHIResources.h"
+#include "RHI/Public/RHICommandList.h"
+
+struct FCausticTemporalPassConfig
+{
+	uint32                    TextureWidth;
+	uint32                    TextureHeight;
+};
+
+/**
+ * Blends the raw caustic raster into an exponential history, with the history clamped to the
+ * current 3x3 neighbourhood so moving caustics do not ghost.
+ */
+class FCausticTemporalPassRenderer : public TSharedFromThis<FCausticTemporalPassRenderer, ESPMode::ThreadSafe>
+{
+
+public:
+
+	FCausticTemporalPassRenderer();
+	~FCausticTemporalPassRenderer();
+
+	void InitPass(const FCausticTemporalPassConfig& InConfig);
+
+	/** GPU bytes InitPass allocates for a config, the budget checks this before a body creates its passes */
+	static uint64 GetMemorySize(const FCausticTemporalPassConfig& InConfig);
+
+	/** Filters the raw caustic texture into the next history texture, called by the frame graph */
+	void Render_RenderThread(FRHICommandListImmediate& RHICmdList, const FCausticFrameParams& Params);
+
+	bool IsValidPass() const;
+
+	/** Whether the render thread has finished creating the pass resources */
+	FORCEINLINE bool IsReady() const { return bResourcesReady; }
+
+	/** Drops the accumulated history, the next filtered frame starts from the raw raster */
+	FORCEINLINE void ResetHistory() { bHistoryValid = false; }
+
+	/** Returns the history textures to the resource pool */
+	void ReleasePass();
+
+	/** Target the caustic pass rasterizes into before filtering */
+	FORCEINLINE FRHITexture2D* GetCausticInputTexture() const { return CausticInput.Texture; }
+
+	FORCEINLINE FShaderResourceViewRHIRef GetCausticInputSRV() const { return CausticInput.SRV; }
+
+	/** Most recent filtered frame */
+	FORCEINLINE FRHITexture2D* GetHistoryTexture() const { return History[HistoryIndex].Texture; }
+
+	FORCEINLINE FShaderResourceViewRHIRef GetHistorySRV() const { return History[HistoryIndex].SRV; }
+
+private:
+
+	FCausticPooledTexture      CausticInput;
+	FCausticPooledTexture      History[2];
+	uint32                     HistoryIndex;
+	bool                       bHistoryValid;
+
+	class FCausticTemporalComputeShader* TemporalComputeShader;
+	Caustic::EThreadGroupShape           ThreadGroupShape;
+
+	FCausticTemporalPassConfig Config;
+	bool                       bInitiated;
+	FThreadSafeBool            bResourcesReady;
+
+private:
+
+	void InitPass_RenderThread(FRHICommandListImmediate& RHICmdList);
+	void ReleasePassResources();
+};
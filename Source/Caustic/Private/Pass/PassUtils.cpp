@@ -0,0 +1,34 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#include "Pass/PassUtils.h"
+#include "HAL/IConsoleManager.h"
+
+static TAutoConsoleVariable<int32> CVarCausticThreadGroupShape(
+	TEXT("r.Caustic.ThreadGroupShape"),
+	-1,
+	TEXT("Thread group shape of the caustic compute passes. Only the selected shape is compiled, so this is set in an ini or on the command line.\n")
+	TEXT("-1: platform default (default)\n")
+	TEXT(" 0: 8x8\n")
+	TEXT(" 1: 16x16\n")
+	TEXT(" 2: 32x8\n")
+	TEXT(" 3: 32x32"),
+	ECVF_ReadOnly | ECVF_RenderThreadSafe
+);
+
+Caustic::EThreadGroupShape Caustic::GetThreadGroupShape(EShaderPlatform Platform)
+{
+	const int32 Override = CVarCausticThreadGroupShape.GetValueOnAnyThread();
+
+	if (Override >= 0 && Override < (int32)EThreadGroupShape::MAX)
+	{
+		return (EThreadGroupShape)Override;
+	}
+
+	// Small groups keep occupancy up on tile based and Metal GPUs, 256 threads suit desktop GPUs
+	if (IsMobilePlatform(Platform) || IsMetalPlatform(Platform))
+	{
+		return EThreadGroupShape::Group8x8;
+	}
+
+	return EThreadGroupShape::Group16x16;
+}
@@ -7,6 +7,8 @@
 #include "UObject/ObjectMacros.h"
 #include "RHI/Public/RHIResources.h"
 #include "RHI/Public/RHICommandList.h"
+#include "RenderCore/Public/ShaderPermutation.h"
+#include "RenderCore/Public/ShaderCore.h"
 
 #define SafeReleaseTextureResource(Texture)  \
 	do {                                     \
@@ -32,4 +34,69 @@ namespace Caustic
 
 		return nullptr;
 	}
-}
\ No newline at end of file
+
+	/** Thread group shapes the compute passes are compiled with */
+	enum class EThreadGroupShape : int32
+	{
+		Group8x8,
+		Group16x16,
+		Group32x8,
+		Group32x32,
+		MAX
+	};
+
+	class FThreadGroupShapeDim : SHADER_PERMUTATION_INT("CAUSTIC_THREADGROUP_SHAPE", (int32)EThreadGroupShape::MAX);
+
+	class FBoundaryModeDim : SHADER_PERMUTATION_INT("CAUSTIC_BOUNDARY_MODE", (int32)ECausticBoundaryMode::MAX);
+
+	class FObstacleMaskDim : SHADER_PERMUTATION_BOOL("CAUSTIC_OBSTACLE_MASK");
+
+	class FNinePointStencilDim : SHADER_PERMUTATION_BOOL("CAUSTIC_NINE_POINT_STENCIL");
+
+	class FDisplacedVolumeDim : SHADER_PERMUTATION_BOOL("CAUSTIC_DISPLACED_VOLUME");
+
+	inline FIntPoint GetThreadGroupSize(EThreadGroupShape Shape)
+	{
+		switch (Shape)
+		{
+		case EThreadGroupShape::Group8x8:   return FIntPoint(8, 8);
+		case EThreadGroupShape::Group16x16: return FIntPoint(16, 16);
+		case EThreadGroupShape::Group32x8:  return FIntPoint(32, 8);
+		case EThreadGroupShape::Group32x32: return FIntPoint(32, 32);
+		default:                            return FIntPoint(8, 8);
+		}
+	}
+
+	/**
+	 * Group shape used on a platform, r.Caustic.ThreadGroupShape overrides the platform default.
+	 * Only this shape is compiled for the platform, so the override is read only and set before the shaders compile.
+	 */
+	EThreadGroupShape GetThreadGroupShape(EShaderPlatform Platform);
+
+	/** Whether a permutation has the group shape GetThreadGroupShape selects on its platform, the other shapes are never dispatched there */
+	template<typename TPermutationDomain>
+	inline bool ShouldCompileThreadGroupShape(EShaderPlatform Platform, int32 PermutationId)
+	{
+		const TPermutationDomain PermutationVector(PermutationId);
+		return (EThreadGroupShape)PermutationVector.template Get<FThreadGroupShapeDim>() == GetThreadGroupShape(Platform);
+	}
+
+	/** Exposes the group size of a permutation to the shader as CAUSTIC_THREADGROUP_SIZE_X/Y */
+	inline void ModifyThreadGroupCompilationEnvironment(EThreadGroupShape Shape, FShaderCompilerEnvironment& OutEnvironment)
+	{
+		const FIntPoint GroupSize = GetThreadGroupSize(Shape);
+		OutEnvironment.SetDefine(TEXT("CAUSTIC_THREADGROUP_SIZE_X"), GroupSize.X);
+		OutEnvironment.SetDefine(TEXT("CAUSTIC_THREADGROUP_SIZE_Y"), GroupSize.Y);
+	}
+
+	/** Rounds up so textures that are not a multiple of the group size still cover their edge texels */
+	inline FIntVector GetGroupCount(uint32 TextureWidth, uint32 TextureHeight, EThreadGroupShape Shape)
+	{
+		const FIntPoint GroupSize = GetThreadGroupSize(Shape);
+		return FIntVector(
+			FMath::DivideAndRoundUp<int32>(TextureWidth, GroupSize.X),
+			FMath::DivideAndRoundUp<int32>(TextureHeight, GroupSize.Y),
+			1
+		);
+	}
+}
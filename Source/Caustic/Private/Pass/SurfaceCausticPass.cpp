@@ -16,6 +16,10 @@
 #include "Public/StaticBoundShaderState.h"
 #include "RHI/Public/RHICommandList.h"
 #include "Pass/PassUtils.h"
+#include "Pass/CausticResourcePool.h"
+#include "Pass/CausticMemory.h"
+#include "Async/Async.h"
+#include "Caustic.h"
 
 struct FCausticSimpleVertex
 {
@@ -23,49 +27,23 @@ struct FCausticSimpleVertex
 	FVector2D UV;
 };
 
-class FSurfaceCausticVertexDeclaration : public FRenderResource
-{
-public:
-
-	FRHIVertexDeclaration* VertexDeclarationRHI;
-
-	virtual void InitRHI() override
-	{
-		FVertexDeclarationElementList Elements;
-		uint32 Stride = sizeof(FCausticSimpleVertex);
-		Elements.Add(FVertexElement(0, STRUCT_OFFSET(FCausticSimpleVertex, Position), VET_Float4, 0, Stride));
-		Elements.Add(FVertexElement(0, STRUCT_OFFSET(FCausticSimpleVertex, UV), VET_Float2, 1, Stride));
-
-		VertexDeclarationRHI = RHICreateVertexDeclaration(Elements);
-	}
-
-	virtual void ReleaseRHI()
-	{
-		if (VertexDeclarationRHI)
-		{
-			VertexDeclarationRHI->Release();
-		}
-	}
-};
-
 class FSurfaceCausticSimpleVertexBuffer : public FVertexBuffer
 {
 public:
 
-	int32 VertexCount;
+	using FVertexArray = TResourceArray<FCausticSimpleVertex, VERTEXBUFFER_ALIGNMENT>;
 
-	void Init(uint32 Width, uint32 Height, uint32 CellSize)
-	{
-		ReleaseRHI();
+	int32 VertexCount = 0;
 
-		const int32 SizeX = FMath::RoundToInt(Width / CellSize);
-		const int32 SizeY = FMath::RoundToInt(Height / CellSize);
+	/** Builds the refraction grid vertices. Safe to call from any thread. */
+	static void BuildVertices(const FIntPoint& GridSize, FVertexArray& OutVertices)
+	{
+		const int32 SizeX = GridSize.X;
+		const int32 SizeY = GridSize.Y;
 		const float CellU = 1.0f / SizeX;
 		const float CellV = 1.0f / SizeY;
-		VertexCount = (SizeX + 1) * (SizeY + 1);
 
-		TResourceArray<FCausticSimpleVertex, VERTEXBUFFER_ALIGNMENT> Vertices;
-		Vertices.SetNumUninitialized(VertexCount);
+		OutVertices.SetNumUninitialized((SizeX + 1) * (SizeY + 1));
 
 		int Index = 0;
 		for (int32 Y = 0; Y <= SizeY; ++Y)
@@ -79,12 +57,24 @@ public:
 				float LocY = FMath::Lerp(-1.f, 1.f, V);
 				float LocZ = 0.0f;
 
-				Vertices[Index++] = { FVector4(LocX, LocY, LocZ, 1), FVector2D(U, V) };
+				OutVertices[Index++] = { FVector4(LocX, LocY, LocZ, 1), FVector2D(U, V) };
 			}
 		}
+	}
+
+	void Init(FVertexArray& Vertices)
+	{
+		check(IsInRenderingThread());
+
+		ReleaseRHI();
+
+		VertexCount = Vertices.Num();
+
+		CAUSTIC_LLM_SCOPE();
+		INC_MEMORY_STAT_BY(STAT_CausticGeometryMemory, Vertices.GetResourceDataSize());
 
 		FRHIResourceCreateInfo CreateInfo(&Vertices);
-		VertexBufferRHI = RHICreateVertexBuffer(Vertices.GetResourceDataSize(), BUF_Dynamic, CreateInfo);
+		VertexBufferRHI = RHICreateVertexBuffer(Vertices.GetResourceDataSize(), BUF_Static, CreateInfo);
 	}
 
 	void InitRHI() override
@@ -110,22 +100,19 @@ class FSurfaceCausticSimpleIndexBuffer : public FIndexBuffer
 {
 public:
 
-	int32 IndexCount;
+	using FIndexArray = TResourceArray<uint16, INDEXBUFFER_ALIGNMENT>;
+
+	int32 IndexCount = 0;
 
-	void Init(uint32 Width, uint32 Height, uint32 CellSize)
+	/** Builds the refraction grid triangle list. Safe to call from any thread. */
+	static void BuildIndices(const FIntPoint& GridSize, FIndexArray& OutIndices)
 	{
-		ReleaseRHI();
+		check(GridSize.X <= FSurfaceCausticPassRenderer::MaxGridCells && GridSize.Y <= FSurfaceCausticPassRenderer::MaxGridCells);
 
-		const uint16 SizeX = FMath::RoundToInt(Width / CellSize);
-		const uint16 SizeY = FMath::RoundToInt(Height / CellSize);
-		const float CellWidth = Width / SizeX;
-		const float CellHeight = Height / SizeY;
-		const float CellU = 1.0f / SizeX;
-		const float CellV = 1.0f / SizeY;
-		IndexCount = SizeX * SizeY * 6;
+		const uint16 SizeX = GridSize.X;
+		const uint16 SizeY = GridSize.Y;
 
-		TResourceArray<uint16, INDEXBUFFER_ALIGNMENT> Indices;
-		Indices.SetNumUninitialized(IndexCount);
+		OutIndices.SetNumUninitialized(SizeX * SizeY * 6);
 
 		int Index = 0;
 		for (uint16 Y = 0; Y < SizeY; ++Y)
@@ -137,18 +124,30 @@ public:
 				uint16 C = A + SizeX + 2;
 				uint16 D = A + 1;
 
-				Indices[Index++] = A;
-				Indices[Index++] = B;
-				Indices[Index++] = C;
+				OutIndices[Index++] = A;
+				OutIndices[Index++] = B;
+				OutIndices[Index++] = C;
 
-				Indices[Index++] = A;
-				Indices[Index++] = C;
-				Indices[Index++] = D;
+				OutIndices[Index++] = A;
+				OutIndices[Index++] = C;
+				OutIndices[Index++] = D;
 			}
 		}
+	}
+
+	void Init(FIndexArray& Indices)
+	{
+		check(IsInRenderingThread());
+
+		ReleaseRHI();
+
+		IndexCount = Indices.Num();
+
+		CAUSTIC_LLM_SCOPE();
+		INC_MEMORY_STAT_BY(STAT_CausticGeometryMemory, Indices.GetResourceDataSize());
 
 		FRHIResourceCreateInfo CreateInfo(&Indices);
-		IndexBufferRHI = RHICreateIndexBuffer(sizeof(uint16), Indices.GetResourceDataSize(), BUF_Dynamic, CreateInfo);
+		IndexBufferRHI = RHICreateIndexBuffer(sizeof(uint16), Indices.GetResourceDataSize(), BUF_Static, CreateInfo);
 	}
 
 	void InitRHI() override
@@ -166,10 +165,19 @@ public:
 };
 
 BEGIN_GLOBAL_SHADER_PARAMETER_STRUCT(FSurfaceCausticVertexShaderParameters, )
+	SHADER_PARAMETER(FVector, LightDirection)
+	SHADER_PARAMETER(float, IndexOfRefraction)
+	SHADER_PARAMETER(FVector2D, FloorOffsetScale)
 	SHADER_PARAMETER(float, Refraction)
+	SHADER_PARAMETER(float, Dispersion)
 END_GLOBAL_SHADER_PARAMETER_STRUCT()
 IMPLEMENT_GLOBAL_SHADER_PARAMETER_STRUCT(FSurfaceCausticVertexShaderParameters, "SurfaceCausticUniform");
 
+/** Refracts each colour channel with its own index and outputs per channel intensity from a single draw */
+class FDispersionDim : SHADER_PERMUTATION_BOOL("CAUSTIC_DISPERSION");
+
+class FProjectionDim : SHADER_PERMUTATION_INT("CAUSTIC_PROJECTION", (int32)ECausticProjection::MAX);
+
 class FSurfaceCausticVertexShader : public FGlobalShader
 {
 
@@ -177,11 +185,14 @@ class FSurfaceCausticVertexShader : public FGlobalShader
 
 public:
 
+	using FPermutationDomain = TShaderPermutationDomain<FDispersionDim, FProjectionDim>;
+
 	FSurfaceCausticVertexShader() {}
 	FSurfaceCausticVertexShader(const ShaderMetaType::CompiledShaderInitializerType& Initializer) :
 		FGlobalShader(Initializer)
 	{
 		InputNormalTexture.Bind(Initializer.ParameterMap, TEXT("InputNormalTexture"));
+		ObstacleMaskTexture.Bind(Initializer.ParameterMap, TEXT("ObstacleMaskTexture"));
 		CausticPassSampler.Bind(Initializer.ParameterMap, TEXT("CausticPassSampler"));
 	}
 
@@ -193,16 +204,17 @@ public:
 	virtual bool Serialize(FArchive& Ar) override
 	{
 		bool bShaderHasOutdatedParameters = FGlobalShader::Serialize(Ar);
-		Ar << InputNormalTexture << CausticPassSampler;
+		Ar << InputNormalTexture << ObstacleMaskTexture << CausticPassSampler;
 		return bShaderHasOutdatedParameters;
 	}
 
-	void BindShaderTextures(FRHICommandList& RHICmdList, FShaderResourceViewRHIRef InputTextureSRV)
+	void BindShaderTextures(FRHICommandList& RHICmdList, FShaderResourceViewRHIRef InputTextureSRV, FShaderResourceViewRHIRef ObstacleMaskSRV)
 	{
 		FRHIVertexShader* VertexShaderRHI = GetVertexShader();
 		FRHISamplerState* SamplerStateLinear = TStaticSamplerState<SF_Bilinear, AM_Clamp, AM_Clamp, AM_Clamp>::GetRHI();
 
 		SetSRVParameter(RHICmdList, VertexShaderRHI, InputNormalTexture, InputTextureSRV);
+		SetSRVParameter(RHICmdList, VertexShaderRHI, ObstacleMaskTexture, ObstacleMaskSRV);
 		SetSamplerParameter(RHICmdList, VertexShaderRHI, CausticPassSampler, SamplerStateLinear);
 	}
 
@@ -210,6 +222,7 @@ public:
 	{
 		FRHIVertexShader* VertexShaderRHI = GetVertexShader();
 		SetSRVParameter(RHICmdList, VertexShaderRHI, InputNormalTexture, FShaderResourceViewRHIRef());
+		SetSRVParameter(RHICmdList, VertexShaderRHI, ObstacleMaskTexture, FShaderResourceViewRHIRef());
 	}
 
 	void SetShaderParameters(FRHICommandList& RHICmdList, const FSurfaceCausticVertexShaderParameters& Parameters)
@@ -221,6 +234,7 @@ public:
 private:
 
 	FShaderResourceParameter InputNormalTexture;
+	FShaderResourceParameter ObstacleMaskTexture;
 	FShaderResourceParameter CausticPassSampler;
 };
 
@@ -231,6 +245,8 @@ class FSurfaceCausticPixelShader : public FGlobalShader
 
 public:
 
+	using FPermutationDomain = TShaderPermutationDomain<FDispersionDim>;
+
 	FSurfaceCausticPixelShader() {}
 	FSurfaceCausticPixelShader(const ShaderMetaType::CompiledShaderInitializerType& Initializer) :
 		FGlobalShader(Initializer)
@@ -253,14 +269,18 @@ IMPLEMENT_SHADER_TYPE(, FSurfaceCausticPixelShader, TEXT("/Plugin/Caustic/Surfac
 
 FSurfaceCausticPassRenderer::FSurfaceCausticPassRenderer() :
 	bInitiated(false),
+	bResourcesReady(false),
 	SurfaceCausticVertexBuffer(new FSurfaceCausticSimpleVertexBuffer),
 	SurfaceCausticIndexBuffer(new FSurfaceCausticSimpleIndexBuffer)
 {
-
+	FMemory::Memzero(VertexShaders);
+	FMemory::Memzero(PixelShaders);
 }
 
 FSurfaceCausticPassRenderer::~FSurfaceCausticPassRenderer()
 {
+	// Pending init work holds a reference to the renderer, so nothing can be in flight here
+	ReleasePassResources();
 }
 
 void FSurfaceCausticPassRenderer::InitPass(const FSurfaceCausticPassConfig& InConfig)
@@ -270,95 +290,228 @@ void FSurfaceCausticPassRenderer::InitPass(const FSurfaceCausticPassConfig& InCo
 		Config = InConfig;
 		bInitiated = true;
 
-		SurfaceCausticVertexBuffer->Init(Config.TextureWidth, Config.TextureHeight, Config.CellSize);
-		SurfaceCausticIndexBuffer->Init(Config.TextureWidth, Config.TextureHeight, Config.CellSize);
+		const FIntPoint GridSize = GetGridSize(Config.TextureWidth, Config.TextureHeight, Config.CellSize);
+		if (GridSize.X == MaxGridCells || GridSize.Y == MaxGridCells)
+		{
+			UE_LOG(LogCaustic, Warning, TEXT("Refraction grid for a %ux%u caustic texture is clamped to %dx%d cells by its 16-bit indices, raise CellSize to keep its density"),
+				Config.TextureWidth, Config.TextureHeight, GridSize.X, GridSize.Y);
+		}
+
+		// Reuse a refraction grid released by a body of the same size if there is one
+		FCausticPooledGeometry Geometry;
+		if (FCausticResourcePool::Get().AcquireGeometry(GetGeometryKey(), Geometry))
+		{
+			ENQUEUE_RENDER_COMMAND(SurfaceCausticPassInitCommand)
+			(
+				[Renderer = AsShared(), Geometry](FRHICommandListImmediate& RHICmdList)
+				{
+					Renderer->SurfaceCausticVertexBuffer->VertexBufferRHI = Geometry.VertexBuffer;
+					Renderer->SurfaceCausticVertexBuffer->VertexCount = Geometry.VertexCount;
+					Renderer->SurfaceCausticIndexBuffer->IndexBufferRHI = Geometry.IndexBuffer;
+					Renderer->SurfaceCausticIndexBuffer->IndexCount = Geometry.IndexCount;
+					Renderer->InitPipeline_RenderThread();
+				}
+			);
+
+			return;
+		}
+
+		// Generate the refraction grid on a worker thread, then hand it to the render thread for upload
+		InitTask = Async(EAsyncExecution::ThreadPool, [Renderer = AsShared(), GridConfig = Config]()
+		{
+			FSurfaceCausticSimpleVertexBuffer::FVertexArray Vertices;
+			FSurfaceCausticSimpleIndexBuffer::FIndexArray Indices;
+			const FIntPoint GridSize = GetGridSize(GridConfig.TextureWidth, GridConfig.TextureHeight, GridConfig.CellSize);
+			FSurfaceCausticSimpleVertexBuffer::BuildVertices(GridSize, Vertices);
+			FSurfaceCausticSimpleIndexBuffer::BuildIndices(GridSize, Indices);
+
+			ENQUEUE_RENDER_COMMAND(SurfaceCausticPassInitCommand)
+			(
+				[Renderer, Vertices = MoveTemp(Vertices), Indices = MoveTemp(Indices)](FRHICommandListImmediate& RHICmdList) mutable
+				{
+					Renderer->SurfaceCausticVertexBuffer->Init(Vertices);
+					Renderer->SurfaceCausticIndexBuffer->Init(Indices);
+					Renderer->InitPipeline_RenderThread();
+				}
+			);
+		});
 	}
 }
 
-void FSurfaceCausticPassRenderer::Render(const FLiquidParam& LiquidParam, FShaderResourceViewRHIRef NormalTextureSRV, UTextureRenderTarget2D* RenderTarget)
+void FSurfaceCausticPassRenderer::ReleasePass()
 {
-	if (IsValidPass())
+	if (bInitiated)
 	{
-		ENQUEUE_RENDER_COMMAND(SurfaceCausticPassCommand)
+		WaitForPendingInit();
+
+		bInitiated = false;
+		bResourcesReady = false;
+
+		ENQUEUE_RENDER_COMMAND(SurfaceCausticPassReleaseCommand)
 		(
-			[&LiquidParam, NormalTextureSRV, RenderTarget, this](FRHICommandListImmediate& RHICmdList)
+			[Renderer = AsShared()](FRHICommandListImmediate& RHICmdList)
 			{
-				check(IsInRenderingThread());
+				Renderer->ReleasePassResources();
+			}
+		);
+	}
+}
 
-				FTextureRenderTargetResource* RenderTargetResource = RenderTarget->GetRenderTargetResource();
-				FTexture2DRHIRef RenderTargetResourceRef = RenderTargetResource->GetRenderTargetTexture();
-				FRHIRenderPassInfo PassInfo(RenderTargetResourceRef, ERenderTargetActions::DontLoad_Store, nullptr);
+void FSurfaceCausticPassRenderer::ReleasePassResources()
+{
+	FCausticPooledGeometry Geometry;
+	Geometry.VertexBuffer = MoveTemp(SurfaceCausticVertexBuffer->VertexBufferRHI);
+	Geometry.VertexCount = SurfaceCausticVertexBuffer->VertexCount;
+	Geometry.IndexBuffer = MoveTemp(SurfaceCausticIndexBuffer->IndexBufferRHI);
+	Geometry.IndexCount = SurfaceCausticIndexBuffer->IndexCount;
 
-				RHICmdList.BeginRenderPass(PassInfo, TEXT("SurfaceCausticPass"));
-				{
-					const uint32 TextureWidth = Config.TextureWidth;
-					const uint32 TextureHeight = Config.TextureHeight;
-					const uint32 RenderTextureWidth = RenderTargetResourceRef->GetSizeX();
-					const uint32 RenderTextureHeight = RenderTargetResourceRef->GetSizeY();
-
-					// Update viewport
-					RHICmdList.SetViewport(
-						0.f, 0.f, 0.f,
-						TextureWidth, TextureHeight, 1.f
-					);
-
-					// Get shaders
-					TShaderMap<FGlobalShaderType>* GlobalShaderMap = GetGlobalShaderMap(ERHIFeatureLevel::SM5);
-					TShaderMapRef<FSurfaceCausticVertexShader> VertexShader(GlobalShaderMap);
-					TShaderMapRef<FSurfaceCausticPixelShader> PixelShader(GlobalShaderMap);
-
-					FSurfaceCausticVertexDeclaration VertexDesc;
-					VertexDesc.InitRHI();
-
-					// Set the graphic pipeline state
-					FGraphicsPipelineStateInitializer GraphicsPSOInit;
-					RHICmdList.ApplyCachedRenderTargets(GraphicsPSOInit);
-					GraphicsPSOInit.DepthStencilState = TStaticDepthStencilState<false, CF_Always>::GetRHI();
-					GraphicsPSOInit.BlendState = TStaticBlendState<>::GetRHI();
-					GraphicsPSOInit.RasterizerState = TStaticRasterizerState<>::GetRHI();
-					GraphicsPSOInit.PrimitiveType = PT_TriangleList;
-					GraphicsPSOInit.BoundShaderState.VertexDeclarationRHI = VertexDesc.VertexDeclarationRHI;
-					GraphicsPSOInit.BoundShaderState.VertexShaderRHI = GETSAFERHISHADER_VERTEX(*VertexShader);
-					GraphicsPSOInit.BoundShaderState.PixelShaderRHI = GETSAFERHISHADER_PIXEL(*PixelShader);
-					SetGraphicsPipelineState(RHICmdList, GraphicsPSOInit);
-
-					// Update viewport
-					RHICmdList.SetViewport(
-						0.f, 0.f, 0.f,
-						RenderTextureWidth, RenderTextureHeight, 1.f
-					);
-
-					// Bind shader textures
-					VertexShader->BindShaderTextures(RHICmdList, NormalTextureSRV);
-
-					// Bind shader uniform
-					FSurfaceCausticVertexShaderParameters UniformParam;
-					UniformParam.Refraction = LiquidParam.Refraction;
-					VertexShader->SetShaderParameters(RHICmdList, UniformParam);
-
-					// Dispatch pass
-					RHICmdList.SetStreamSource(0, SurfaceCausticVertexBuffer->VertexBufferRHI, 0);
-					RHICmdList.DrawIndexedPrimitive(
-						SurfaceCausticIndexBuffer->IndexBufferRHI,
-						0, // BaseVertexIndex
-						0, // MinIndex
-						SurfaceCausticVertexBuffer->VertexCount, // NumVertices
-						0, // StartIndex
-						SurfaceCausticIndexBuffer->IndexCount / 3, // NumPrimitives
-						1  // NumInstances
-					);
-
-					// Unbind shader textures
-					VertexShader->UnbindShaderTextures(RHICmdList);
-				}
+	FCausticResourcePool::Get().ReleaseGeometry(GetGeometryKey(), Geometry);
+}
 
-				RHICmdList.EndRenderPass();
-			}
+FIntPoint FSurfaceCausticPassRenderer::GetGridSize(uint32 Width, uint32 Height, float CellSize)
+{
+	const float SafeCellSize = FMath::Max(CellSize, KINDA_SMALL_NUMBER);
+	return FIntPoint(
+		FMath::Clamp(FMath::RoundToInt(Width / SafeCellSize), 1, MaxGridCells),
+		FMath::Clamp(FMath::RoundToInt(Height / SafeCellSize), 1, MaxGridCells)
+	);
+}
+
+uint64 FSurfaceCausticPassRenderer::GetMemorySize(const FSurfaceCausticPassConfig& InConfig)
+{
+	const FIntPoint GridSize = GetGridSize(InConfig.TextureWidth, InConfig.TextureHeight, InConfig.CellSize);
+	const uint64 SizeX = GridSize.X;
+	const uint64 SizeY = GridSize.Y;
+
+	// The pass renders into the caustic target it is given, only the refraction grid is its own
+	return (SizeX + 1) * (SizeY + 1) * sizeof(FCausticSimpleVertex) + SizeX * SizeY * 6 * sizeof(uint16);
+}
+
+FCausticGeometryKey FSurfaceCausticPassRenderer::GetGeometryKey() const
+{
+	// The grid is built in clip space, bodies with the same cell count share it whatever their texture size
+	const FIntPoint GridSize = GetGridSize(Config.TextureWidth, Config.TextureHeight, Config.CellSize);
+	return { (uint32)GridSize.X, (uint32)GridSize.Y };
+}
+
+int32 FSurfaceCausticPassRenderer::GetShaderIndex(bool bDispersion, ECausticProjection Projection)
+{
+	return (bDispersion ? 1 : 0) * (int32)ECausticProjection::MAX + (int32)Projection;
+}
+
+void FSurfaceCausticPassRenderer::InitPipeline_RenderThread()
+{
+	check(IsInRenderingThread());
+
+	// Resolve the shaders and the vertex declaration once instead of every frame
+	TShaderMap<FGlobalShaderType>* GlobalShaderMap = GetGlobalShaderMap(ERHIFeatureLevel::SM5);
+	for (int32 Dispersion = 0; Dispersion < 2; ++Dispersion)
+	{
+		for (int32 Projection = 0; Projection < (int32)ECausticProjection::MAX; ++Projection)
+		{
+			FSurfaceCausticVertexShader::FPermutationDomain VertexPermutationVector;
+			VertexPermutationVector.Set<FDispersionDim>(Dispersion != 0);
+			VertexPermutationVector.Set<FProjectionDim>(Projection);
+			VertexShaders[GetShaderIndex(Dispersion != 0, (ECausticProjection)Projection)] = *TShaderMapRef<FSurfaceCausticVertexShader>(GlobalShaderMap, VertexPermutationVector);
+		}
+
+		FSurfaceCausticPixelShader::FPermutationDomain PixelPermutationVector;
+		PixelPermutationVector.Set<FDispersionDim>(Dispersion != 0);
+		PixelShaders[Dispersion] = *TShaderMapRef<FSurfaceCausticPixelShader>(GlobalShaderMap, PixelPermutationVector);
+	}
+
+	FVertexDeclarationElementList Elements;
+	uint32 Stride = sizeof(FCausticSimpleVertex);
+	Elements.Add(FVertexElement(0, STRUCT_OFFSET(FCausticSimpleVertex, Position), VET_Float4, 0, Stride));
+	Elements.Add(FVertexElement(0, STRUCT_OFFSET(FCausticSimpleVertex, UV), VET_Float2, 1, Stride));
+	VertexDeclarationRHI = PipelineStateCache::GetOrCreateVertexDeclaration(Elements);
+
+	bResourcesReady = true;
+}
+
+void FSurfaceCausticPassRenderer::WaitForPendingInit()
+{
+	if (InitTask.IsValid())
+	{
+		InitTask.Wait();
+	}
+}
+
+void FSurfaceCausticPassRenderer::Render_RenderThread(FRHICommandListImmediate& RHICmdList, const FCausticFrameParams& Params, FShaderResourceViewRHIRef NormalTextureSRV, FShaderResourceViewRHIRef ObstacleMaskSRV, FRHITexture2D* RenderTarget)
+{
+	check(IsInRenderingThread());
+
+	SCOPED_DRAW_EVENT(RHICmdList, SurfaceCausticPass);
+
+	const bool bDispersion = Params.Dispersion > 0.0f;
+	FSurfaceCausticVertexShader* VertexShader = VertexShaders[GetShaderIndex(bDispersion, Params.Projection)];
+	FSurfaceCausticPixelShader* PixelShader = PixelShaders[bDispersion ? 1 : 0];
+
+	FRHIRenderPassInfo PassInfo(RenderTarget, ERenderTargetActions::DontLoad_Store, nullptr);
+
+	RHICmdList.BeginRenderPass(PassInfo, TEXT("SurfaceCausticPass"));
+	{
+		const uint32 TextureWidth = Config.TextureWidth;
+		const uint32 TextureHeight = Config.TextureHeight;
+		const uint32 RenderTextureWidth = RenderTarget->GetSizeX();
+		const uint32 RenderTextureHeight = RenderTarget->GetSizeY();
+
+		// Update viewport
+		RHICmdList.SetViewport(
+			0.f, 0.f, 0.f,
+			TextureWidth, TextureHeight, 1.f
 		);
+
+		// Set the graphic pipeline state
+		FGraphicsPipelineStateInitializer GraphicsPSOInit;
+		RHICmdList.ApplyCachedRenderTargets(GraphicsPSOInit);
+		GraphicsPSOInit.DepthStencilState = TStaticDepthStencilState<false, CF_Always>::GetRHI();
+		GraphicsPSOInit.BlendState = TStaticBlendState<>::GetRHI();
+		GraphicsPSOInit.RasterizerState = TStaticRasterizerState<>::GetRHI();
+		GraphicsPSOInit.PrimitiveType = PT_TriangleList;
+		GraphicsPSOInit.BoundShaderState.VertexDeclarationRHI = VertexDeclarationRHI;
+		GraphicsPSOInit.BoundShaderState.VertexShaderRHI = GETSAFERHISHADER_VERTEX(VertexShader);
+		GraphicsPSOInit.BoundShaderState.PixelShaderRHI = GETSAFERHISHADER_PIXEL(PixelShader);
+		SetGraphicsPipelineState(RHICmdList, GraphicsPSOInit);
+
+		// Update viewport
+		RHICmdList.SetViewport(
+			0.f, 0.f, 0.f,
+			RenderTextureWidth, RenderTextureHeight, 1.f
+		);
+
+		// Bind shader textures
+		VertexShader->BindShaderTextures(RHICmdList, NormalTextureSRV, ObstacleMaskSRV);
+
+		// Bind shader uniform
+		FSurfaceCausticVertexShaderParameters UniformParam;
+		UniformParam.LightDirection = Params.LightDirection.GetSafeNormal(SMALL_NUMBER, FVector(0.0f, 0.0f, -1.0f));
+		UniformParam.IndexOfRefraction = Params.IndexOfRefraction;
+		UniformParam.FloorOffsetScale = FVector2D(2.0f * Config.FarClipZ / FMath::Max(Config.BodyWidth, 1.0f), 2.0f * Config.FarClipZ / FMath::Max(Config.BodyHeight, 1.0f));
+		UniformParam.Refraction = Params.Refraction;
+		UniformParam.Dispersion = Params.Dispersion;
+		VertexShader->SetShaderParameters(RHICmdList, UniformParam);
+
+		// Dispatch pass
+		RHICmdList.SetStreamSource(0, SurfaceCausticVertexBuffer->VertexBufferRHI, 0);
+		RHICmdList.DrawIndexedPrimitive(
+			SurfaceCausticIndexBuffer->IndexBufferRHI,
+			0, // BaseVertexIndex
+			0, // MinIndex
+			SurfaceCausticVertexBuffer->VertexCount, // NumVertices
+			0, // StartIndex
+			SurfaceCausticIndexBuffer->IndexCount / 3, // NumPrimitives
+			1  // NumInstances
+		);
+
+		// Unbind shader textures
+		VertexShader->UnbindShaderTextures(RHICmdList);
 	}
+
+	RHICmdList.EndRenderPass();
 }
 
 bool FSurfaceCausticPassRenderer::IsValidPass() const
 {
-	return true;
+	return bResourcesReady;
 }
\ No newline at end of file
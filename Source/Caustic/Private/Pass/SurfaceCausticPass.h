@@ -4,6 +4,9 @@
 
 #include "CoreMinimal.h"
 #include "UObject/ObjectMacros.h"
+#include "HAL/ThreadSafeBool.h"
+#include "Async/Future.h"
+#include "Pass/CausticFrameParams.h"
 #include "RHI/Public/RHIResources.h"
 #include "RHI/Public/RHICommandList.h"
 
@@ -11,12 +14,18 @@ struct FSurfaceCausticPassConfig
 {
 	uint32 TextureWidth;
 	uint32 TextureHeight;
-	uint32 CellSize;
+
+	/** Refraction grid cell in caustic texels, fractional so the grid density does not snap with the resolution */
+	float  CellSize;
 	float  FarClipZ;
 	float  NearClipZ;
+
+	/** Body extent the caustic texture covers, converts floor offsets into texture space */
+	float  BodyWidth;
+	float  BodyHeight;
 };
 
-class FSurfaceCausticPassRenderer
+class FSurfaceCausticPassRenderer : public TSharedFromThis<FSurfaceCausticPassRenderer, ESPMode::ThreadSafe>
 {
 
 public:
@@ -26,15 +35,52 @@ public:
 
 	void InitPass(const FSurfaceCausticPassConfig& InConfig);
 
-	void Render(const FLiquidParam& LiquidParam, FShaderResourceViewRHIRef HeightTextureSRV, UTextureRenderTarget2D* RenderTarget);
+	/**
+	 * Refraction grid cells along each axis. The grid is indexed with 16 bits, so it is clamped to
+	 * MaxGridCells per axis, which keeps the vertex count within 65536.
+	 */
+	static FIntPoint GetGridSize(uint32 Width, uint32 Height, float CellSize);
+
+	static constexpr int32 MaxGridCells = 255;
+
+	/** GPU bytes InitPass allocates for a config, the budget checks this before a body creates its passes */
+	static uint64 GetMemorySize(const FSurfaceCausticPassConfig& InConfig);
+
+	/** Records the caustic raster pass into the given target, called by the frame graph */
+	void Render_RenderThread(FRHICommandListImmediate& RHICmdList, const FCausticFrameParams& Params, FShaderResourceViewRHIRef NormalTextureSRV, FShaderResourceViewRHIRef ObstacleMaskSRV, FRHITexture2D* RenderTarget);
 
 	bool IsValidPass() const;
 
+	/** Whether the render thread has finished uploading the refraction grid */
+	FORCEINLINE bool IsReady() const { return bResourcesReady; }
+
+	/** Blocks until the worker thread building the refraction grid has finished */
+	void WaitForPendingInit();
+
+	/** Returns the refraction grid to the resource pool */
+	void ReleasePass();
+
 private:
 
 	FSurfaceCausticPassConfig         Config;
 	bool                              bInitiated;
+	FThreadSafeBool                   bResourcesReady;
+	TFuture<void>                     InitTask;
+
+	/** Indexed by GetShaderIndex */
+	class FSurfaceCausticVertexShader* VertexShaders[2 * (int32)ECausticProjection::MAX];
+	class FSurfaceCausticPixelShader*  PixelShaders[2];
+	FVertexDeclarationRHIRef           VertexDeclarationRHI;
 
 	TUniquePtr<class FSurfaceCausticSimpleVertexBuffer> SurfaceCausticVertexBuffer;
 	TUniquePtr<class FSurfaceCausticSimpleIndexBuffer>  SurfaceCausticIndexBuffer;
+
+private:
+
+	void InitPipeline_RenderThread();
+	void ReleasePassResources();
+
+	struct FCausticGeometryKey GetGeometryKey() const;
+
+	static int32 GetShaderIndex(bool bDispersion, ECausticProjection Projection);
 };
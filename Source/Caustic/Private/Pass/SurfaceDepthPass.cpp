@@ -16,6 +16,13 @@
 #include "Public/StaticBoundShaderState.h"
 #include "RHI/Public/RHICommandList.h"
 #include "Pass/PassUtils.h"
+#include "Pass/CausticResourcePool.h"
+#include "Pass/CausticMemory.h"
+#include "Pass/CausticStats.h"
+#include "ClearQuad.h"
+#include "StaticMeshResources.h"
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("Splatted Impulses"), STAT_CausticSplattedImpulses, STATGROUP_Caustic);
 
 BEGIN_GLOBAL_SHADER_PARAMETER_STRUCT(FSurfaceDepthComputeShaderParameters, )
 	SHADER_PARAMETER(float, MinDepth)
@@ -27,26 +34,65 @@ IMPLEMENT_GLOBAL_SHADER_PARAMETER_STRUCT(FSurfaceDepthComputeShaderParameters, "
 BEGIN_GLOBAL_SHADER_PARAMETER_STRUCT(FSurfaceHeightComputeShaderParameters, )
 	SHADER_PARAMETER(FVector4, LiquidParam)
 	SHADER_PARAMETER(float, AttenuationCoefficient)
+	SHADER_PARAMETER(float, SpongeWidth)
+	SHADER_PARAMETER(float, SpongeStrength)
 END_GLOBAL_SHADER_PARAMETER_STRUCT()
 IMPLEMENT_GLOBAL_SHADER_PARAMETER_STRUCT(FSurfaceHeightComputeShaderParameters, "SurfaceHeightUniform");
 
+BEGIN_GLOBAL_SHADER_PARAMETER_STRUCT(FSurfaceObstacleMaskComputeShaderParameters, )
+	SHADER_PARAMETER(float, ObstacleDepth)
+END_GLOBAL_SHADER_PARAMETER_STRUCT()
+IMPLEMENT_GLOBAL_SHADER_PARAMETER_STRUCT(FSurfaceObstacleMaskComputeShaderParameters, "SurfaceObstacleMaskUniform");
+
+BEGIN_GLOBAL_SHADER_PARAMETER_STRUCT(FSurfaceImpulseComputeShaderParameters, )
+	SHADER_PARAMETER(uint32, ImpulseCount)
+	SHADER_PARAMETER(float, ForceFactor)
+END_GLOBAL_SHADER_PARAMETER_STRUCT()
+IMPLEMENT_GLOBAL_SHADER_PARAMETER_STRUCT(FSurfaceImpulseComputeShaderParameters, "SurfaceImpulseUniform");
+
+BEGIN_GLOBAL_SHADER_PARAMETER_STRUCT(FSurfaceProxyDepthComputeShaderParameters, )
+	SHADER_PARAMETER(FVector2D, BodySize)
+	SHADER_PARAMETER(uint32, ProxyCount)
+	SHADER_PARAMETER(uint32, MergeMeshDepth)
+END_GLOBAL_SHADER_PARAMETER_STRUCT()
+IMPLEMENT_GLOBAL_SHADER_PARAMETER_STRUCT(FSurfaceProxyDepthComputeShaderParameters, "SurfaceProxyDepthUniform");
+
+BEGIN_GLOBAL_SHADER_PARAMETER_STRUCT(FSurfaceMeshDepthShaderParameters, )
+	SHADER_PARAMETER(FMatrix, LocalToSurface)
+	SHADER_PARAMETER(FVector2D, InvHalfBodySize)
+	SHADER_PARAMETER(float, InvMaxDepth)
+	SHADER_PARAMETER(float, FacingScale)
+END_GLOBAL_SHADER_PARAMETER_STRUCT()
+IMPLEMENT_GLOBAL_SHADER_PARAMETER_STRUCT(FSurfaceMeshDepthShaderParameters, "SurfaceMeshDepthUniform");
+
 class FSurfaceDepthComputeShader : public FGlobalShader
 {
 	DECLARE_GLOBAL_SHADER(FSurfaceDepthComputeShader);
 
 public:
 
+	using FPermutationDomain = TShaderPermutationDomain<Caustic::FThreadGroupShapeDim, Caustic::FDisplacedVolumeDim>;
+
 	FSurfaceDepthComputeShader() {}
 	FSurfaceDepthComputeShader(const ShaderMetaType::CompiledShaderInitializerType& Initializer)
 		: FGlobalShader(Initializer)
 	{
 		InputDepthTexture.Bind(Initializer.ParameterMap, TEXT("InputDepthTexture"));
 		OutputDepthTexture.Bind(Initializer.ParameterMap, TEXT("OutputDepthTexture"));
+		DisplacementTexture.Bind(Initializer.ParameterMap, TEXT("DisplacementTexture"));
 	}
 
 	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
 	{
-		return IsFeatureLevelSupported(Parameters.Platform, ERHIFeatureLevel::SM5);
+		return IsFeatureLevelSupported(Parameters.Platform, ERHIFeatureLevel::SM5) && Caustic::ShouldCompileThreadGroupShape<FPermutationDomain>(Parameters.Platform, Parameters.PermutationId);
+	}
+
+	static void ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
+	{
+		FGlobalShader::ModifyCompilationEnvironment(Parameters, OutEnvironment);
+
+		FPermutationDomain PermutationVector(Parameters.PermutationId);
+		Caustic::ModifyThreadGroupCompilationEnvironment((Caustic::EThreadGroupShape)PermutationVector.Get<Caustic::FThreadGroupShapeDim>(), OutEnvironment);
 	}
 
 	static bool ShouldCache(EShaderPlatform Platform)
@@ -57,16 +103,17 @@ public:
 	virtual bool Serialize(FArchive& Ar) override
 	{
 		bool bShaderHasOutdatedParameters = FGlobalShader::Serialize(Ar);
-		Ar << InputDepthTexture << OutputDepthTexture;
+		Ar << InputDepthTexture << OutputDepthTexture << DisplacementTexture;
 		return bShaderHasOutdatedParameters;
 	}
 
-	void BindShaderTextures(FRHICommandList& RHICmdList, FUnorderedAccessViewRHIRef OutputTextureUAV, FShaderResourceViewRHIRef InputTextureSRV)
+	void BindShaderTextures(FRHICommandList& RHICmdList, FUnorderedAccessViewRHIRef OutputTextureUAV, FShaderResourceViewRHIRef InputTextureSRV, FUnorderedAccessViewRHIRef DisplacementTextureUAV)
 	{
 		FRHIComputeShader* ComputeShaderRHI = GetComputeShader();
 
 		SetUAVParameter(RHICmdList, ComputeShaderRHI, OutputDepthTexture, OutputTextureUAV);
 		SetSRVParameter(RHICmdList, ComputeShaderRHI, InputDepthTexture, InputTextureSRV);
+		SetUAVParameter(RHICmdList, ComputeShaderRHI, DisplacementTexture, DisplacementTextureUAV);
 	}
 
 	void UnbindShaderTextures(FRHICommandList& RHICmdList)
@@ -75,6 +122,7 @@ public:
 
 		SetUAVParameter(RHICmdList, ComputeShaderRHI, OutputDepthTexture, FUnorderedAccessViewRHIRef());
 		SetSRVParameter(RHICmdList, ComputeShaderRHI, InputDepthTexture, FShaderResourceViewRHIRef());
+		SetUAVParameter(RHICmdList, ComputeShaderRHI, DisplacementTexture, FUnorderedAccessViewRHIRef());
 	}
 
 	void SetShaderParameters(FRHICommandList& RHICmdList, const FSurfaceDepthComputeShaderParameters& Parameters)
@@ -87,6 +135,7 @@ private:
 
 	FShaderResourceParameter InputDepthTexture;
 	FShaderResourceParameter OutputDepthTexture;
+	FShaderResourceParameter DisplacementTexture;
 };
 
 class FSurfaceHeightComputeShader : public FGlobalShader
@@ -95,20 +144,32 @@ class FSurfaceHeightComputeShader : public FGlobalShader
 
 public:
 
+	using FPermutationDomain = TShaderPermutationDomain<Caustic::FThreadGroupShapeDim, Caustic::FBoundaryModeDim, Caustic::FObstacleMaskDim, Caustic::FNinePointStencilDim>;
+
 	FSurfaceHeightComputeShader() {}
 	FSurfaceHeightComputeShader(const ShaderMetaType::CompiledShaderInitializerType& Initializer)
 		: FGlobalShader(Initializer)
 	{
 		CurDepthTexture.Bind(Initializer.ParameterMap, TEXT("CurDepthTexture"));
 		PrevDepthTexture.Bind(Initializer.ParameterMap, TEXT("PrevDepthTexture"));
+		NeighbourHeightTexture.Bind(Initializer.ParameterMap, TEXT("NeighbourHeightTexture"));
+		ObstacleMaskTexture.Bind(Initializer.ParameterMap, TEXT("ObstacleMaskTexture"));
 		OutputHeightTexture.Bind(Initializer.ParameterMap, TEXT("OutputHeightTexture"));
 	}
 
 	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
 	{
-		return IsFeatureLevelSupported(Parameters.Platform, ERHIFeatureLevel::SM5);
+		return IsFeatureLevelSupported(Parameters.Platform, ERHIFeatureLevel::SM5) && Caustic::ShouldCompileThreadGroupShape<FPermutationDomain>(Parameters.Platform, Parameters.PermutationId);
 	}
 	
+	static void ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
+	{
+		FGlobalShader::ModifyCompilationEnvironment(Parameters, OutEnvironment);
+
+		FPermutationDomain PermutationVector(Parameters.PermutationId);
+		Caustic::ModifyThreadGroupCompilationEnvironment((Caustic::EThreadGroupShape)PermutationVector.Get<Caustic::FThreadGroupShapeDim>(), OutEnvironment);
+	}
+
 	static bool ShouldCache(EShaderPlatform Platform)
 	{
 		return IsFeatureLevelSupported(Platform, ERHIFeatureLevel::SM5);
@@ -117,7 +178,7 @@ public:
 	virtual bool Serialize(FArchive& Ar) override
 	{
 		bool bShaderHasOutdatedParameters = FGlobalShader::Serialize(Ar);
-		Ar << OutputHeightTexture << CurDepthTexture << PrevDepthTexture;
+		Ar << OutputHeightTexture << CurDepthTexture << PrevDepthTexture << NeighbourHeightTexture << ObstacleMaskTexture;
 		return bShaderHasOutdatedParameters;
 	}
 
@@ -125,7 +186,9 @@ public:
 		FRHICommandList& RHICmdList,
 		FUnorderedAccessViewRHIRef OutputHeightTextureUAV,
 		FShaderResourceViewRHIRef CurDepthTextureSRV,
-		FShaderResourceViewRHIRef PrevDepthTextureSRV
+		FShaderResourceViewRHIRef PrevDepthTextureSRV,
+		FShaderResourceViewRHIRef NeighbourHeightTextureSRV,
+		FShaderResourceViewRHIRef ObstacleMaskTextureSRV
 	)
 	{
 		FRHIComputeShader* ComputeShaderRHI = GetComputeShader();
@@ -133,6 +196,8 @@ public:
 		SetUAVParameter(RHICmdList, ComputeShaderRHI, OutputHeightTexture, OutputHeightTextureUAV);
 		SetSRVParameter(RHICmdList, ComputeShaderRHI, CurDepthTexture, CurDepthTextureSRV);
 		SetSRVParameter(RHICmdList, ComputeShaderRHI, PrevDepthTexture, PrevDepthTextureSRV);
+		SetSRVParameter(RHICmdList, ComputeShaderRHI, NeighbourHeightTexture, NeighbourHeightTextureSRV);
+		SetSRVParameter(RHICmdList, ComputeShaderRHI, ObstacleMaskTexture, ObstacleMaskTextureSRV);
 	}
 
 	void UnbindShaderTextures(FRHICommandList& RHICmdList)
@@ -142,6 +207,8 @@ public:
 		SetUAVParameter(RHICmdList, ComputeShaderRHI, OutputHeightTexture, FUnorderedAccessViewRHIRef());
 		SetSRVParameter(RHICmdList, ComputeShaderRHI, CurDepthTexture, FShaderResourceViewRHIRef());
 		SetSRVParameter(RHICmdList, ComputeShaderRHI, PrevDepthTexture, FShaderResourceViewRHIRef());
+		SetSRVParameter(RHICmdList, ComputeShaderRHI, NeighbourHeightTexture, FShaderResourceViewRHIRef());
+		SetSRVParameter(RHICmdList, ComputeShaderRHI, ObstacleMaskTexture, FShaderResourceViewRHIRef());
 	}
 
 	void SetShaderParameters(FRHICommandList& RHICmdList, const FSurfaceHeightComputeShaderParameters& Parameters)
@@ -154,189 +221,896 @@ private:
 
 	FShaderResourceParameter CurDepthTexture;
 	FShaderResourceParameter PrevDepthTexture;
+	FShaderResourceParameter NeighbourHeightTexture;
+	FShaderResourceParameter ObstacleMaskTexture;
 	FShaderResourceParameter OutputHeightTexture;
 };
 
+class FSurfaceObstacleMaskComputeShader : public FGlobalShader
+{
+	DECLARE_GLOBAL_SHADER(FSurfaceObstacleMaskComputeShader);
+
+public:
+
+	using FPermutationDomain = TShaderPermutationDomain<Caustic::FThreadGroupShapeDim>;
+
+	FSurfaceObstacleMaskComputeShader() {}
+	FSurfaceObstacleMaskComputeShader(const ShaderMetaType::CompiledShaderInitializerType& Initializer)
+		: FGlobalShader(Initializer)
+	{
+		InputDepthTexture.Bind(Initializer.ParameterMap, TEXT("InputDepthTexture"));
+		OutputMaskTexture.Bind(Initializer.ParameterMap, TEXT("OutputMaskTexture"));
+	}
+
+	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
+	{
+		return IsFeatureLevelSupported(Parameters.Platform, ERHIFeatureLevel::SM5) && Caustic::ShouldCompileThreadGroupShape<FPermutationDomain>(Parameters.Platform, Parameters.PermutationId);
+	}
+
+	static void ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
+	{
+		FGlobalShader::ModifyCompilationEnvironment(Parameters, OutEnvironment);
+
+		FPermutationDomain PermutationVector(Parameters.PermutationId);
+		Caustic::ModifyThreadGroupCompilationEnvironment((Caustic::EThreadGroupShape)PermutationVector.Get<Caustic::FThreadGroupShapeDim>(), OutEnvironment);
+	}
+
+	virtual bool Serialize(FArchive& Ar) override
+	{
+		bool bShaderHasOutdatedParameters = FGlobalShader::Serialize(Ar);
+		Ar << InputDepthTexture << OutputMaskTexture;
+		return bShaderHasOutdatedParameters;
+	}
+
+	void BindShaderTextures(FRHICommandList& RHICmdList, FUnorderedAccessViewRHIRef OutputTextureUAV, FShaderResourceViewRHIRef InputTextureSRV)
+	{
+		FRHIComputeShader* ComputeShaderRHI = GetComputeShader();
+
+		SetUAVParameter(RHICmdList, ComputeShaderRHI, OutputMaskTexture, OutputTextureUAV);
+		SetSRVParameter(RHICmdList, ComputeShaderRHI, InputDepthTexture, InputTextureSRV);
+	}
+
+	void UnbindShaderTextures(FRHICommandList& RHICmdList)
+	{
+		FRHIComputeShader* ComputeShaderRHI = GetComputeShader();
+
+		SetUAVParameter(RHICmdList, ComputeShaderRHI, OutputMaskTexture, FUnorderedAccessViewRHIRef());
+		SetSRVParameter(RHICmdList, ComputeShaderRHI, InputDepthTexture, FShaderResourceViewRHIRef());
+	}
+
+	void SetShaderParameters(FRHICommandList& RHICmdList, const FSurfaceObstacleMaskComputeShaderParameters& Parameters)
+	{
+		FRHIComputeShader* ComputeShaderRHI = GetComputeShader();
+		SetUniformBufferParameterImmediate(RHICmdList, ComputeShaderRHI, GetUniformBufferParameter<FSurfaceObstacleMaskComputeShaderParameters>(), Parameters);
+	}
+
+private:
+
+	FShaderResourceParameter InputDepthTexture;
+	FShaderResourceParameter OutputMaskTexture;
+};
+
+static_assert(sizeof(FSurfaceImpulse) == 20, "FSurfaceImpulse must match the stride of the shader struct");
+
+class FSurfaceImpulseComputeShader : public FGlobalShader
+{
+	DECLARE_GLOBAL_SHADER(FSurfaceImpulseComputeShader);
+
+public:
+
+	using FPermutationDomain = TShaderPermutationDomain<Caustic::FThreadGroupShapeDim>;
+
+	FSurfaceImpulseComputeShader() {}
+	FSurfaceImpulseComputeShader(const ShaderMetaType::CompiledShaderInitializerType& Initializer)
+		: FGlobalShader(Initializer)
+	{
+		Impulses.Bind(Initializer.ParameterMap, TEXT("Impulses"));
+		ImpulseAccumulationTexture.Bind(Initializer.ParameterMap, TEXT("ImpulseAccumulationTexture"));
+	}
+
+	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
+	{
+		return IsFeatureLevelSupported(Parameters.Platform, ERHIFeatureLevel::SM5) && Caustic::ShouldCompileThreadGroupShape<FPermutationDomain>(Parameters.Platform, Parameters.PermutationId);
+	}
+
+	static void ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
+	{
+		FGlobalShader::ModifyCompilationEnvironment(Parameters, OutEnvironment);
+
+		FPermutationDomain PermutationVector(Parameters.PermutationId);
+		Caustic::ModifyThreadGroupCompilationEnvironment((Caustic::EThreadGroupShape)PermutationVector.Get<Caustic::FThreadGroupShapeDim>(), OutEnvironment);
+	}
+
+	virtual bool Serialize(FArchive& Ar) override
+	{
+		bool bShaderHasOutdatedParameters = FGlobalShader::Serialize(Ar);
+		Ar << Impulses << ImpulseAccumulationTexture;
+		return bShaderHasOutdatedParameters;
+	}
+
+	void BindShaderTextures(FRHICommandList& RHICmdList, FUnorderedAccessViewRHIRef AccumulationTextureUAV, FShaderResourceViewRHIRef ImpulseBufferSRV)
+	{
+		FRHIComputeShader* ComputeShaderRHI = GetComputeShader();
+
+		SetUAVParameter(RHICmdList, ComputeShaderRHI, ImpulseAccumulationTexture, AccumulationTextureUAV);
+		SetSRVParameter(RHICmdList, ComputeShaderRHI, Impulses, ImpulseBufferSRV);
+	}
+
+	void UnbindShaderTextures(FRHICommandList& RHICmdList)
+	{
+		FRHIComputeShader* ComputeShaderRHI = GetComputeShader();
+
+		SetUAVParameter(RHICmdList, ComputeShaderRHI, ImpulseAccumulationTexture, FUnorderedAccessViewRHIRef());
+		SetSRVParameter(RHICmdList, ComputeShaderRHI, Impulses, FShaderResourceViewRHIRef());
+	}
+
+	void SetShaderParameters(FRHICommandList& RHICmdList, const FSurfaceImpulseComputeShaderParameters& Parameters)
+	{
+		FRHIComputeShader* ComputeShaderRHI = GetComputeShader();
+		SetUniformBufferParameterImmediate(RHICmdList, ComputeShaderRHI, GetUniformBufferParameter<FSurfaceImpulseComputeShaderParameters>(), Parameters);
+	}
+
+private:
+
+	FShaderResourceParameter Impulses;
+	FShaderResourceParameter ImpulseAccumulationTexture;
+};
+
+class FSurfaceImpulseResolveComputeShader : public FGlobalShader
+{
+	DECLARE_GLOBAL_SHADER(FSurfaceImpulseResolveComputeShader);
+
+public:
+
+	using FPermutationDomain = TShaderPermutationDomain<Caustic::FThreadGroupShapeDim>;
+
+	FSurfaceImpulseResolveComputeShader() {}
+	FSurfaceImpulseResolveComputeShader(const ShaderMetaType::CompiledShaderInitializerType& Initializer)
+		: FGlobalShader(Initializer)
+	{
+		ImpulseAccumulationTexture.Bind(Initializer.ParameterMap, TEXT("ImpulseAccumulationTexture"));
+		OutputDepthTexture.Bind(Initializer.ParameterMap, TEXT("OutputDepthTexture"));
+	}
+
+	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
+	{
+		return IsFeatureLevelSupported(Parameters.Platform, ERHIFeatureLevel::SM5) && Caustic::ShouldCompileThreadGroupShape<FPermutationDomain>(Parameters.Platform, Parameters.PermutationId);
+	}
+
+	static void ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
+	{
+		FGlobalShader::ModifyCompilationEnvironment(Parameters, OutEnvironment);
+
+		FPermutationDomain PermutationVector(Parameters.PermutationId);
+		Caustic::ModifyThreadGroupCompilationEnvironment((Caustic::EThreadGroupShape)PermutationVector.Get<Caustic::FThreadGroupShapeDim>(), OutEnvironment);
+	}
+
+	virtual bool Serialize(FArchive& Ar) override
+	{
+		bool bShaderHasOutdatedParameters = FGlobalShader::Serialize(Ar);
+		Ar << ImpulseAccumulationTexture << OutputDepthTexture;
+		return bShaderHasOutdatedParameters;
+	}
+
+	void BindShaderTextures(FRHICommandList& RHICmdList, FUnorderedAccessViewRHIRef OutputTextureUAV, FUnorderedAccessViewRHIRef AccumulationTextureUAV)
+	{
+		FRHIComputeShader* ComputeShaderRHI = GetComputeShader();
+
+		SetUAVParameter(RHICmdList, ComputeShaderRHI, OutputDepthTexture, OutputTextureUAV);
+		SetUAVParameter(RHICmdList, ComputeShaderRHI, ImpulseAccumulationTexture, AccumulationTextureUAV);
+	}
+
+	void UnbindShaderTextures(FRHICommandList& RHICmdList)
+	{
+		FRHIComputeShader* ComputeShaderRHI = GetComputeShader();
+
+		SetUAVParameter(RHICmdList, ComputeShaderRHI, OutputDepthTexture, FUnorderedAccessViewRHIRef());
+		SetUAVParameter(RHICmdList, ComputeShaderRHI, ImpulseAccumulationTexture, FUnorderedAccessViewRHIRef());
+	}
+
+private:
+
+	FShaderResourceParameter ImpulseAccumulationTexture;
+	FShaderResourceParameter OutputDepthTexture;
+};
+
+static_assert(sizeof(FSurfaceDepthProxy) == 64, "FSurfaceDepthProxy must match the stride of the shader struct");
+
+class FSurfaceProxyDepthComputeShader : public FGlobalShader
+{
+	DECLARE_GLOBAL_SHADER(FSurfaceProxyDepthComputeShader);
+
+public:
+
+	using FPermutationDomain = TShaderPermutationDomain<Caustic::FThreadGroupShapeDim>;
+
+	FSurfaceProxyDepthComputeShader() {}
+	FSurfaceProxyDepthComputeShader(const ShaderMetaType::CompiledShaderInitializerType& Initializer)
+		: FGlobalShader(Initializer)
+	{
+		DepthProxies.Bind(Initializer.ParameterMap, TEXT("DepthProxies"));
+		OutputProxyDepthTexture.Bind(Initializer.ParameterMap, TEXT("OutputProxyDepthTexture"));
+		MeshDepthTexture.Bind(Initializer.ParameterMap, TEXT("MeshDepthTexture"));
+	}
+
+	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
+	{
+		return IsFeatureLevelSupported(Parameters.Platform, ERHIFeatureLevel::SM5) && Caustic::ShouldCompileThreadGroupShape<FPermutationDomain>(Parameters.Platform, Parameters.PermutationId);
+	}
+
+	static void ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
+	{
+		FGlobalShader::ModifyCompilationEnvironment(Parameters, OutEnvironment);
+
+		FPermutationDomain PermutationVector(Parameters.PermutationId);
+		Caustic::ModifyThreadGroupCompilationEnvironment((Caustic::EThreadGroupShape)PermutationVector.Get<Caustic::FThreadGroupShapeDim>(), OutEnvironment);
+	}
+
+	virtual bool Serialize(FArchive& Ar) override
+	{
+		bool bShaderHasOutdatedParameters = FGlobalShader::Serialize(Ar);
+		Ar << DepthProxies << OutputProxyDepthTexture << MeshDepthTexture;
+		return bShaderHasOutdatedParameters;
+	}
+
+	void BindShaderTextures(FRHICommandList& RHICmdList, FUnorderedAccessViewRHIRef OutputTextureUAV, FShaderResourceViewRHIRef ProxyBufferSRV, FShaderResourceViewRHIRef MeshDepthSRV)
+	{
+		FRHIComputeShader* ComputeShaderRHI = GetComputeShader();
+
+		SetUAVParameter(RHICmdList, ComputeShaderRHI, OutputProxyDepthTexture, OutputTextureUAV);
+		SetSRVParameter(RHICmdList, ComputeShaderRHI, DepthProxies, ProxyBufferSRV);
+		SetSRVParameter(RHICmdList, ComputeShaderRHI, MeshDepthTexture, MeshDepthSRV);
+	}
+
+	void UnbindShaderTextures(FRHICommandList& RHICmdList)
+	{
+		FRHIComputeShader* ComputeShaderRHI = GetComputeShader();
+
+		SetUAVParameter(RHICmdList, ComputeShaderRHI, OutputProxyDepthTexture, FUnorderedAccessViewRHIRef());
+		SetSRVParameter(RHICmdList, ComputeShaderRHI, DepthProxies, FShaderResourceViewRHIRef());
+		SetSRVParameter(RHICmdList, ComputeShaderRHI, MeshDepthTexture, FShaderResourceViewRHIRef());
+	}
+
+	void SetShaderParameters(FRHICommandList& RHICmdList, const FSurfaceProxyDepthComputeShaderParameters& Parameters)
+	{
+		FRHIComputeShader* ComputeShaderRHI = GetComputeShader();
+		SetUniformBufferParameterImmediate(RHICmdList, ComputeShaderRHI, GetUniformBufferParameter<FSurfaceProxyDepthComputeShaderParameters>(), Parameters);
+	}
+
+private:
+
+	FShaderResourceParameter DepthProxies;
+	FShaderResourceParameter OutputProxyDepthTexture;
+};
+
 IMPLEMENT_SHADER_TYPE(, FSurfaceDepthComputeShader, TEXT("/Plugin/Caustic/SurfaceDepthComputeShader.usf"), TEXT("ComputeSurfaceDepth"), SF_Compute);
 IMPLEMENT_SHADER_TYPE(, FSurfaceHeightComputeShader, TEXT("/Plugin/Caustic/SurfaceHeightComputeShader.usf"), TEXT("ComputeSurfaceHeight"), SF_Compute);
+IMPLEMENT_SHADER_TYPE(, FSurfaceObstacleMaskComputeShader, TEXT("/Plugin/Caustic/SurfaceDepthComputeShader.usf"), TEXT("ComputeObstacleMask"), SF_Compute);
+IMPLEMENT_SHADER_TYPE(, FSurfaceImpulseComputeShader, TEXT("/Plugin/Caustic/SurfaceDepthComputeShader.usf"), TEXT("ComputeSurfaceImpulse"), SF_Compute);
+IMPLEMENT_SHADER_TYPE(, FSurfaceImpulseResolveComputeShader, TEXT("/Plugin/Caustic/SurfaceDepthComputeShader.usf"), TEXT("ComputeSurfaceImpulseResolve"), SF_Compute);
+IMPLEMENT_SHADER_TYPE(, FSurfaceProxyDepthComputeShader, TEXT("/Plugin/Caustic/SurfaceDepthComputeShader.usf"), TEXT("ComputeProxyDepth"), SF_Compute);
 
-FSurfaceDepthPassRenderer::FSurfaceDepthPassRenderer() :
-	bInitiated(false)
+static int32 GetHeightShaderIndex(int32 BoundaryMode, bool bObstacleMask, bool bNinePointStencil)
 {
+	return (BoundaryMode * 2 + (bObstacleMask ? 1 : 0)) * 2 + (bNinePointStencil ? 1 : 0);
+}
 
+FSurfaceDepthPassRenderer::FSurfaceDepthPassRenderer() :
+	SurfaceObstacleMaskComputeShader(nullptr),
+	SurfaceImpulseComputeShader(nullptr),
+	SurfaceImpulseResolveComputeShader(nullptr),
+	SurfaceProxyDepthComputeShader(nullptr),
+	SurfaceMeshDepthVertexShader(nullptr),
+	SurfaceMeshDepthPixelShader(nullptr),
+	ThreadGroupShape(Caustic::EThreadGroupShape::Group8x8),
+	ImpulseCapacity(0),
+	ProxyCapacity(0),
+	bInitiated(false),
+	bResourcesReady(false),
+	bHasObstacleMask(false),
+	bHasDisplacement(false)
+{
+	FMemory::Memzero(SurfaceDepthComputeShaders);
+	FMemory::Memzero(SurfaceHeightComputeShaders);
 }
 
 FSurfaceDepthPassRenderer::~FSurfaceDepthPassRenderer()
 {
-	SafeReleaseTextureResource(InputDepthTexture);
-	SafeReleaseTextureResource(InputDepthTextureSRV);
-	SafeReleaseTextureResource(OutputDepthTexture);
-	SafeReleaseTextureResource(OutputDepthTextureUAV);
-	SafeReleaseTextureResource(OutputDepthTextureSRV);
-	SafeReleaseTextureResource(OutputHeightTexture);
-	SafeReleaseTextureResource(OutputHeightTextureUAV);
-	SafeReleaseTextureResource(OutputHeightTextureSRV);
-	SafeReleaseTextureResource(PrevDepthTexture);
-	SafeReleaseTextureResource(PrevDepthTextureSRV);
+	ReleasePassResources();
+}
+
+/** Bytes UploadStructuredBuffer grows a buffer to for Count elements */
+static uint64 GetStructuredBufferSize(uint32 Count, uint32 Stride)
+{
+	return (Count > 0) ? (uint64)FMath::RoundUpToPowerOfTwo(FMath::Max<uint32>(Count, 64)) * Stride : 0;
+}
+
+uint64 FSurfaceDepthPassRenderer::GetMemorySize(const FSurfaceDepthPassConfig& InConfig)
+{
+	// Height, depth, previous frame and solver scratch, plus the captured depth, the obstacle mask and the displaced volume
+	const uint64 FloatRGBASize = Caustic::GetTextureMemorySize(InConfig.TextureWidth, InConfig.TextureHeight, PF_FloatRGBA);
+	const uint64 R16FSize = Caustic::GetTextureMemorySize(InConfig.TextureWidth, InConfig.TextureHeight, PF_R16F);
+	const uint64 AccumulationSize = Caustic::GetTextureMemorySize(InConfig.TextureWidth, InConfig.TextureHeight, PF_R32_SINT);
+
+	// The impulse and proxy buffers grow on demand, they are counted at the largest size the caps let them reach
+	const uint64 BufferSize =
+		GetStructuredBufferSize(InConfig.MaxImpulses, sizeof(FSurfaceImpulse)) +
+		GetStructuredBufferSize(InConfig.MaxDepthProxies, sizeof(FSurfaceDepthProxy));
+
+	// Bodies that rasterize meshes add a colour and a depth target at the simulation size
+	const uint64 MeshDepthSize = InConfig.bMeshDepth ?
+		R16FSize + Caustic::GetTextureMemorySize(InConfig.TextureWidth, InConfig.TextureHeight, PF_DepthStencil) : 0;
+
+	return FloatRGBASize * 4 + R16FSize * 3 + AccumulationSize + BufferSize + MeshDepthSize;
 }
 
 void FSurfaceDepthPassRenderer::InitPass(const FSurfaceDepthPassConfig& InConfig)
 {
 	if (!bInitiated)
 	{
-		FRHIResourceCreateInfo CreateInfo;
-		uint32 TextureWidth = InConfig.TextureWidth;
-		uint32 TextureHeight = InConfig.TextureHeight;
+		Config = InConfig;
+		bInitiated = true;
+
+		// RHI resources are created on the render thread so BeginPlay never blocks on them
+		ENQUEUE_RENDER_COMMAND(SurfaceDepthPassInitCommand)
+		(
+			[Renderer = AsShared()](FRHICommandListImmediate& RHICmdList)
+			{
+				Renderer->InitPass_RenderThread(RHICmdList);
+			}
+		);
+	}
+}
 
-		OutputDepthTexture = RHICreateTexture2D(TextureWidth, TextureHeight, PF_FloatRGBA, 1, 1, TexCreate_ShaderResource | TexCreate_UAV, CreateInfo);
-		OutputDepthTextureUAV = RHICreateUnorderedAccessView(OutputDepthTexture);
-		OutputDepthTextureSRV = RHICreateShaderResourceView(OutputDepthTexture, 0);
+void FSurfaceDepthPassRenderer::InitPass_RenderThread(FRHICommandListImmediate& RHICmdList)
+{
+	check(IsInRenderingThread());
+
+	FCausticResourcePool& Pool = FCausticResourcePool::Get();
+	uint32 TextureWidth = Config.TextureWidth;
+	uint32 TextureHeight = Config.TextureHeight;
 
-		OutputHeightTexture = RHICreateTexture2D(TextureWidth, TextureHeight, PF_FloatRGBA, 1, 1, TexCreate_ShaderResource | TexCreate_UAV, CreateInfo);
-		OutputHeightTextureUAV = RHICreateUnorderedAccessView(OutputHeightTexture);
-		OutputHeightTextureSRV = RHICreateShaderResourceView(OutputHeightTexture, 0);
-		
-		InputDepthTexture = RHICreateTexture2D(TextureWidth, TextureHeight, PF_R16F, 1, 1, TexCreate_ShaderResource, CreateInfo);
-		InputDepthTextureSRV = RHICreateShaderResourceView(InputDepthTexture, 0);
+	OutputDepth = Pool.AcquireTexture(TextureWidth, TextureHeight, PF_FloatRGBA, TexCreate_ShaderResource | TexCreate_UAV);
+	OutputHeight = Pool.AcquireTexture(TextureWidth, TextureHeight, PF_FloatRGBA, TexCreate_ShaderResource | TexCreate_UAV);
+	InputDepth = Pool.AcquireTexture(TextureWidth, TextureHeight, PF_R16F, TexCreate_ShaderResource | TexCreate_UAV);
+	PrevDepth = Pool.AcquireTexture(TextureWidth, TextureHeight, PF_FloatRGBA, TexCreate_ShaderResource);
+	SolverScratch = Pool.AcquireTexture(TextureWidth, TextureHeight, PF_FloatRGBA, TexCreate_ShaderResource | TexCreate_UAV);
+	ObstacleMask = Pool.AcquireTexture(TextureWidth, TextureHeight, PF_R16F, TexCreate_ShaderResource | TexCreate_UAV);
+	Displacement = Pool.AcquireTexture(TextureWidth, TextureHeight, PF_R16F, TexCreate_ShaderResource | TexCreate_UAV);
+	ImpulseAccumulation = Pool.AcquireTexture(TextureWidth, TextureHeight, PF_R32_SINT, TexCreate_ShaderResource | TexCreate_UAV);
 
-		PrevDepthTexture =  RHICreateTexture2D(TextureWidth, TextureHeight, PF_FloatRGBA, 1, 1, TexCreate_ShaderResource, CreateInfo);
-		PrevDepthTextureSRV = RHICreateShaderResourceView(PrevDepthTexture, 0);
+	if (Config.bMeshDepth)
+	{
+		MeshDepth = Pool.AcquireTexture(TextureWidth, TextureHeight, PF_R16F, TexCreate_ShaderResource | TexCreate_RenderTargetable);
+		MeshDepthStencil = Pool.AcquireTexture(TextureWidth, TextureHeight, PF_DepthStencil, TexCreate_DepthStencilTargetable);
+	}
 
-		DepthDebugTextureRHIRef = Caustic::GetRHITextureFromRenderTarget(InConfig.DepthDebugTextureRef);
-		HeightDebugTextureRHIRef = Caustic::GetRHITextureFromRenderTarget(InConfig.HeightDebugTextureRef);
+	// Pooled textures still hold the height field of their previous owner
+	ClearUAV(RHICmdList, OutputDepth.Texture, OutputDepth.UAV, FLinearColor::Transparent);
+	ClearUAV(RHICmdList, OutputHeight.Texture, OutputHeight.UAV, FLinearColor::Transparent);
+	ClearUAV(RHICmdList, ObstacleMask.Texture, ObstacleMask.UAV, FLinearColor::Transparent);
+	ClearUAV(RHICmdList, Displacement.Texture, Displacement.UAV, FLinearColor::Transparent);
+	const uint32 ZeroAccumulation[4] = { 0, 0, 0, 0 };
+	ClearUAV(RHICmdList, ImpulseAccumulation.Texture, ImpulseAccumulation.UAV, ZeroAccumulation);
+	bHasObstacleMask = false;
+	bHasDisplacement = false;
+	FRHICopyTextureInfo CopyInfo;
+	RHICmdList.CopyTexture(OutputDepth.Texture, PrevDepth.Texture, CopyInfo);
 
-		Config = InConfig;
+	// Resolve the shaders once instead of looking them up every frame
+	ThreadGroupShape = Caustic::GetThreadGroupShape(GMaxRHIShaderPlatform);
+	TShaderMap<FGlobalShaderType>* GlobalShaderMap = GetGlobalShaderMap(ERHIFeatureLevel::SM5);
 
-		bInitiated = true;
+	for (int32 InteractionForce = 0; InteractionForce < (int32)ECausticInteractionForce::MAX; ++InteractionForce)
+	{
+		FSurfaceDepthComputeShader::FPermutationDomain DepthPermutationVector;
+		DepthPermutationVector.Set<Caustic::FThreadGroupShapeDim>((int32)ThreadGroupShape);
+		DepthPermutationVector.Set<Caustic::FDisplacedVolumeDim>(InteractionForce == (int32)ECausticInteractionForce::DisplacedVolume);
+		SurfaceDepthComputeShaders[InteractionForce] = *TShaderMapRef<FSurfaceDepthComputeShader>(GlobalShaderMap, DepthPermutationVector);
+	}
+
+	// The remaining depth stage shaders only vary by thread group shape
+	FSurfaceObstacleMaskComputeShader::FPermutationDomain ShapePermutationVector;
+	ShapePermutationVector.Set<Caustic::FThreadGroupShapeDim>((int32)ThreadGroupShape);
+	SurfaceObstacleMaskComputeShader = *TShaderMapRef<FSurfaceObstacleMaskComputeShader>(GlobalShaderMap, ShapePermutationVector);
+	SurfaceImpulseComputeShader = *TShaderMapRef<FSurfaceImpulseComputeShader>(GlobalShaderMap, ShapePermutationVector);
+	SurfaceImpulseResolveComputeShader = *TShaderMapRef<FSurfaceImpulseResolveComputeShader>(GlobalShaderMap, ShapePermutationVector);
+	SurfaceProxyDepthComputeShader = *TShaderMapRef<FSurfaceProxyDepthComputeShader>(GlobalShaderMap, ShapePermutationVector);
+	SurfaceMeshDepthVertexShader = *TShaderMapRef<FSurfaceMeshDepthVS>(GlobalShaderMap);
+	SurfaceMeshDepthPixelShader = *TShaderMapRef<FSurfaceMeshDepthPS>(GlobalShaderMap);
+
+	// Boundary mode and solver can change at runtime and the mask is baked later, so every combination is resolved up front
+	for (int32 BoundaryMode = 0; BoundaryMode < (int32)ECausticBoundaryMode::MAX; ++BoundaryMode)
+	{
+		for (bool bObstacleMask : { false, true })
+		{
+			for (bool bNinePointStencil : { false, true })
+			{
+				FSurfaceHeightComputeShader::FPermutationDomain HeightPermutationVector;
+				HeightPermutationVector.Set<Caustic::FThreadGroupShapeDim>((int32)ThreadGroupShape);
+				HeightPermutationVector.Set<Caustic::FBoundaryModeDim>(BoundaryMode);
+				HeightPermutationVector.Set<Caustic::FObstacleMaskDim>(bObstacleMask);
+				HeightPermutationVector.Set<Caustic::FNinePointStencilDim>(bNinePointStencil);
+
+				const int32 ShaderIndex = GetHeightShaderIndex(BoundaryMode, bObstacleMask, bNinePointStencil);
+				SurfaceHeightComputeShaders[ShaderIndex] = *TShaderMapRef<FSurfaceHeightComputeShader>(GlobalShaderMap, HeightPermutationVector);
+			}
+		}
 	}
+
+	bResourcesReady = true;
 }
 
-void FSurfaceDepthPassRenderer::Render(const FLiquidParam& LiquidParam, FRHITexture* DepthTextureRef)
+void FSurfaceDepthPassRenderer::ReleasePass()
 {
-	if (IsValidPass())
+	if (bInitiated)
 	{
-		ENQUEUE_RENDER_COMMAND(SurfaceDepthPassCommand)
+		bInitiated = false;
+		bResourcesReady = false;
+
+		ENQUEUE_RENDER_COMMAND(SurfaceDepthPassReleaseCommand)
 		(
-			[&LiquidParam, DepthTextureRef, this](FRHICommandListImmediate& RHICmdList)
+			[Renderer = AsShared()](FRHICommandListImmediate& RHICmdList)
 			{
-				check(IsInRenderingThread());
-
-				RenderSurfaceDepthPass(RHICmdList, LiquidParam, DepthTextureRef);
-				RenderSurfaceHeightPass(RHICmdList, LiquidParam);
+				Renderer->ReleasePassResources();
 			}
 		);
 	}
 }
 
+void FSurfaceDepthPassRenderer::ReleasePassResources()
+{
+	FCausticResourcePool& Pool = FCausticResourcePool::Get();
+	Pool.ReleaseTexture(OutputDepth);
+	Pool.ReleaseTexture(OutputHeight);
+	Pool.ReleaseTexture(InputDepth);
+	Pool.ReleaseTexture(PrevDepth);
+	Pool.ReleaseTexture(SolverScratch);
+	Pool.ReleaseTexture(ObstacleMask);
+	Pool.ReleaseTexture(Displacement);
+	Pool.ReleaseTexture(ImpulseAccumulation);
+	Pool.ReleaseTexture(MeshDepth);
+	Pool.ReleaseTexture(MeshDepthStencil);
+
+	ReleaseStructuredBuffer(ImpulseBuffer, ImpulseBufferSRV, ImpulseCapacity, sizeof(FSurfaceImpulse));
+	ReleaseStructuredBuffer(ProxyBuffer, ProxyBufferSRV, ProxyCapacity, sizeof(FSurfaceDepthProxy));
+}
+
+void FSurfaceDepthPassRenderer::UploadStructuredBuffer(FStructuredBufferRHIRef& Buffer, FShaderResourceViewRHIRef& BufferSRV, uint32& Capacity, const void* Data, uint32 Stride, uint32 Count)
+{
+	// Grow in powers of two so a rain burst or a crowd entering the water does not recreate the buffer every frame
+	if (Count > Capacity)
+	{
+		ReleaseStructuredBuffer(Buffer, BufferSRV, Capacity, Stride);
+		Capacity = FMath::RoundUpToPowerOfTwo(FMath::Max<uint32>(Count, 64));
+
+		CAUSTIC_LLM_SCOPE();
+		INC_MEMORY_STAT_BY(STAT_CausticBufferMemory, Capacity * Stride);
+
+		FRHIResourceCreateInfo CreateInfo;
+		Buffer = RHICreateStructuredBuffer(Stride, Capacity * Stride, BUF_ShaderResource | BUF_Dynamic, CreateInfo);
+		BufferSRV = RHICreateShaderResourceView(Buffer);
+	}
+
+	const uint32 UploadSize = Count * Stride;
+	void* BufferData = RHILockStructuredBuffer(Buffer, 0, UploadSize, RLM_WriteOnly);
+	FMemory::Memcpy(BufferData, Data, UploadSize);
+	RHIUnlockStructuredBuffer(Buffer);
+}
+
+void FSurfaceDepthPassRenderer::ReleaseStructuredBuffer(FStructuredBufferRHIRef& Buffer, FShaderResourceViewRHIRef& BufferSRV, uint32& Capacity, uint32 Stride)
+{
+	if (Buffer.IsValid())
+	{
+		DEC_MEMORY_STAT_BY(STAT_CausticBufferMemory, Capacity * Stride);
+		BufferSRV.SafeRelease();
+		Buffer.SafeRelease();
+	}
+
+	Capacity = 0;
+}
+
 bool FSurfaceDepthPassRenderer::IsValidPass() const
 {
-	bool bValid = !!InputDepthTexture;
-	bValid &= !!InputDepthTextureSRV;
-	bValid &= !!OutputDepthTexture;
-	bValid &= !!OutputDepthTextureUAV;
-	bValid &= !!OutputDepthTextureSRV;
-	bValid &= !!OutputHeightTexture;
-	bValid &= !!OutputHeightTextureUAV;
-	bValid &= !!OutputHeightTextureSRV;
-	bValid &= !!PrevDepthTexture;
-	bValid &= !!PrevDepthTextureSRV;
+	bool bValid = SurfaceObstacleMaskComputeShader && SurfaceImpulseComputeShader && SurfaceImpulseResolveComputeShader && SurfaceProxyDepthComputeShader;
+	bValid &= SurfaceMeshDepthVertexShader && SurfaceMeshDepthPixelShader;
+	for (const FSurfaceDepthComputeShader* SurfaceDepthComputeShader : SurfaceDepthComputeShaders)
+	{
+		bValid &= SurfaceDepthComputeShader != nullptr;
+	}
+	for (const FSurfaceHeightComputeShader* SurfaceHeightComputeShader : SurfaceHeightComputeShaders)
+	{
+		bValid &= SurfaceHeightComputeShader != nullptr;
+	}
+	bValid &= InputDepth.IsValid();
+	bValid &= OutputDepth.IsValid();
+	bValid &= OutputHeight.IsValid();
+	bValid &= PrevDepth.IsValid();
+	bValid &= SolverScratch.IsValid();
+	bValid &= ObstacleMask.IsValid();
+	bValid &= Displacement.IsValid();
+	bValid &= ImpulseAccumulation.IsValid();
+	bValid &= !Config.bMeshDepth || (MeshDepth.IsValid() && MeshDepthStencil.IsValid());
 
 	return bValid;
 }
 
-void FSurfaceDepthPassRenderer::RenderSurfaceDepthPass(FRHICommandListImmediate& RHICmdList, const FLiquidParam& LiquidParam, FRHITexture* DepthTextureRef)
+void FSurfaceDepthPassRenderer::RenderObstacleMaskPass(FRHICommandListImmediate& RHICmdList, FRHITexture* MaskDepthTextureRef, float ObstacleDepth)
 {
-	// Copy depth texture
+	SCOPED_DRAW_EVENT(RHICmdList, SurfaceObstacleMaskPass);
+
+	// The captured scene depth goes through the same staging texture as the interaction depth
 	FRHICopyTextureInfo CopyInfo;
-	RHICmdList.CopyTexture(DepthTextureRef, InputDepthTexture, CopyInfo);
+	RHICmdList.CopyTexture(MaskDepthTextureRef, InputDepth.Texture, CopyInfo);
+
+	// Bind shader textures
+	RHICmdList.SetComputeShader(SurfaceObstacleMaskComputeShader->GetComputeShader());
+	SurfaceObstacleMaskComputeShader->BindShaderTextures(RHICmdList, ObstacleMask.UAV, InputDepth.SRV);
+
+	// Bind shader uniform
+	FSurfaceObstacleMaskComputeShaderParameters UniformParam;
+	UniformParam.ObstacleDepth = ObstacleDepth;
+	SurfaceObstacleMaskComputeShader->SetShaderParameters(RHICmdList, UniformParam);
+
+	// Dispatch shader
+	const FIntVector GroupCount = Caustic::GetGroupCount(Config.TextureWidth, Config.TextureHeight, ThreadGroupShape);
+	DispatchComputeShader(RHICmdList, SurfaceObstacleMaskComputeShader, GroupCount.X, GroupCount.Y, GroupCount.Z);
+
+	// Unbind shader textures
+	SurfaceObstacleMaskComputeShader->UnbindShaderTextures(RHICmdList);
+
+	bHasObstacleMask = true;
+}
+
+void FSurfaceDepthPassRenderer::RenderMeshDepthPass(FRHICommandListImmediate& RHICmdList, const TArray<FSurfaceDepthMesh>& Meshes, const FVector2D& BodySize)
+{
+	check(Config.bMeshDepth);
+
+	SCOPED_DRAW_EVENT(RHICmdList, SurfaceMeshDepthPass);
+
+	FRHIRenderPassInfo PassInfo(MeshDepth.Texture, ERenderTargetActions::DontLoad_Store, MeshDepthStencil.Texture, EDepthStencilTargetActions::DontLoad_DontStore);
+
+	RHICmdList.BeginRenderPass(PassInfo, TEXT("SurfaceMeshDepthPass"));
+	{
+		// Update viewport
+		RHICmdList.SetViewport(
+			0.f, 0.f, 0.f,
+			Config.TextureWidth, Config.TextureHeight, 1.f
+		);
+
+		// Texels no mesh covers read as a miss, past the largest depth like an empty proxy trace
+		DrawClearQuad(RHICmdList, true, FLinearColor(65504.0f, 0.0f, 0.0f, 0.0f), true, 1.0f, false, 0);
+
+		FVertexDeclarationElementList Elements;
+		Elements.Add(FVertexElement(0, 0, VET_Float3, 0, sizeof(FVector)));
+		FRHIVertexDeclaration* VertexDeclarationRHI = PipelineStateCache::GetOrCreateVertexDeclaration(Elements);
+
+		FSurfaceMeshDepthShaderParameters UniformParam;
+		UniformParam.InvHalfBodySize = FVector2D(2.0f / FMath::Max(BodySize.X, 1.0f), 2.0f / FMath::Max(BodySize.Y, 1.0f));
+		UniformParam.InvMaxDepth = 1.0f / FMath::Max(Config.MaxDepth, 1.0f);
+
+		// Faces looking up write their depth and faces looking down write 0, the shared depth test keeps whichever is nearest
+		for (bool bFacingUp : { true, false })
+		{
+			UniformParam.FacingScale = bFacingUp ? 1.0f : 0.0f;
+
+			for (const FSurfaceDepthMesh& Mesh : Meshes)
+			{
+				const FStaticMeshLODResources& LODResources = Mesh.RenderData->LODResources[Mesh.LODIndex];
+				const FPositionVertexBuffer& PositionBuffer = LODResources.VertexBuffers.PositionVertexBuffer;
+
+				// The depth only buffer welds the vertices that only differ by their UVs or normals
+				const FRawStaticIndexBuffer& IndexBuffer = (LODResources.DepthOnlyIndexBuffer.GetNumIndices() > 0) ? LODResources.DepthOnlyIndexBuffer : LODResources.IndexBuffer;
+
+				// Render data the mesh has not initialized yet is skipped for this step
+				if (!PositionBuffer.VertexBufferRHI.IsValid() || !IndexBuffer.IndexBufferRHI.IsValid())
+				{
+					continue;
+				}
+
+				// Outward faces of a mesh turn counter clockwise on screen from above, a mirroring transform flips them
+				const bool bCullClockwise = bFacingUp != (Mesh.LocalToSurface.Determinant() < 0.0f);
+
+				// Set the graphic pipeline state
+				FGraphicsPipelineStateInitializer GraphicsPSOInit;
+				RHICmdList.ApplyCachedRenderTargets(GraphicsPSOInit);
+				GraphicsPSOInit.DepthStencilState = TStaticDepthStencilState<true, CF_Less>::GetRHI();
+				GraphicsPSOInit.BlendState = TStaticBlendState<>::GetRHI();
+				GraphicsPSOInit.RasterizerState = bCullClockwise ? TStaticRasterizerState<FM_Solid, CM_CW>::GetRHI() : TStaticRasterizerState<FM_Solid, CM_CCW>::GetRHI();
+				GraphicsPSOInit.PrimitiveType = PT_TriangleList;
+				GraphicsPSOInit.BoundShaderState.VertexDeclarationRHI = VertexDeclarationRHI;
+				GraphicsPSOInit.BoundShaderState.VertexShaderRHI = GETSAFERHISHADER_VERTEX(SurfaceMeshDepthVertexShader);
+				GraphicsPSOInit.BoundShaderState.PixelShaderRHI = GETSAFERHISHADER_PIXEL(SurfaceMeshDepthPixelShader);
+				SetGraphicsPipelineState(RHICmdList, GraphicsPSOInit);
+
+				// Bind shader uniform
+				UniformParam.LocalToSurface = Mesh.LocalToSurface;
+				SurfaceMeshDepthVertexShader->SetShaderParameters(RHICmdList, UniformParam);
+				SurfaceMeshDepthPixelShader->SetShaderParameters(RHICmdList, UniformParam);
+
+				// Draw every section at once, the materials do not matter to the depth
+				RHICmdList.SetStreamSource(0, PositionBuffer.VertexBufferRHI, 0);
+				RHICmdList.DrawIndexedPrimitive(
+					IndexBuffer.IndexBufferRHI,
+					0, // BaseVertexIndex
+					0, // MinIndex
+					PositionBuffer.GetNumVertices(), // NumVertices
+					0, // StartIndex
+					IndexBuffer.GetNumIndices() / 3, // NumPrimitives
+					1  // NumInstances
+				);
+			}
+		}
+	}
+
+	RHICmdList.EndRenderPass();
+
+	RHICmdList.TransitionResource(EResourceTransitionAccess::EReadable, MeshDepth.Texture);
+}
+
+void FSurfaceDepthPassRenderer::RenderProxyDepthPass(FRHICommandListImmediate& RHICmdList, const TArray<FSurfaceDepthProxy>& Proxies, const FVector2D& BodySize, bool bMergeMeshDepth)
+{
+	SCOPED_DRAW_EVENT(RHICmdList, SurfaceProxyDepthPass);
+
+	// With only meshes to draw the dispatch just copies the mesh depth over
+	const uint32 ProxyCount = Proxies.Num();
+	if (ProxyCount > 0)
+	{
+		UploadStructuredBuffer(ProxyBuffer, ProxyBufferSRV, ProxyCapacity, Proxies.GetData(), sizeof(FSurfaceDepthProxy), ProxyCount);
+	}
+
+	// Bind shader textures
+	RHICmdList.SetComputeShader(SurfaceProxyDepthComputeShader->GetComputeShader());
+	SurfaceProxyDepthComputeShader->BindShaderTextures(RHICmdList, InputDepth.UAV, ProxyBufferSRV, bMergeMeshDepth ? MeshDepth.SRV : FShaderResourceViewRHIRef());
+
+	// Bind shader uniform
+	FSurfaceProxyDepthComputeShaderParameters UniformParam;
+	UniformParam.BodySize = BodySize;
+	UniformParam.ProxyCount = ProxyCount;
+	UniformParam.MergeMeshDepth = bMergeMeshDepth ? 1 : 0;
+	SurfaceProxyDepthComputeShader->SetShaderParameters(RHICmdList, UniformParam);
+
+	// Dispatch shader
+	const FIntVector GroupCount = Caustic::GetGroupCount(Config.TextureWidth, Config.TextureHeight, ThreadGroupShape);
+	DispatchComputeShader(RHICmdList, SurfaceProxyDepthComputeShader, GroupCount.X, GroupCount.Y, GroupCount.Z);
+
+	// Unbind shader textures
+	SurfaceProxyDepthComputeShader->UnbindShaderTextures(RHICmdList);
+}
+
+void FSurfaceDepthPassRenderer::RenderSurfaceDepthPass(FRHICommandListImmediate& RHICmdList, const FCausticFrameParams& Params, FRHITexture* DepthTextureRef)
+{
+	SCOPED_DRAW_EVENT(RHICmdList, SurfaceDepthPass);
+
+	// Copy depth texture, the proxy pass already wrote it in place
+	if (DepthTextureRef)
+	{
+		FRHICopyTextureInfo CopyInfo;
+		RHICmdList.CopyTexture(DepthTextureRef, InputDepth.Texture, CopyInfo);
+	}
+	else
+	{
+		RHICmdList.TransitionResource(EResourceTransitionAccess::EReadable, EResourceTransitionPipeline::EComputeToCompute, InputDepth.UAV);
+	}
+
+	const bool bDisplacedVolume = Params.InteractionForce == ECausticInteractionForce::DisplacedVolume;
+	FSurfaceDepthComputeShader* SurfaceDepthComputeShader = SurfaceDepthComputeShaders[(int32)Params.InteractionForce];
 
 	// Bind shader textures
-	TShaderMapRef<FSurfaceDepthComputeShader> SurfaceDepthComputeShader(GetGlobalShaderMap(ERHIFeatureLevel::SM5));
 	RHICmdList.SetComputeShader(SurfaceDepthComputeShader->GetComputeShader());
-	SurfaceDepthComputeShader->BindShaderTextures(RHICmdList, OutputDepthTextureUAV, InputDepthTextureSRV);
+	SurfaceDepthComputeShader->BindShaderTextures(RHICmdList, OutputDepth.UAV, InputDepth.SRV, Displacement.UAV);
 
 	// Bind shader uniform
 	FSurfaceDepthComputeShaderParameters UniformParam;
 	UniformParam.MinDepth = Config.MinDepth;
 	UniformParam.MaxDepth = Config.MaxDepth;
-	UniformParam.ForceFactor = LiquidParam.ForceFactor;
+	UniformParam.ForceFactor = Params.ForceFactor;
 	SurfaceDepthComputeShader->SetShaderParameters(RHICmdList, UniformParam);
 
 	// Dispatch shader
-	const int ThreadGroupCountX = StaticCast<int>(Config.TextureWidth / 32);
-	const int ThreadGroupCountY = StaticCast<int>(Config.TextureHeight / 32);
-	DispatchComputeShader(RHICmdList, *SurfaceDepthComputeShader, ThreadGroupCountX, ThreadGroupCountY, 1);
+	const FIntVector GroupCount = Caustic::GetGroupCount(Config.TextureWidth, Config.TextureHeight, ThreadGroupShape);
+	DispatchComputeShader(RHICmdList, SurfaceDepthComputeShader, GroupCount.X, GroupCount.Y, GroupCount.Z);
 
 	// Unbind shader textures
 	SurfaceDepthComputeShader->UnbindShaderTextures(RHICmdList);
 
-	// Debug drawing
-	if (DepthDebugTextureRHIRef)
+	bHasDisplacement = bDisplacedVolume;
+}
+
+void FSurfaceDepthPassRenderer::RenderEmptyDepthPass(FRHICommandListImmediate& RHICmdList, const FCausticFrameParams& Params)
+{
+	SCOPED_DRAW_EVENT(RHICmdList, SurfaceEmptyDepthPass);
+
+	// Past the largest depth every texel reads as a miss, so the last displaced volume comes back as a negative push
+	ClearUAV(RHICmdList, InputDepth.Texture, InputDepth.UAV, FLinearColor(65504.0f, 0.0f, 0.0f, 0.0f));
+	RenderSurfaceDepthPass(RHICmdList, Params, nullptr);
+
+	bHasDisplacement = false;
+}
+
+void FSurfaceDepthPassRenderer::RenderSurfaceImpulsePass(FRHICommandListImmediate& RHICmdList, const FCausticFrameParams& Params, const TArray<FSurfaceImpulse>& Impulses)
+{
+	if (Impulses.Num() == 0)
 	{
-		RHICmdList.CopyToResolveTarget(OutputDepthTexture, DepthDebugTextureRHIRef, FResolveParams());
+		return;
 	}
+
+	SCOPED_DRAW_EVENT(RHICmdList, SurfaceImpulsePass);
+	INC_DWORD_STAT_BY(STAT_CausticSplattedImpulses, Impulses.Num());
+
+	const uint32 ImpulseCount = Impulses.Num();
+	UploadStructuredBuffer(ImpulseBuffer, ImpulseBufferSRV, ImpulseCapacity, Impulses.GetData(), sizeof(FSurfaceImpulse), ImpulseCount);
+
+	// Bind shader textures
+	RHICmdList.SetComputeShader(SurfaceImpulseComputeShader->GetComputeShader());
+	SurfaceImpulseComputeShader->BindShaderTextures(RHICmdList, ImpulseAccumulation.UAV, ImpulseBufferSRV);
+
+	// Bind shader uniform
+	FSurfaceImpulseComputeShaderParameters UniformParam;
+	UniformParam.ImpulseCount = ImpulseCount;
+	UniformParam.ForceFactor = Params.ForceFactor;
+	SurfaceImpulseComputeShader->SetShaderParameters(RHICmdList, UniformParam);
+
+	// One group per impulse over its footprint, the cost follows the covered area instead of texels times impulses
+	const uint32 GroupsPerRow = 65535;
+	DispatchComputeShader(RHICmdList, SurfaceImpulseComputeShader, FMath::Min(ImpulseCount, GroupsPerRow), FMath::DivideAndRoundUp(ImpulseCount, GroupsPerRow), 1);
+
+	// Unbind shader textures
+	SurfaceImpulseComputeShader->UnbindShaderTextures(RHICmdList);
+
+	// The depth pass wrote the source term and the splat the accumulation, both through their UAVs
+	RHICmdList.TransitionResource(EResourceTransitionAccess::ERWBarrier, EResourceTransitionPipeline::EComputeToCompute, OutputDepth.UAV);
+	RHICmdList.TransitionResource(EResourceTransitionAccess::ERWBarrier, EResourceTransitionPipeline::EComputeToCompute, ImpulseAccumulation.UAV);
+
+	// Bind shader textures
+	RHICmdList.SetComputeShader(SurfaceImpulseResolveComputeShader->GetComputeShader());
+	SurfaceImpulseResolveComputeShader->BindShaderTextures(RHICmdList, OutputDepth.UAV, ImpulseAccumulation.UAV);
+
+	// Dispatch shader
+	const FIntVector GroupCount = Caustic::GetGroupCount(Config.TextureWidth, Config.TextureHeight, ThreadGroupShape);
+	DispatchComputeShader(RHICmdList, SurfaceImpulseResolveComputeShader, GroupCount.X, GroupCount.Y, GroupCount.Z);
+
+	// Unbind shader textures
+	SurfaceImpulseResolveComputeShader->UnbindShaderTextures(RHICmdList);
 }
 
-void FSurfaceDepthPassRenderer::RenderSurfaceHeightPass(FRHICommandListImmediate& RHICmdList, const FLiquidParam& LiquidParam)
+void FSurfaceDepthPassRenderer::RenderSurfaceHeightPass(FRHICommandListImmediate& RHICmdList, const FCausticFrameParams& Params)
 {
-	// Bind shader textures
-	TShaderMapRef<FSurfaceHeightComputeShader> SurfaceHeightComputeShader(GetGlobalShaderMap(ERHIFeatureLevel::SM5));
+	SCOPED_DRAW_EVENT(RHICmdList, SurfaceHeightPass);
+
+	const bool bNinePointStencil = Params.Solver == ECausticSolver::NinePoint;
+	FSurfaceHeightComputeShader* SurfaceHeightComputeShader = SurfaceHeightComputeShaders[GetHeightShaderIndex((int32)Params.BoundaryMode, bHasObstacleMask, bNinePointStencil)];
+
 	RHICmdList.SetComputeShader(SurfaceHeightComputeShader->GetComputeShader());
-	SurfaceHeightComputeShader->BindShaderTextures(RHICmdList, OutputHeightTextureUAV, OutputDepthTextureSRV, PrevDepthTextureSRV);
 
 	// Bind shader uniform
 	FSurfaceHeightComputeShaderParameters UniformParam;
-	UniformParam.LiquidParam = EncodeLiquidParam(LiquidParam);
-	UniformParam.AttenuationCoefficient = LiquidParam.AttenuationCoefficient;
+	UniformParam.LiquidParam = Params.HeightParam;
+	UniformParam.AttenuationCoefficient = Params.AttenuationCoefficient;
+	UniformParam.SpongeWidth = Params.SpongeWidth;
+	UniformParam.SpongeStrength = Params.SpongeStrength;
 	SurfaceHeightComputeShader->SetShaderParameters(RHICmdList, UniformParam);
 
-	// Dispatch shader
-	const int ThreadGroupCountX = StaticCast<int>(Config.TextureWidth / 32);
-	const int ThreadGroupCountY = StaticCast<int>(Config.TextureHeight / 32);
-	DispatchComputeShader(RHICmdList, *SurfaceHeightComputeShader, ThreadGroupCountX, ThreadGroupCountY, 1);
+	const FIntVector GroupCount = Caustic::GetGroupCount(Config.TextureWidth, Config.TextureHeight, ThreadGroupShape);
 
-	// Unbind shader textures
-	SurfaceHeightComputeShader->UnbindShaderTextures(RHICmdList);
+	// Explicit solvers take their neighbours from the current step in a single dispatch. The semi implicit
+	// solver relaxes the neighbours towards the new step, ping-ponging so the last iteration lands in the output
+	for (int32 Iteration = 0; Iteration < Params.SolverIterations; ++Iteration)
+	{
+		const bool bWriteOutput = (Params.SolverIterations - 1 - Iteration) % 2 == 0;
+		const FCausticPooledTexture& Target = bWriteOutput ? OutputHeight : SolverScratch;
+		const FCausticPooledTexture& Neighbours = (Iteration == 0) ? OutputDepth : bWriteOutput ? SolverScratch : OutputHeight;
+
+		// Bind shader textures
+		SurfaceHeightComputeShader->BindShaderTextures(RHICmdList, Target.UAV, OutputDepth.SRV, PrevDepth.SRV, Neighbours.SRV, ObstacleMask.SRV);
+
+		// Dispatch shader
+		DispatchComputeShader(RHICmdList, SurfaceHeightComputeShader, GroupCount.X, GroupCount.Y, GroupCount.Z);
+
+		// Unbind shader textures
+		SurfaceHeightComputeShader->UnbindShaderTextures(RHICmdList);
+
+		RHICmdList.TransitionResource(EResourceTransitionAccess::EReadable, EResourceTransitionPipeline::EComputeToCompute, Target.UAV);
+	}
 
 	// Copy to cache depth texture
 	FRHICopyTextureInfo CopyInfo;
-	RHICmdList.CopyTexture(OutputDepthTexture, PrevDepthTexture, CopyInfo);
-	RHICmdList.CopyTexture(OutputHeightTexture, OutputDepthTexture, CopyInfo);
+	RHICmdList.CopyTexture(OutputDepth.Texture, PrevDepth.Texture, CopyInfo);
+	RHICmdList.CopyTexture(OutputHeight.Texture, OutputDepth.Texture, CopyInfo);
+}
+
+void FSurfaceDepthPassRenderer::ReadbackState_RenderThread(FRHICommandListImmediate& RHICmdList, FSurfaceStateReadback& OutReadback)
+{
+	check(IsInRenderingThread());
+
+	SCOPED_DRAW_EVENT(RHICmdList, SurfaceStateReadback);
+
+	OutReadback.Width = Config.TextureWidth;
+	OutReadback.Height = Config.TextureHeight;
+
+	// Staging textures live until the snapshot resolves, they are rare enough not to go through the pool
+	FRHIResourceCreateInfo CreateInfo;
+	OutReadback.CurrentStaging = RHICreateTexture2D(Config.TextureWidth, Config.TextureHeight, PF_FloatRGBA, 1, 1, TexCreate_CPUReadback, CreateInfo);
+	OutReadback.PreviousStaging = RHICreateTexture2D(Config.TextureWidth, Config.TextureHeight, PF_FloatRGBA, 1, 1, TexCreate_CPUReadback, CreateInfo);
+	OutReadback.DisplacementStaging = RHICreateTexture2D(Config.TextureWidth, Config.TextureHeight, PF_R16F, 1, 1, TexCreate_CPUReadback, CreateInfo);
+
+	// The step ends by copying the new height into OutputDepth, so it and PrevDepth are the whole solver state.
+	// The displaced volume is what the next step subtracts, without it interactors at rest would push again
+	FRHICopyTextureInfo CopyInfo;
+	RHICmdList.CopyTexture(OutputDepth.Texture, OutReadback.CurrentStaging, CopyInfo);
+	RHICmdList.CopyTexture(PrevDepth.Texture, OutReadback.PreviousStaging, CopyInfo);
+	RHICmdList.CopyTexture(Displacement.Texture, OutReadback.DisplacementStaging, CopyInfo);
 
-	// Debug drawing
-	if (HeightDebugTextureRHIRef)
+	OutReadback.Fence = RHICreateGPUFence(TEXT("CausticStateReadback"));
+	RHICmdList.WriteGPUFence(OutReadback.Fence);
+}
+
+FSurfaceStateReadback::FSurfaceStateReadback() :
+	Width(0),
+	Height(0)
+{
+}
+
+/** Copies a mapped staging texture row by row, at the pitch the RHI mapped it with */
+template<typename TexelType>
+static bool ReadStagingTexture(FRHICommandListImmediate& RHICmdList, FRHITexture2D* Staging, uint32 Width, uint32 Height, TArray<TexelType>& OutTexels)
+{
+	void* Data = nullptr;
+	int32 RowPitch = 0;
+	int32 MappedHeight = 0;
+	RHICmdList.MapStagingSurface(Staging, Data, RowPitch, MappedHeight);
+	if (!Data)
+	{
+		return false;
+	}
+
+	// Mapped rows are usually padded, RowPitch counts texels including the padding
+	if ((uint32)RowPitch < Width || (uint32)MappedHeight < Height)
+	{
+		RHICmdList.UnmapStagingSurface(Staging);
+		return false;
+	}
+
+	OutTexels.SetNumUninitialized(Width * Height);
+	for (uint32 Y = 0; Y < Height; ++Y)
 	{
-		RHICmdList.CopyToResolveTarget(OutputHeightTexture, HeightDebugTextureRHIRef, FResolveParams());
+		FMemory::Memcpy(&OutTexels[Y * Width], static_cast<const TexelType*>(Data) + Y * RowPitch, Width * sizeof(TexelType));
 	}
+
+	RHICmdList.UnmapStagingSurface(Staging);
+
+	return true;
 }
 
-// Reference: https://github.com/AsehesL/UnityWaveEquation
-FVector4 FSurfaceDepthPassRenderer::EncodeLiquidParam(const FLiquidParam& LiquidParam) const
+bool FSurfaceStateReadback::Resolve_RenderThread(FRHICommandListImmediate& RHICmdList, TArray<FFloat16Color>& OutCurrent, TArray<FFloat16Color>& OutPrevious, TArray<FFloat16>& OutDisplacement)
 {
-	const float SampleSpacing = 1.0f / LiquidParam.DepthTextureWidth;
-	const float FixedDeltaTime = 0.016f;
-	float Viscosity = FMath::Abs(LiquidParam.Viscosity);
-	float MaxVelocity = SampleSpacing / (2 * FixedDeltaTime) * FMath::Sqrt(Viscosity * FixedDeltaTime + 2);
-	float Velocity = FMath::Abs(LiquidParam.Velocity) * MaxVelocity;
-	float ViscositySqr = Viscosity * Viscosity;
-	float VelocitySqr = Velocity * Velocity;
-	float DeltaSizeSqr = SampleSpacing * SampleSpacing;
-	float DeltaT = FMath::Sqrt(ViscositySqr + 32 * VelocitySqr / DeltaSizeSqr);
-	float DeltaTDensity = 8 * VelocitySqr / DeltaSizeSqr;
-	float MaxT1 = (Viscosity + DeltaT) / DeltaTDensity;
-	float MaxT2 = (Viscosity - DeltaT) / DeltaTDensity;
-
-	float MaxT = (MaxT2 > 0) ? FMath::Min(MaxT1, MaxT2) : MaxT1;
-	MaxT = FMath::Max(FixedDeltaTime, MaxT);
-
-	float Factor = VelocitySqr * FixedDeltaTime * FixedDeltaTime / DeltaSizeSqr;
-	float I = Viscosity * FixedDeltaTime - 2;
-	float J = Viscosity * FixedDeltaTime + 2;
-
-	float K1 = (4 - 8 * Factor) / J;
-	float K2 = I / J;
-	float K3 = 2 * Factor / J;
-
-	return FVector4(K1, K2, K3, SampleSpacing);
+	check(IsInRenderingThread());
+
+	return ReadStagingTexture(RHICmdList, CurrentStaging, Width, Height, OutCurrent) &&
+		ReadStagingTexture(RHICmdList, PreviousStaging, Width, Height, OutPrevious) &&
+		ReadStagingTexture(RHICmdList, DisplacementStaging, Width, Height, OutDisplacement);
 }
 
+void FSurfaceDepthPassRenderer::RestoreState_RenderThread(FRHICommandListImmediate& RHICmdList, const TArray<FFloat16Color>& Current, const TArray<FFloat16Color>& Previous, const TArray<FFloat16>& InDisplacement)
+{
+	check(IsInRenderingThread());
+
+	const int32 TexelCount = Config.TextureWidth * Config.TextureHeight;
+	if (Current.Num() != TexelCount || Previous.Num() != TexelCount || InDisplacement.Num() != TexelCount)
+	{
+		return;
+	}
+
+	const FUpdateTextureRegion2D Region(0, 0, 0, 0, Config.TextureWidth, Config.TextureHeight);
+	const uint32 Pitch = Config.TextureWidth * sizeof(FFloat16Color);
+	RHIUpdateTexture2D(OutputDepth.Texture, 0, Region, Pitch, reinterpret_cast<const uint8*>(Current.GetData()));
+	RHIUpdateTexture2D(PrevDepth.Texture, 0, Region, Pitch, reinterpret_cast<const uint8*>(Previous.GetData()));
+	RHIUpdateTexture2D(Displacement.Texture, 0, Region, Config.TextureWidth * sizeof(FFloat16), reinterpret_cast<const uint8*>(InDisplacement.GetData()));
+
+	// Only give the volume back once nothing overlaps if the restored step had displaced any
+	bHasDisplacement = InDisplacement.ContainsByPredicate([](const FFloat16& Texel) { return Texel.GetFloat() != 0.0f; });
+
+	// Keep the height output consistent with the restored step until the next one overwrites it
+	FRHICopyTextureInfo CopyInfo;
+	RHICmdList.CopyTexture(OutputDepth.Texture, OutputHeight.Texture, CopyInfo);
+}
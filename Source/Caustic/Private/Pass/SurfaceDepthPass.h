@@ -4,21 +4,141 @@
 
 #include "CoreMinimal.h"
 #include "CausticTypes.h"
+#include "Pass/CausticResourcePool.h"
+#include "Pass/CausticFrameParams.h"
+#include "Pass/PassUtils.h"
 #include "UObject/ObjectMacros.h"
+#include "HAL/ThreadSafeBool.h"
 #include "RHI/Public/RHIResources.h"
 #include "RHI/Public/RHICommandList.h"
 
+class FStaticMeshRenderData;
+
 struct FSurfaceDepthPassConfig
 {
 	float                     MinDepth;
 	float                     MaxDepth;
 	uint32                    TextureWidth;
 	uint32                    TextureHeight;
-	UTextureRenderTarget2D*   DepthDebugTextureRef;
-	UTextureRenderTarget2D*   HeightDebugTextureRef;
+
+	/** Largest impulse and proxy counts one step uploads, only used to size the structured buffers in the memory budget */
+	uint32                    MaxImpulses = 0;
+	uint32                    MaxDepthProxies = 0;
+
+	/** Whether the body rasterizes static meshes, only then are the mesh depth targets created */
+	bool                      bMeshDepth = false;
+};
+
+/** Impulse in the layout the splat shader reads, centre and inverse radius in texture UV */
+struct FSurfaceImpulse
+{
+	FVector2D                 Center;
+	FVector2D                 InvRadius;
+	float                     Strength;
+};
+
+/** Shapes the proxy depth shader traces, matches the CAUSTIC_PROXY_ defines */
+enum class ESurfaceDepthProxyShape : uint32
+{
+	Capsule,
+	Box,
+	Convex
 };
 
-class FSurfaceDepthPassRenderer
+/**
+ * Collision shape traced by the proxy depth shader, in body space with the surface plane at Z 0.
+ * A capsule stores its segment ends in P0 and P1 with the radius in P0.W, spheres have equal ends.
+ * A box stores its centre in P0, its half extent in P1 and its X and Y axes in P2 and P3.
+ * A convex hull stores its bounds centre and plane count in P0 and its bounds extent in P1. Its planes
+ * follow in the next slots, four to a slot, with outward normals and unused planes left at zero.
+ */
+struct FSurfaceDepthProxy
+{
+	FVector4                  P0;
+	FVector4                  P1;
+	FVector4                  P2;
+	FVector4                  P3;
+
+	static FSurfaceDepthProxy MakeCapsule(const FVector& A, const FVector& B, float Radius)
+	{
+		FSurfaceDepthProxy Proxy;
+		Proxy.P0 = FVector4(A, Radius);
+		Proxy.P1 = FVector4(B, (float)ESurfaceDepthProxyShape::Capsule);
+		Proxy.P2 = FVector4(0.0f, 0.0f, 0.0f, 0.0f);
+		Proxy.P3 = FVector4(0.0f, 0.0f, 0.0f, 0.0f);
+		return Proxy;
+	}
+
+	static FSurfaceDepthProxy MakeBox(const FVector& Center, const FVector& Extent, const FVector& AxisX, const FVector& AxisY)
+	{
+		FSurfaceDepthProxy Proxy;
+		Proxy.P0 = FVector4(Center, 0.0f);
+		Proxy.P1 = FVector4(Extent, (float)ESurfaceDepthProxyShape::Box);
+		Proxy.P2 = FVector4(AxisX, 0.0f);
+		Proxy.P3 = FVector4(AxisY, 0.0f);
+		return Proxy;
+	}
+
+	static FSurfaceDepthProxy MakeConvex(const FBox& Bounds, int32 PlaneCount)
+	{
+		FSurfaceDepthProxy Proxy;
+		Proxy.P0 = FVector4(Bounds.GetCenter(), (float)PlaneCount);
+		Proxy.P1 = FVector4(Bounds.GetExtent(), (float)ESurfaceDepthProxyShape::Convex);
+		Proxy.P2 = FVector4(0.0f, 0.0f, 0.0f, 0.0f);
+		Proxy.P3 = FVector4(0.0f, 0.0f, 0.0f, 0.0f);
+		return Proxy;
+	}
+
+	/** Slots the planes of a convex hull take after its header */
+	static int32 GetConvexPlaneSlots(int32 PlaneCount)
+	{
+		return FMath::DivideAndRoundUp(PlaneCount, 4);
+	}
+};
+
+/**
+ * Static mesh LOD the mesh depth pass rasterizes, its buffers stay owned by the render data of the mesh.
+ * The gathering body references the mesh, and a mesh releases its render data behind a fence that is
+ * enqueued after the frame, so the pointer outlives the render command that reads it.
+ */
+struct FSurfaceDepthMesh
+{
+	/** Mesh to body space with the surface plane at Z 0 */
+	FMatrix                      LocalToSurface;
+	const FStaticMeshRenderData* RenderData = nullptr;
+	int32                        LODIndex = 0;
+};
+
+/** Solver state on its way back from the GPU, polled by its owner instead of stalling the render thread on it */
+class FSurfaceStateReadback
+{
+public:
+
+	FSurfaceStateReadback();
+
+	/** Whether the GPU has written the copies, render thread only */
+	FORCEINLINE bool IsReady() const { return Fence.IsValid() && Fence->Poll(); }
+
+	/** Unpacks the current and previous height frames and the displaced volume once IsReady, render thread only */
+	bool Resolve_RenderThread(FRHICommandListImmediate& RHICmdList, TArray<FFloat16Color>& OutCurrent, TArray<FFloat16Color>& OutPrevious, TArray<FFloat16>& OutDisplacement);
+
+private:
+
+	friend class FSurfaceDepthPassRenderer;
+
+	/** CPU readable copies of the current and previous height and the displaced volume */
+	FTexture2DRHIRef           CurrentStaging;
+	FTexture2DRHIRef           PreviousStaging;
+	FTexture2DRHIRef           DisplacementStaging;
+
+	/** Written after the copies, signalled once the GPU has finished them */
+	FGPUFenceRHIRef            Fence;
+
+	uint32                     Width;
+	uint32                     Height;
+};
+
+class FSurfaceDepthPassRenderer : public TSharedFromThis<FSurfaceDepthPassRenderer, ESPMode::ThreadSafe>
 {
 
 public:
@@ -28,41 +148,122 @@ public:
 
 	void InitPass(const FSurfaceDepthPassConfig& InConfig);
 
-	void Render(const FLiquidParam& LiquidParam, class FRHITexture* DepthTextureRef);
+	/** GPU bytes InitPass allocates for a config, the budget checks this before a body creates its passes */
+	static uint64 GetMemorySize(const FSurfaceDepthPassConfig& InConfig);
+
+	/** Thresholds a scene depth capture into the obstacle mask, called once by the frame graph after a bake */
+	void RenderObstacleMaskPass(FRHICommandListImmediate& RHICmdList, class FRHITexture* MaskDepthTextureRef, float ObstacleDepth);
+
+	/** Rasterizes the meshes into the mesh depth, the proxy pass then merges it into the input depth */
+	void RenderMeshDepthPass(FRHICommandListImmediate& RHICmdList, const TArray<FSurfaceDepthMesh>& Meshes, const FVector2D& BodySize);
+
+	/**
+	 * Traces the proxies straight into the input depth in one dispatch, BodySize is the world extent the texture covers.
+	 * With bMergeMeshDepth the trace starts from the depth RenderMeshDepthPass wrote instead of an empty input.
+	 */
+	void RenderProxyDepthPass(FRHICommandListImmediate& RHICmdList, const TArray<FSurfaceDepthProxy>& Proxies, const FVector2D& BodySize, bool bMergeMeshDepth);
+
+	/** Converts the captured depth into the source term of the wave equation, called by the frame graph. A null DepthTextureRef reads the proxy depth */
+	void RenderSurfaceDepthPass(FRHICommandListImmediate& RHICmdList, const FCausticFrameParams& Params, class FRHITexture* DepthTextureRef);
+
+	/** Runs the depth pass on an empty input, so the displaced volume of interactors that left is given back */
+	void RenderEmptyDepthPass(FRHICommandListImmediate& RHICmdList, const FCausticFrameParams& Params);
+
+	/** Whether the pass was created for the static mesh source and can run RenderMeshDepthPass */
+	FORCEINLINE bool HasMeshDepthTargets() const { return Config.bMeshDepth; }
+
+	/** Whether the last displaced volume pass saw any interactor, render thread only */
+	FORCEINLINE bool HasDisplacement() const { return bHasDisplacement; }
+
+	/** Splats each impulse over its footprint and adds the sum to the source term, called by the frame graph between the depth and height passes */
+	void RenderSurfaceImpulsePass(FRHICommandListImmediate& RHICmdList, const FCausticFrameParams& Params, const TArray<FSurfaceImpulse>& Impulses);
+
+	/** Advances the height field by one step, called by the frame graph */
+	void RenderSurfaceHeightPass(FRHICommandListImmediate& RHICmdList, const FCausticFrameParams& Params);
+
+	/** Starts copying the height frames and the displaced volume back to the CPU, OutReadback resolves them once the GPU is done */
+	void ReadbackState_RenderThread(FRHICommandListImmediate& RHICmdList, FSurfaceStateReadback& OutReadback);
+
+	/** Overwrites both height frames and the displaced volume, the next step continues from the restored state */
+	void RestoreState_RenderThread(FRHICommandListImmediate& RHICmdList, const TArray<FFloat16Color>& Current, const TArray<FFloat16Color>& Previous, const TArray<FFloat16>& InDisplacement);
 
 	bool IsValidPass() const;
 
-	FORCEINLINE FShaderResourceViewRHIRef GetDepthTextureSRV() const { return OutputDepthTextureSRV; }
+	/** Whether the render thread has finished creating the pass resources */
+	FORCEINLINE bool IsReady() const { return bResourcesReady; }
+
+	/** Returns the simulation textures to the resource pool */
+	void ReleasePass();
+
+	FORCEINLINE FShaderResourceViewRHIRef GetDepthTextureSRV() const { return OutputDepth.SRV; }
+
+	FORCEINLINE FShaderResourceViewRHIRef GetHeightTextureSRV() const { return OutputHeight.SRV; }
+
+	/** Obstacle mask, 1 inside solid geometry and 0 over water. Cleared to water until a mask is baked */
+	FORCEINLINE FShaderResourceViewRHIRef GetObstacleMaskSRV() const { return ObstacleMask.SRV; }
 
-	FORCEINLINE FShaderResourceViewRHIRef GetHeightTextureSRV() const { return OutputHeightTextureSRV; }
+	/** Whether a mask has been baked since init, passes that only need it for dry texels skip the read otherwise */
+	FORCEINLINE bool HasObstacleMask() const { return bHasObstacleMask; }
+
+	FORCEINLINE FRHITexture* GetDepthTexture() const { return OutputDepth.Texture; }
+
+	FORCEINLINE FRHITexture* GetHeightTexture() const { return OutputHeight.Texture; }
 
 private:
 
-	FTexture2DRHIRef           OutputDepthTexture;
-	FUnorderedAccessViewRHIRef OutputDepthTextureUAV;
-	FShaderResourceViewRHIRef  OutputDepthTextureSRV;
+	FCausticPooledTexture      OutputDepth;
+	FCausticPooledTexture      OutputHeight;
+	FCausticPooledTexture      InputDepth;
+	FCausticPooledTexture      PrevDepth;
+	FCausticPooledTexture      SolverScratch;
+	FCausticPooledTexture      ObstacleMask;
+
+	/** Volume displaced below each texel on the last step, for the displaced volume force */
+	FCausticPooledTexture      Displacement;
 
-	FTexture2DRHIRef           OutputHeightTexture;
-	FUnorderedAccessViewRHIRef OutputHeightTextureUAV;
-	FShaderResourceViewRHIRef  OutputHeightTextureSRV;
+	/** Impulse sum of the current step in fixed point, zero between steps */
+	FCausticPooledTexture      ImpulseAccumulation;
 
-	FTexture2DRHIRef           InputDepthTexture;
-	FShaderResourceViewRHIRef  InputDepthTextureSRV;
+	/** Nearest mesh surface below each texel and the depth buffer that picks it, only with bMeshDepth */
+	FCausticPooledTexture      MeshDepth;
+	FCausticPooledTexture      MeshDepthStencil;
 
-	FTexture2DRHIRef           PrevDepthTexture;
-	FShaderResourceViewRHIRef  PrevDepthTextureSRV;
+	/** Penetration and displaced volume permutations, indexed by ECausticInteractionForce */
+	class FSurfaceDepthComputeShader*  SurfaceDepthComputeShaders[(int32)ECausticInteractionForce::MAX];
+	class FSurfaceObstacleMaskComputeShader* SurfaceObstacleMaskComputeShader;
+	class FSurfaceImpulseComputeShader* SurfaceImpulseComputeShader;
+	class FSurfaceImpulseResolveComputeShader* SurfaceImpulseResolveComputeShader;
+	class FSurfaceProxyDepthComputeShader* SurfaceProxyDepthComputeShader;
+	class FSurfaceMeshDepthVS* SurfaceMeshDepthVertexShader;
+	class FSurfaceMeshDepthPS* SurfaceMeshDepthPixelShader;
 
-	FRHITexture*               DepthDebugTextureRHIRef;
-	FRHITexture*               HeightDebugTextureRHIRef;
+	/** Every boundary mode, obstacle mask and stencil permutation, indexed by GetHeightShaderIndex */
+	class FSurfaceHeightComputeShader* SurfaceHeightComputeShaders[(int32)ECausticBoundaryMode::MAX * 2 * 2];
+	Caustic::EThreadGroupShape         ThreadGroupShape;
+
+	/** Grows to the largest impulse count seen and is rewritten every frame that has impulses */
+	FStructuredBufferRHIRef    ImpulseBuffer;
+	FShaderResourceViewRHIRef  ImpulseBufferSRV;
+	uint32                     ImpulseCapacity;
+
+	FStructuredBufferRHIRef    ProxyBuffer;
+	FShaderResourceViewRHIRef  ProxyBufferSRV;
+	uint32                     ProxyCapacity;
 
 	FSurfaceDepthPassConfig    Config;
 
 	bool                       bInitiated;
+	FThreadSafeBool            bResourcesReady;
+	bool                       bHasObstacleMask;
+	bool                       bHasDisplacement;
 
 private:
 
-	void RenderSurfaceDepthPass(FRHICommandListImmediate& RHICmdList, const FLiquidParam& LiquidParam, class FRHITexture* DepthTextureRef);
-	void RenderSurfaceHeightPass(FRHICommandListImmediate& RHICmdList, const FLiquidParam& LiquidParam);
+	void InitPass_RenderThread(FRHICommandListImmediate& RHICmdList);
+	void ReleasePassResources();
+
+	/** Writes Count elements into Buffer, recreating it a power of two larger when it is too small */
+	static void UploadStructuredBuffer(FStructuredBufferRHIRef& Buffer, FShaderResourceViewRHIRef& BufferSRV, uint32& Capacity, const void* Data, uint32 Stride, uint32 Count);
 
-	FVector4 EncodeLiquidParam(const FLiquidParam& LiquidParam) const;
+	static void ReleaseStructuredBuffer(FStructuredBufferRHIRef& Buffer, FShaderResourceViewRHIRef& BufferSRV, uint32& Capacity, uint32 Stride);
 };
@@ -16,6 +16,17 @@
 #include "Public/StaticBoundShaderState.h"
 #include "RHI/Public/RHICommandList.h"
 #include "Pass/PassUtils.h"
+#include "Pass/CausticResourcePool.h"
+#include "Pass/CausticMemory.h"
+
+BEGIN_GLOBAL_SHADER_PARAMETER_STRUCT(FSurfaceNormalComputeShaderParameters, )
+	SHADER_PARAMETER(FVector2D, AmbientTiling)
+	SHADER_PARAMETER(float, AmbientAmplitude)
+END_GLOBAL_SHADER_PARAMETER_STRUCT()
+IMPLEMENT_GLOBAL_SHADER_PARAMETER_STRUCT(FSurfaceNormalComputeShaderParameters, "SurfaceNormalUniform");
+
+/** Adds the shared ambient height field on top of the simulated one */
+class FAmbientWavesDim : SHADER_PERMUTATION_BOOL("CAUSTIC_AMBIENT_WAVES");
 
 class FSurfaceNormalComputeShader : public FGlobalShader
 {
@@ -23,17 +34,30 @@ class FSurfaceNormalComputeShader : public FGlobalShader
 
 public:
 
+	using FPermutationDomain = TShaderPermutationDomain<Caustic::FThreadGroupShapeDim, Caustic::FBoundaryModeDim, Caustic::FObstacleMaskDim, FAmbientWavesDim>;
+
 	FSurfaceNormalComputeShader() {}
 	FSurfaceNormalComputeShader(const ShaderMetaType::CompiledShaderInitializerType& Initializer)
 		: FGlobalShader(Initializer)
 	{
 		InputHeightTexture.Bind(Initializer.ParameterMap, TEXT("InputHeightTexture"));
+		ObstacleMaskTexture.Bind(Initializer.ParameterMap, TEXT("ObstacleMaskTexture"));
+		AmbientHeightTexture.Bind(Initializer.ParameterMap, TEXT("AmbientHeightTexture"));
+		AmbientWaveSampler.Bind(Initializer.ParameterMap, TEXT("AmbientWaveSampler"));
 		OutputNormalTexture.Bind(Initializer.ParameterMap, TEXT("OutputNormalTexture"));
 	}
 
 	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
 	{
-		return IsFeatureLevelSupported(Parameters.Platform, ERHIFeatureLevel::SM5);
+		return IsFeatureLevelSupported(Parameters.Platform, ERHIFeatureLevel::SM5) && Caustic::ShouldCompileThreadGroupShape<FPermutationDomain>(Parameters.Platform, Parameters.PermutationId);
+	}
+
+	static void ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
+	{
+		FGlobalShader::ModifyCompilationEnvironment(Parameters, OutEnvironment);
+
+		FPermutationDomain PermutationVector(Parameters.PermutationId);
+		Caustic::ModifyThreadGroupCompilationEnvironment((Caustic::EThreadGroupShape)PermutationVector.Get<Caustic::FThreadGroupShapeDim>(), OutEnvironment);
 	}
 
 	static bool ShouldCache(EShaderPlatform Platform)
@@ -44,16 +68,27 @@ public:
 	virtual bool Serialize(FArchive& Ar) override
 	{
 		bool bShaderHasOutdatedParameters = FGlobalShader::Serialize(Ar);
-		Ar << InputHeightTexture << OutputNormalTexture;
+		Ar << InputHeightTexture << ObstacleMaskTexture << AmbientHeightTexture << AmbientWaveSampler << OutputNormalTexture;
 		return bShaderHasOutdatedParameters;
 	}
 
-	void BindShaderTextures(FRHICommandList& RHICmdList, FUnorderedAccessViewRHIRef OutputTextureUAV, FShaderResourceViewRHIRef InputTextureSRV)
+	void BindShaderTextures(FRHICommandList& RHICmdList, FUnorderedAccessViewRHIRef OutputTextureUAV, FShaderResourceViewRHIRef InputTextureSRV, FShaderResourceViewRHIRef ObstacleMaskSRV, FShaderResourceViewRHIRef AmbientHeightSRV)
 	{
 		FRHIComputeShader* ComputeShaderRHI = GetComputeShader();
 
 		SetUAVParameter(RHICmdList, ComputeShaderRHI, OutputNormalTexture, OutputTextureUAV);
 		SetSRVParameter(RHICmdList, ComputeShaderRHI, InputHeightTexture, InputTextureSRV);
+
+		if (ObstacleMaskTexture.IsBound())
+		{
+			SetSRVParameter(RHICmdList, ComputeShaderRHI, ObstacleMaskTexture, ObstacleMaskSRV);
+		}
+
+		if (AmbientHeightTexture.IsBound())
+		{
+			SetSRVParameter(RHICmdList, ComputeShaderRHI, AmbientHeightTexture, AmbientHeightSRV);
+			SetSamplerParameter(RHICmdList, ComputeShaderRHI, AmbientWaveSampler, TStaticSamplerState<SF_Bilinear, AM_Wrap, AM_Wrap, AM_Wrap>::GetRHI());
+		}
 	}
 
 	void UnbindShaderTextures(FRHICommandList& RHICmdList)
@@ -62,87 +97,156 @@ public:
 
 		SetUAVParameter(RHICmdList, ComputeShaderRHI, OutputNormalTexture, FUnorderedAccessViewRHIRef());
 		SetSRVParameter(RHICmdList, ComputeShaderRHI, InputHeightTexture, FShaderResourceViewRHIRef());
+		SetSRVParameter(RHICmdList, ComputeShaderRHI, ObstacleMaskTexture, FShaderResourceViewRHIRef());
+		SetSRVParameter(RHICmdList, ComputeShaderRHI, AmbientHeightTexture, FShaderResourceViewRHIRef());
+	}
+
+	void SetShaderParameters(FRHICommandList& RHICmdList, const FSurfaceNormalComputeShaderParameters& Parameters)
+	{
+		FRHIComputeShader* ComputeShaderRHI = GetComputeShader();
+		SetUniformBufferParameterImmediate(RHICmdList, ComputeShaderRHI, GetUniformBufferParameter<FSurfaceNormalComputeShaderParameters>(), Parameters);
 	}
 
 private:
 
 	FShaderResourceParameter InputHeightTexture;
+	FShaderResourceParameter ObstacleMaskTexture;
+	FShaderResourceParameter AmbientHeightTexture;
+	FShaderResourceParameter AmbientWaveSampler;
 	FShaderResourceParameter OutputNormalTexture;
 };
 
 IMPLEMENT_SHADER_TYPE(, FSurfaceNormalComputeShader, TEXT("/Plugin/Caustic/SurfaceNormalComputeShader.usf"), TEXT("ComputeSurfaceNormal"), SF_Compute);
 
-FSurfaceNormalPassRenderer::FSurfaceNormalPassRenderer() :
-	bInitiated(false)
+static int32 GetNormalShaderIndex(int32 BoundaryMode, bool bObstacleMask, bool bAmbientWaves)
 {
+	return (BoundaryMode * 2 + (bObstacleMask ? 1 : 0)) * 2 + (bAmbientWaves ? 1 : 0);
+}
 
+FSurfaceNormalPassRenderer::FSurfaceNormalPassRenderer() :
+	ThreadGroupShape(Caustic::EThreadGroupShape::Group8x8),
+	bInitiated(false),
+	bResourcesReady(false)
+{
+	FMemory::Memzero(SurfaceNormalComputeShaders);
 }
 
 FSurfaceNormalPassRenderer::~FSurfaceNormalPassRenderer()
 {
-	SafeReleaseTextureResource(OutputNormalTexture);
-	SafeReleaseTextureResource(OutputNormalTextureSRV);
-	SafeReleaseTextureResource(OutputNormalTextureUAV);
+	ReleasePassResources();
+}
+
+uint64 FSurfaceNormalPassRenderer::GetMemorySize(const FSurfaceNormalPassConfig& InConfig)
+{
+	return Caustic::GetTextureMemorySize(InConfig.TextureWidth, InConfig.TextureHeight, PF_FloatRGBA);
 }
 
 void FSurfaceNormalPassRenderer::InitPass(const FSurfaceNormalPassConfig& InConfig)
 {
 	if (!bInitiated)
 	{
-		FRHIResourceCreateInfo CreateInfo;
-		uint32 TextureWidth = InConfig.TextureWidth;
-		uint32 TextureHeight = InConfig.TextureHeight;
+		Config = InConfig;
+		bInitiated = true;
+
+		ENQUEUE_RENDER_COMMAND(SurfaceNormalPassInitCommand)
+		(
+			[Renderer = AsShared()](FRHICommandListImmediate& RHICmdList)
+			{
+				Renderer->InitPass_RenderThread(RHICmdList);
+			}
+		);
+	}
+}
 
-		OutputNormalTexture = RHICreateTexture2D(TextureWidth, TextureHeight, PF_FloatRGBA, 1, 1, TexCreate_ShaderResource | TexCreate_UAV, CreateInfo);
-		OutputNormalTextureUAV = RHICreateUnorderedAccessView(OutputNormalTexture);
-		OutputNormalTextureSRV = RHICreateShaderResourceView(OutputNormalTexture, 0);
+void FSurfaceNormalPassRenderer::InitPass_RenderThread(FRHICommandListImmediate& RHICmdList)
+{
+	check(IsInRenderingThread());
 
-		NormalDebugTextureRHIRef = Caustic::GetRHITextureFromRenderTarget(InConfig.NormalDebugTextureRef);
+	uint32 TextureWidth = Config.TextureWidth;
+	uint32 TextureHeight = Config.TextureHeight;
 
-		Config = InConfig;
+	OutputNormal = FCausticResourcePool::Get().AcquireTexture(TextureWidth, TextureHeight, PF_FloatRGBA, TexCreate_ShaderResource | TexCreate_UAV);
 
-		bInitiated = true;
+	ThreadGroupShape = Caustic::GetThreadGroupShape(GMaxRHIShaderPlatform);
+	TShaderMap<FGlobalShaderType>* GlobalShaderMap = GetGlobalShaderMap(ERHIFeatureLevel::SM5);
+
+	// Periodic bodies need wrapped gradients, so the normal pass follows the solver boundary mode
+	for (int32 BoundaryMode = 0; BoundaryMode < (int32)ECausticBoundaryMode::MAX; ++BoundaryMode)
+	{
+		for (bool bObstacleMask : { false, true })
+		{
+			for (bool bAmbientWaves : { false, true })
+			{
+				FSurfaceNormalComputeShader::FPermutationDomain PermutationVector;
+				PermutationVector.Set<Caustic::FThreadGroupShapeDim>((int32)ThreadGroupShape);
+				PermutationVector.Set<Caustic::FBoundaryModeDim>(BoundaryMode);
+				PermutationVector.Set<Caustic::FObstacleMaskDim>(bObstacleMask);
+				PermutationVector.Set<FAmbientWavesDim>(bAmbientWaves);
+				SurfaceNormalComputeShaders[GetNormalShaderIndex(BoundaryMode, bObstacleMask, bAmbientWaves)] = *TShaderMapRef<FSurfaceNormalComputeShader>(GlobalShaderMap, PermutationVector);
+			}
+		}
 	}
+
+	bResourcesReady = true;
 }
 
-void FSurfaceNormalPassRenderer::Render(FShaderResourceViewRHIRef HeightTextureSRV)
+void FSurfaceNormalPassRenderer::ReleasePass()
 {
-	if (IsValidPass())
+	if (bInitiated)
 	{
-		ENQUEUE_RENDER_COMMAND(SurfaceNormalPassCommand)
+		bInitiated = false;
+		bResourcesReady = false;
+
+		ENQUEUE_RENDER_COMMAND(SurfaceNormalPassReleaseCommand)
 		(
-			[HeightTextureSRV, this](FRHICommandListImmediate& RHICmdList)
+			[Renderer = AsShared()](FRHICommandListImmediate& RHICmdList)
 			{
-				check(IsInRenderingThread());
-
-				// Bind shader textures
-				TShaderMapRef<FSurfaceNormalComputeShader> SurfaceNormalComputeShader(GetGlobalShaderMap(ERHIFeatureLevel::SM5));
-				RHICmdList.SetComputeShader(SurfaceNormalComputeShader->GetComputeShader());
-				SurfaceNormalComputeShader->BindShaderTextures(RHICmdList, OutputNormalTextureUAV, HeightTextureSRV);
-
-				// Dispatch shader
-				const int ThreadGroupCountX = StaticCast<int>(Config.TextureWidth / 32);
-				const int ThreadGroupCountY = StaticCast<int>(Config.TextureHeight / 32);
-				DispatchComputeShader(RHICmdList, *SurfaceNormalComputeShader, ThreadGroupCountX, ThreadGroupCountY, 1);
-
-				// Unbind shader textures
-				SurfaceNormalComputeShader->UnbindShaderTextures(RHICmdList);
-
-				// Debug drawing
-				if (NormalDebugTextureRHIRef)
-				{
-					RHICmdList.CopyToResolveTarget(OutputNormalTexture, NormalDebugTextureRHIRef, FResolveParams());
-				}
+				Renderer->ReleasePassResources();
 			}
 		);
 	}
 }
 
+void FSurfaceNormalPassRenderer::ReleasePassResources()
+{
+	FCausticResourcePool::Get().ReleaseTexture(OutputNormal);
+}
+
+void FSurfaceNormalPassRenderer::Render_RenderThread(FRHICommandListImmediate& RHICmdList, const FCausticFrameParams& Params, FShaderResourceViewRHIRef HeightTextureSRV, FShaderResourceViewRHIRef ObstacleMaskSRV, FShaderResourceViewRHIRef AmbientHeightSRV)
+{
+	check(IsInRenderingThread());
+
+	SCOPED_DRAW_EVENT(RHICmdList, SurfaceNormalPass);
+
+	// Bodies without a baked mask skip the mask read entirely, like the height pass
+	const int32 ShaderIndex = GetNormalShaderIndex((int32)Params.BoundaryMode, ObstacleMaskSRV.IsValid(), AmbientHeightSRV.IsValid());
+	FSurfaceNormalComputeShader* SurfaceNormalComputeShader = SurfaceNormalComputeShaders[ShaderIndex];
+
+	// Bind shader textures
+	RHICmdList.SetComputeShader(SurfaceNormalComputeShader->GetComputeShader());
+	SurfaceNormalComputeShader->BindShaderTextures(RHICmdList, OutputNormal.UAV, HeightTextureSRV, ObstacleMaskSRV, AmbientHeightSRV);
+
+	// Bind shader uniform
+	FSurfaceNormalComputeShaderParameters UniformParam;
+	UniformParam.AmbientTiling = Params.AmbientTiling;
+	UniformParam.AmbientAmplitude = Params.AmbientAmplitude;
+	SurfaceNormalComputeShader->SetShaderParameters(RHICmdList, UniformParam);
+
+	// Dispatch shader
+	const FIntVector GroupCount = Caustic::GetGroupCount(Config.TextureWidth, Config.TextureHeight, ThreadGroupShape);
+	DispatchComputeShader(RHICmdList, SurfaceNormalComputeShader, GroupCount.X, GroupCount.Y, GroupCount.Z);
+
+	// Unbind shader textures
+	SurfaceNormalComputeShader->UnbindShaderTextures(RHICmdList);
+}
+
 bool FSurfaceNormalPassRenderer::IsValidPass() const
 {
-	bool bValid = !!OutputNormalTexture;
-	bValid &= !!OutputNormalTextureUAV;
-	bValid &= !!OutputNormalTextureSRV;
+	bool bValid = OutputNormal.IsValid();
+	for (const FSurfaceNormalComputeShader* SurfaceNormalComputeShader : SurfaceNormalComputeShaders)
+	{
+		bValid &= SurfaceNormalComputeShader != nullptr;
+	}
 
 	return bValid;
 }
@@ -4,6 +4,10 @@
 
 #include "CoreMinimal.h"
 #include "UObject/ObjectMacros.h"
+#include "HAL/ThreadSafeBool.h"
+#include "Pass/CausticResourcePool.h"
+#include "Pass/CausticFrameParams.h"
+#include "Pass/PassUtils.h"
 #include "RHI/Public/RHIResources.h"
 #include "RHI/Public/RHICommandList.h"
 
@@ -11,10 +15,9 @@ struct FSurfaceNormalPassConfig
 {
 	uint32                    TextureWidth;
 	uint32                    TextureHeight;
-	UTextureRenderTarget2D*   NormalDebugTextureRef;
 };
 
-class FSurfaceNormalPassRenderer
+class FSurfaceNormalPassRenderer : public TSharedFromThis<FSurfaceNormalPassRenderer, ESPMode::ThreadSafe>
 {
 
 public:
@@ -24,20 +27,38 @@ public:
 
 	void InitPass(const FSurfaceNormalPassConfig& InConfig);
 
-	void Render(FShaderResourceViewRHIRef HeightTextureSRV);
+	/** GPU bytes InitPass allocates for a config, the budget checks this before a body creates its passes */
+	static uint64 GetMemorySize(const FSurfaceNormalPassConfig& InConfig);
+
+	/** Records the normal pass, called by the frame graph. The obstacle mask and ambient height are optional */
+	void Render_RenderThread(FRHICommandListImmediate& RHICmdList, const FCausticFrameParams& Params, FShaderResourceViewRHIRef HeightTextureSRV, FShaderResourceViewRHIRef ObstacleMaskSRV, FShaderResourceViewRHIRef AmbientHeightSRV);
 
 	bool IsValidPass() const;
 
-	FORCEINLINE FShaderResourceViewRHIRef GetNormalTextureSRV() const { return OutputNormalTextureSRV; }
+	/** Whether the render thread has finished creating the pass resources */
+	FORCEINLINE bool IsReady() const { return bResourcesReady; }
+
+	/** Returns the normal texture to the resource pool */
+	void ReleasePass();
+
+	FORCEINLINE FShaderResourceViewRHIRef GetNormalTextureSRV() const { return OutputNormal.SRV; }
+
+	FORCEINLINE FRHITexture* GetNormalTexture() const { return OutputNormal.Texture; }
 
 private:
 
-	FTexture2DRHIRef           OutputNormalTexture;
-	FUnorderedAccessViewRHIRef OutputNormalTextureUAV;
-	FShaderResourceViewRHIRef  OutputNormalTextureSRV;
+	FCausticPooledTexture      OutputNormal;
 
-	FRHITexture*               NormalDebugTextureRHIRef;
+	/** Every boundary mode, obstacle mask and ambient wave permutation, indexed by GetNormalShaderIndex */
+	class FSurfaceNormalComputeShader* SurfaceNormalComputeShaders[(int32)ECausticBoundaryMode::MAX * 2 * 2];
+	Caustic::EThreadGroupShape         ThreadGroupShape;
 
 	FSurfaceNormalPassConfig   Config;
 	bool                       bInitiated;
+	FThreadSafeBool            bResourcesReady;
+
+private:
+
+	void InitPass_RenderThread(FRHICommandListImmediate& RHICmdList);
+	void ReleasePassResources();
 };
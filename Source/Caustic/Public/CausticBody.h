@@ -4,13 +4,20 @@
 
 #include "CoreMinimal.h"
 #include "CausticTypes.h"
+#include "CausticSnapshot.h"
+#include "Async/Future.h"
 #include "GameFramework/Actor.h"
 #include "Components/PrimitiveComponent.h"
-#include "Pass/SurfaceDepthPass.h"
-#include "Pass/SurfaceNormalPass.h"
-#include "Pass/SurfaceCausticPass.h"
+#include "Pass/CausticFrameGraph.h"
 #include "CausticBody.generated.h"
 
+/** Where an interactor was at the last step, its bounds also catch animation that leaves the component transform alone */
+struct FCausticInteractorState
+{
+	FTransform       Transform;
+	FBoxSphereBounds Bounds;
+};
+
 UCLASS()
 class CAUSTIC_API ACausticBody : public AActor
 {
@@ -22,6 +29,39 @@ public:
 
 	virtual void Tick(float DeltaTime) override;
 
+	/** Copies the solver state back without stalling and compresses it off the game thread. The future resolves a few frames later, to null on failure */
+	TFuture<TSharedPtr<FCausticSnapshot, ESPMode::ThreadSafe>> CaptureSnapshot();
+
+	/** Continues the simulation from a snapshot of a body with the same depth texture size */
+	bool RestoreSnapshot(const FCausticSnapshot& Snapshot);
+
+	/** Replaces the wave settings and recomputes the solver coefficients. The depth texture size stays fixed once the body plays */
+	UFUNCTION(BlueprintCallable, Category = "Caustic Body")
+	void SetLiquidParam(const FLiquidParam& InLiquidParam);
+
+	/** Solver steps taken since BeginPlay, one per rendered frame */
+	uint64 GetSimulationStep() const { return SimulationStep; }
+
+	/** GPU bytes the passes and render targets of this body need for an output of OutputSize */
+	uint64 GetGpuMemorySize(const FIntPoint& OutputSize) const;
+
+	/** Bytes held against r.Caustic.MemoryBudgetMB, 0 when the body is not simulated */
+	uint64 GetReservedGpuMemory() const { return ReservedGpuMemory; }
+
+	/**
+	 * Pushes the surface around a world location on the next step, without rendering anything through the depth capture.
+	 * A hidden body applies it on the step after it is seen again, impulses past r.Caustic.MaxImpulsesPerStep are dropped.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Caustic Body")
+	void AddImpulse(FVector Location, float Radius, float Strength);
+
+	UFUNCTION(BlueprintCallable, Category = "Caustic Body")
+	void AddImpulses(const TArray<FCausticImpulse>& Impulses);
+
+	/** Hands each impulse to every body it lands in, for particle collisions and physics contacts that do not know the body */
+	UFUNCTION(BlueprintCallable, Category = "Caustic Body", meta = (WorldContext = "WorldContextObject"))
+	static void AddWorldImpulses(const UObject* WorldContextObject, const TArray<FCausticImpulse>& Impulses);
+
 protected:	
 
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Caustic Body", meta = (ClampMin = 0.01))
@@ -39,6 +79,38 @@ protected:
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Caustic Body")
 	FLiquidParam LiquidParam;
 
+	/** Bake the level geometry inside the body into an obstacle mask at BeginPlay, so pillars and shorelines block waves */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Caustic Body")
+	bool bBakeObstacleMask;
+
+	/** Light the caustics are projected from, straight down when unset */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Caustic Body")
+	class ADirectionalLight* CausticLight;
+
+	/** Spectrum synthesized swell added to the simulated surface, bodies with equal settings share one field */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Caustic Body")
+	FAmbientWaveParam AmbientWave;
+
+	/** Drive the ambient swell from the step count instead of world time. Interactors and impulses are not recorded, replays only match if they repeat */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Caustic Body")
+	bool bDeterministicSimulation;
+
+	/** Where the depth of overlapping components comes from, the proxy and mesh sources skip the scene capture */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Caustic Body")
+	ECausticInteractionSource InteractionSource;
+
+	/** How overlapping components push the surface, the displaced volume lets a body settle and sleep around interactors at rest */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Caustic Body")
+	ECausticInteractionForce InteractionForce;
+
+	/** Impulse dragged behind interactors that cross the surface, scaled by how far they move each step relative to their size. 0 leaves wakes to the interaction force */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Caustic Body", meta = (ClampMin = 0.0))
+	float WakeStrength;
+
+	/** Keep simulating while no view sees the body, otherwise it pauses until a view, capture or player sees it again and applies the impulses queued meanwhile */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Caustic Body")
+	bool bSimulateWhenHidden;
+
 	/** The water surface mesh component */
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Components)
 	class UBoxComponent* BoxCollisionComp;
@@ -51,10 +123,92 @@ protected:
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Components)
 	class UProceduralMeshComponent* BodyMeshComp;
 
+	/** Projects the caustics onto everything inside the body volume, drawn once per body instead of once per receiving material */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Components)
+	class UDecalComponent* CausticDecalComp;
+
 	/** Scene capture component that captures depth texture */
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Components)
 	class USceneCaptureComponent2D* DepthCaptureComp;
 
+	/** Render target the caustic pass writes into, sampled by light functions. Created at BeginPlay when left empty */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Caustic Output")
+	class UTextureRenderTarget2D* CausticRenderTarget;
+
+	/**
+	 * Deferred decal material applied to receivers inside the body, Assign Default Decal Material sets the plugin's receiver.
+	 * Receives the caustic target as CausticTexture, the body transform and surface plane (see CausticDecal.ush),
+	 * BodyDepth, CausticIntensity and CausticDepthFalloff. No decal is drawn when unset.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Caustic Output")
+	class UMaterialInterface* CausticDecalMaterial;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Caustic Output", meta = (ClampMin = 0.0, EditCondition = "CausticDecalMaterial != nullptr"))
+	float CausticDecalIntensity;
+
+	/** Depth below the surface in world units over which the decal fades out */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Caustic Output", meta = (ClampMin = 1.0, EditCondition = "CausticDecalMaterial != nullptr"))
+	float CausticDepthFalloff;
+
+	/** Accumulates the caustics over frames, which hides the flicker of a coarse refraction grid */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Caustic Output")
+	bool bTemporalFilter;
+
+	/** Weight of the newest frame, lower is smoother but slower to follow fast waves */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Caustic Output", meta = (ClampMin = 0.01, ClampMax = 1.0, EditCondition = "bTemporalFilter"))
+	float TemporalBlendWeight;
+
+	/** Caustic texels per simulation texel, the refraction grid density does not depend on it */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Caustic Output", meta = (ClampMin = 0.25, ClampMax = 8.0))
+	float CausticResolutionScale;
+
+	/** Gaussian blur radius in caustic texels applied before the output, 0 disables it */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Caustic Output", meta = (ClampMin = 0, ClampMax = 8))
+	int32 CausticBlurRadius;
+
+	/** Give the created caustic target a mip chain so distant receivers can sample a lower mip */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Caustic Output")
+	bool bGenerateCausticMips;
+
+	/** Play the baked flipbook while nothing is inside the body, the live simulation takes over on overlap */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Caustic Flipbook")
+	bool bUseCausticFlipbook;
+
+	/** Frames stored by BakeCausticFlipbook, the last one blends back into the first. Fewer are baked if the atlas would pass the largest texture size */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Caustic Flipbook", meta = (ClampMin = 2, ClampMax = 256))
+	int32 FlipbookFrameCount;
+
+	/** Simulation steps between two stored frames, playback interpolates across them */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Caustic Flipbook", meta = (ClampMin = 1, ClampMax = 16))
+	int32 FlipbookFrameStep;
+
+	/** Frames crossfaded across the loop seam */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Caustic Flipbook", meta = (ClampMin = 0, ClampMax = 64))
+	int32 FlipbookLoopFrames;
+
+	/** Steps simulated before the first stored frame, so the bake starts from developed waves */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Caustic Flipbook", meta = (ClampMin = 0))
+	int32 FlipbookWarmupSteps;
+
+	/** Baked caustic frames, BC6H compressed and tiled row major */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Caustic Flipbook")
+	class UTexture2D* CausticFlipbook;
+
+	/** Layout of the baked atlas, the bake settings above may have changed since */
+	UPROPERTY(VisibleAnywhere, Category = "Caustic Flipbook")
+	int32 FlipbookColumns;
+
+	UPROPERTY(VisibleAnywhere, Category = "Caustic Flipbook")
+	int32 BakedFlipbookFrameCount;
+
+	UPROPERTY(VisibleAnywhere, Category = "Caustic Flipbook")
+	int32 BakedFlipbookFrameStep;
+
+	/** Size of one baked frame, playback only runs into a caustic target of the same size */
+	UPROPERTY(VisibleAnywhere, Category = "Caustic Flipbook")
+	FIntPoint FlipbookFrameSize;
+
+	/** Debug targets below are only written for one frame by the Caustic.Capture console command */
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Pass Debug Textures")
 	class UTextureRenderTarget2D* SurfaceDepthPassDebugTexture;
 
@@ -67,14 +221,80 @@ protected:
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Pass Debug Textures")
 	class UTextureRenderTarget2D* SurfaceCausticPassDebugTexture;
 
+	UPROPERTY(Transient)
 	class UTextureRenderTarget2D* DepthRenderTarget;
 
-	TUniquePtr<FSurfaceDepthPassRenderer> SurfaceDepthPassRenderer;
-	TUniquePtr<FSurfaceNormalPassRenderer> SurfaceNormalPassRenderer;
-	TUniquePtr<FSurfaceCausticPassRenderer> SurfaceCausticPassRenderer;
+	UPROPERTY(Transient)
+	class UMaterialInstanceDynamic* CausticDecalMID;
+
+	/** Scene depth seen from above the surface, thresholded into the obstacle mask on the render thread */
+	UPROPERTY(Transient)
+	class UTextureRenderTarget2D* ObstacleMaskRenderTarget;
+
+	// Render commands hold their own reference, so the passes outlive the actor until in-flight work is done
+	TSharedPtr<FSurfaceDepthPassRenderer, ESPMode::ThreadSafe> SurfaceDepthPassRenderer;
+	TSharedPtr<FSurfaceNormalPassRenderer, ESPMode::ThreadSafe> SurfaceNormalPassRenderer;
+	TSharedPtr<FSurfaceCausticPassRenderer, ESPMode::ThreadSafe> SurfaceCausticPassRenderer;
+	TSharedPtr<FCausticTemporalPassRenderer, ESPMode::ThreadSafe> CausticTemporalPassRenderer;
+	TSharedPtr<FCausticBlurPassRenderer, ESPMode::ThreadSafe> CausticBlurPassRenderer;
+	TSharedPtr<FCausticFlipbookPassRenderer, ESPMode::ThreadSafe> CausticFlipbookPassRenderer;
+
+	/** Records all passes of the body into one render command per frame */
+	TSharedPtr<FCausticFrameGraph, ESPMode::ThreadSafe> FrameGraph;
+
+	/** Shared ambient field, only held while AmbientWave is enabled */
+	TSharedPtr<FAmbientWaveSpectrum, ESPMode::ThreadSafe> AmbientWaveSpectrum;
 
 	TArray<TWeakObjectPtr<UPrimitiveComponent>> ComponentsToDrawDepth;
 
+	/** Meshes the last frame drew into the mesh depth pass, held so their render data is not collected under it */
+	UPROPERTY(Transient)
+	TArray<class UStaticMesh*> DepthMeshReferences;
+
+	/** Height stencil of LiquidParam, recomputed whenever LiquidParam changes rather than every frame */
+	FCausticSolverCoefficients SolverCoefficients;
+
+	/** Interactor transforms and bounds at the last step, to tell moving interactors from ones at rest */
+	TMap<TWeakObjectPtr<UPrimitiveComponent>, FCausticInteractorState> InteractorStates;
+
+	/** Steps since anything last disturbed the surface, the body sleeps once waves have decayed below r.Caustic.SleepThreshold */
+	uint32 QuietSteps;
+
+	bool bSleeping;
+
+	/** Whether the depth capture ran last frame, the depth pass only reads a capture that is current */
+	bool bDepthCapturedLastFrame;
+
+	/** Impulses in texture space waiting for the next step, capped by r.Caustic.MaxImpulsesPerStep */
+	TArray<FSurfaceImpulse> PendingImpulses;
+
+	/** Whether this body already warned about hitting r.Caustic.MaxImpulsesPerStep or r.Caustic.MaxDepthProxies */
+	bool bWarnedImpulseCap;
+	bool bWarnedDepthProxyCap;
+
+	/** Set once every pass has finished its deferred initialization */
+	bool bSimulationReady;
+
+	/** Last Caustic.Capture request serviced by this body */
+	uint32 LastDebugCaptureSerial;
+
+	/** Set after a bake until the frame graph has consumed the captured mask */
+	bool bObstacleMaskPending;
+
+	/** Advanced once per frame handed to the frame graph, stored in and restored from snapshots */
+	uint64 SimulationStep;
+
+	/** Reserved in the caustic memory budget on BeginPlay, released on EndPlay */
+	uint64 ReservedGpuMemory;
+
+	/** GFrameCounter of the last frame any view saw the body, written by the view extension */
+	uint64 LastVisibleFrame;
+
+	/** GFrameCounter of the last frame the simulation advanced */
+	uint64 LastSimulatedFrame;
+
+	friend class FCausticViewExtension;
+
 protected:
 
 	UFUNCTION(BlueprintCallable)
@@ -83,6 +303,20 @@ protected:
 	UFUNCTION(BlueprintCallable)
 	void GenerateBodyMesh();
 
+#if WITH_EDITOR
+	/** Sets Caustic Decal Material to the plugin's receiver, which projects the caustics in body space and fades them with depth */
+	UFUNCTION(CallInEditor, Category = "Caustic Output")
+	void AssignDefaultDecalMaterial();
+
+	/** Runs the ambient simulation offline and stores the caustic output as a loopable flipbook */
+	UFUNCTION(CallInEditor, Category = "Caustic Flipbook")
+	void BakeCausticFlipbook();
+#endif
+
+	/** Captures the static geometry inside the body once, call again after the level layout changes */
+	UFUNCTION(BlueprintCallable)
+	void BakeObstacleMask();
+
 	UFUNCTION()
 	void OnBoxBeginOverlap(
 		class UPrimitiveComponent* OverlappedComponent,
@@ -104,6 +338,64 @@ protected:
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
 
+	// Called when the game ends or when destroyed, hands the pass resources back to the pool
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
 	virtual void PostInitializeComponents() override;
 
+#if WITH_EDITOR
+	virtual void PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent) override;
+#endif
+
+	/** Derives the solver coefficients from LiquidParam and warns about settings the solver clamps */
+	void UpdateSolverCoefficients();
+
+	/** Creates the depth target and starts the deferred initialization of every pass, the output is OutputSize */
+	void InitSimulation(const FIntPoint& OutputSize);
+
+	/** Caustic texture size the resolution scale gives */
+	FIntPoint GetCausticTextureSize() const;
+
+	/** Refraction grid pass setup, the grid cell follows the resolution scale */
+	FSurfaceCausticPassConfig GetCausticPassConfig() const;
+
+	/** Reserves the body in the memory budget, lowering the caustic resolution if it does not fit. False when the body must not simulate */
+	bool ReserveGpuMemory();
+
+	/** Fills the per frame parameters shared by the live simulation and the flipbook bake */
+	void SetupFrameParams(FCausticFrameInputs& FrameInputs, float AmbientTime) const;
+
+	/** Whether this frame plays the flipbook instead of simulating */
+	bool ShouldPlayFlipbook() const;
+
+	/** Binds the caustic target to the decal material and fits the decal to the body volume */
+	void SetupCausticDecal();
+
+	/** Passes the body transform and its surface plane to the decal material */
+	void UpdateCausticDecalSurface();
+
+	/** Keeps the decal surface plane in place when the body moves */
+	void OnBodyTransformUpdated(USceneComponent* UpdatedComponent, EUpdateTransformFlags UpdateTransformFlags, ETeleportType Teleport);
+
+	/** Polls the passes until their render resources are created */
+	bool IsSimulationReady();
+
+	/** Records interactor motion since the last step and queues their wakes. True when any interactor moved, changed shape, entered or left */
+	bool UpdateInteractors();
+
+	/** Whether every wave has decayed and nothing can disturb the surface until an interactor moves */
+	bool IsSettled() const;
+
+	/** Body space height of the surface plane the depth capture looks down from */
+	float GetSurfaceZ() const;
+
+	/** Whether any view rendered last frame could see the body volume */
+	bool IsVisibleInAnyView() const;
+
+	/** Volume a view has to see for the caustics to matter */
+	FBoxSphereBounds GetVisibilityBounds() const;
+
+	/** Whether a view family renders into one of the body's own capture targets */
+	bool IsOwnCaptureTarget(const FRenderTarget* RenderTarget) const;
+
 };
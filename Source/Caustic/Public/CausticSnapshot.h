@@ -0,0 +1,54 @@
+// Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "CausticTypes.h"
+
+/**
+ * Complete wave solver state of a body: both height frames, the displaced volume, the liquid parameters and the
+ * step count. The frames are kept zlib compressed, a calm surface compresses to almost nothing.
+ */
+struct CAUSTIC_API FCausticSnapshot
+{
+	/** Bumped whenever the layout of the serialized data changes, operator<< reads every version from MinVersion on */
+	static const uint32 CurrentVersion = 3;
+
+	/** Version 1 stored the liquid parameters in their in-memory layout, which every new field broke */
+	static const uint32 MinVersion = 2;
+
+	uint32        Version = CurrentVersion;
+	uint32        Width = 0;
+	uint32        Height = 0;
+
+	/** Number of solver steps the body had taken when the snapshot was captured */
+	uint64        SimulationStep = 0;
+
+	FLiquidParam  LiquidParam;
+
+	/** Current then previous height frame as half float RGBA, compressed */
+	TArray<uint8> CompressedHeight;
+	int32         UncompressedSize = 0;
+
+	/** Volume each texel displaced on the last step as half floats, compressed. Added in version 3 */
+	TArray<uint8> CompressedDisplacement;
+	int32         UncompressedDisplacementSize = 0;
+
+	/** Packs both height frames. Safe to call from any thread */
+	bool CompressHeight(const TArray<FFloat16Color>& Current, const TArray<FFloat16Color>& Previous);
+
+	/** Unpacks both height frames, fails on a corrupt or mismatched snapshot */
+	bool DecompressHeight(TArray<FFloat16Color>& OutCurrent, TArray<FFloat16Color>& OutPrevious) const;
+
+	/** Packs the displaced volume. Safe to call from any thread */
+	bool CompressDisplacement(const TArray<FFloat16>& Displacement);
+
+	/** Unpacks the displaced volume, snapshots from before version 3 come back as nothing displaced */
+	bool DecompressDisplacement(TArray<FFloat16>& OutDisplacement) const;
+
+	bool SaveToBytes(TArray<uint8>& OutBytes);
+
+	bool LoadFromBytes(const TArray<uint8>& Bytes);
+
+	friend FArchive& operator<<(FArchive& Ar, FCausticSnapshot& Snapshot);
+};
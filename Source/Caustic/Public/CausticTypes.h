@@ -5,11 +5,73 @@
 #include "CoreMinimal.h"
 #include "CausticTypes.generated.h"
 
+/** How the wave solver treats the edges of the simulated domain */
+UENUM(BlueprintType)
+enum class ECausticBoundaryMode : uint8
+{
+	/** Waves bounce off the edges like pool walls */
+	Reflective,
+	/** A sponge layer along the edges damps outgoing waves, for open water */
+	Absorbing,
+	/** Opposite edges are connected, for tiled oceans */
+	Periodic,
+	MAX UMETA(Hidden)
+};
+
+/** Integrator used to advance the height field */
+UENUM(BlueprintType)
+enum class ECausticSolver : uint8
+{
+	/** Explicit five point stencil, cheapest but only stable up to Velocity 1 */
+	FivePoint,
+	/** Explicit nine point stencil, rounder ripples and stable up to Velocity 1.22 */
+	NinePoint,
+	/** Implicit Laplacian relaxed with Jacobi iterations, stable at any step and used up to Velocity 4 */
+	SemiImplicit,
+	MAX UMETA(Hidden)
+};
+
+/** How the shapes of overlapping components reach the wave equation */
+UENUM(BlueprintType)
+enum class ECausticInteractionSource : uint8
+{
+	/** Depth only scene capture of the overlapping components, follows the exact meshes */
+	SceneCapture,
+	/** Spheres, capsules, boxes and convex hulls of their simple collision traced in one compute dispatch, no scene render */
+	CollisionProxies,
+	/** Static mesh LODs drawn straight into the simulation input, no scene render. Other components use their simple collision */
+	StaticMeshes,
+	MAX UMETA(Hidden)
+};
+
+/** How the depth of an interactor becomes a force on the surface */
+UENUM(BlueprintType)
+enum class ECausticInteractionForce : uint8
+{
+	/** Sets the surface under an interactor from its penetration depth every step, so interactors at rest keep pumping energy in */
+	Penetration,
+	/** Pushes by the change in displaced volume since the last step, interactors at rest add nothing and moving ones leave a wake */
+	DisplacedVolume,
+	MAX UMETA(Hidden)
+};
+
+/** How refracted light is carried from the surface to the floor */
+UENUM(BlueprintType)
+enum class ECausticProjection : uint8
+{
+	/** Offsets by the surface normal scaled by Refraction, light straight down */
+	Vertical,
+	/** Refracts the light direction with Snell's law and intersects the floor at the body depth */
+	Refracted,
+	MAX UMETA(Hidden)
+};
+
 USTRUCT(BlueprintType)
 struct CAUSTIC_API FLiquidParam
 {
 	GENERATED_BODY()
 
+	/** Wave speed as a fraction of the largest stable speed of the five point solver, clamped to the stable range of the selected solver */
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin = 0.01))
 	float Velocity;
 
@@ -19,15 +81,120 @@ struct CAUSTIC_API FLiquidParam
 	UPROPERTY(EditAnywhere, BlueprintReadWrite)
 	float ForceFactor;
 
-	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	/** Normal offset scale of the vertical projection */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (EditCondition = "Projection == ECausticProjection::Vertical"))
 	float Refraction;
 
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	ECausticProjection Projection;
+
+	/** Index of refraction of the liquid, 1.33 for water */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin = 1.0, ClampMax = 3.0, EditCondition = "Projection == ECausticProjection::Refracted"))
+	float IndexOfRefraction;
+
+	/**
+	 * Relative spread of the refraction (or of IOR - 1) between the red and blue channels, 0 renders white caustics.
+	 * Every channel is rasterized at the green footprint and only its intensity comes from its own refraction, so there are no spatial color fringes.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin = 0.0, ClampMax = 0.5))
+	float Dispersion;
+
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin = 0.0, ClampMax = 1.0))
 	float AttenuationCoefficient;
 
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	ECausticSolver Solver;
+
+	/** Jacobi iterations per step of the semi implicit solver, each one is a full screen dispatch */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin = 1, ClampMax = 16, EditCondition = "Solver == ECausticSolver::SemiImplicit"))
+	int32 JacobiIterations;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	ECausticBoundaryMode BoundaryMode;
+
+	/** Width of the absorbing layer in texels */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin = 1, EditCondition = "BoundaryMode == ECausticBoundaryMode::Absorbing"))
+	int32 SpongeWidth;
+
+	/** Fraction of the wave removed per step at the outermost texel of the absorbing layer */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin = 0.0, ClampMax = 1.0, EditCondition = "BoundaryMode == ECausticBoundaryMode::Absorbing"))
+	float SpongeStrength;
+
 	UPROPERTY(EditAnywhere, BlueprintReadWrite)
 	int32 DepthTextureWidth;
 
 	UPROPERTY(EditAnywhere, BlueprintReadWrite)
 	int32 DepthTextureHeight;
-};
\ No newline at end of file
+};
+
+/** Ocean spectrum the ambient waves are synthesized from */
+UENUM(BlueprintType)
+enum class ECausticWaveSpectrum : uint8
+{
+	Phillips,
+	/** Fetch limited spectrum with a sharper peak, suits lakes and coastal water */
+	JONSWAP
+};
+
+/** Tileable ambient waves synthesized by FFT and added on top of the interactive ripples */
+USTRUCT(BlueprintType)
+struct CAUSTIC_API FAmbientWaveParam
+{
+	GENERATED_BODY()
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	bool bEnabled = false;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (EditCondition = "bEnabled"))
+	ECausticWaveSpectrum Spectrum = ECausticWaveSpectrum::Phillips;
+
+	/** FFT size, 64, 128 or 256. Independent from the interactive simulation resolution */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin = 64, ClampMax = 256, EditCondition = "bEnabled"))
+	int32 Resolution = 128;
+
+	/** World size of one tile of the ambient field */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin = 1.0, EditCondition = "bEnabled"))
+	float PatchSize = 1000.0f;
+
+	/** Wind speed in meters per second */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin = 0.1, EditCondition = "bEnabled"))
+	float WindSpeed = 5.0f;
+
+	/** Wind direction in degrees around the body up axis */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (EditCondition = "bEnabled"))
+	float WindDirection = 0.0f;
+
+	/** JONSWAP peak enhancement factor */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin = 1.0, EditCondition = "bEnabled && Spectrum == ECausticWaveSpectrum::JONSWAP"))
+	float PeakEnhancement = 3.3f;
+
+	/** RMS height of the ambient field in surface height units */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin = 0.0, EditCondition = "bEnabled"))
+	float Amplitude = 0.05f;
+
+	/** Spectrum updates per second, 0 updates every frame */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin = 0.0, EditCondition = "bEnabled"))
+	float UpdateRate = 30.0f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (EditCondition = "bEnabled"))
+	int32 Seed = 0;
+};
+
+/** Disturbance pushed into the surface without going through the depth capture */
+USTRUCT(BlueprintType)
+struct CAUSTIC_API FCausticImpulse
+{
+	GENERATED_BODY()
+
+	/** World location, ignored unless it lies inside a body volume or within Radius above its surface */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	FVector Location = FVector::ZeroVector;
+
+	/** World radius of the smooth falloff around Location */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin = 0.0))
+	float Radius = 16.0f;
+
+	/** Displacement at the centre, 1 pushes as hard as an interactor reaching the body floor. Negative values pull the other way */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	float Strength = 0.1f;
+};